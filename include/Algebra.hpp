@@ -1,140 +1,208 @@
 #ifndef ALFRACTAL_ALGEBRA
 #define ALFRACTAL_ALGEBRA
 
-#include <valarray>
+#include <array>
+#include <cstddef>
+#include <utility>
 
 namespace algebra
 {
     ////////////////     Algebra     ///////////////
     // Реализация алгебры над полем.
-    template <class field, const size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    // Тензор произведения задаётся структурными константами product_tensor[index][row][column] — коэффициентом при
+    // базисном элементе index в произведении базисных элементов row и column. Он должен быть constexpr.
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     class Algebra
     {
     public:
-        std::valarray<field> components;
+        // Компоненты хранятся непосредственно в объекте: арифметика не обращается к куче.
+        std::array<field, dimension> components;
 
         explicit Algebra<field, dimension, product_tensor>()
-            : components(field{0}, dimension)
-        { }
-        explicit Algebra<field, dimension, product_tensor>(std::valarray<field> initcomponents)
+        { components.fill(field{0}); }
+        explicit Algebra<field, dimension, product_tensor>(const std::array<field, dimension>& initcomponents)
             : components(initcomponents)
         { }
 
         // Нахождение противоположного элемента.
-        Algebra<field, dimension, product_tensor> operator-(const Algebra<field, dimension, product_tensor>& right)
+        Algebra<field, dimension, product_tensor> operator-() const
         {
-            Algebra<field, dimension, product_tensor> result = right;
-            result.components = -result.components;
+            Algebra<field, dimension, product_tensor> result = *this;
+            for (size_t index = 0; index < dimension; ++index)
+            { result.components[index] = -result.components[index]; }
             return result;
         }
 
         // Сложение с элементом алгебры.
         Algebra<field, dimension, product_tensor>& operator+=(const Algebra<field, dimension, product_tensor>& right)
-        { components += right.components; return *this; }
+        {
+            for (size_t index = 0; index < dimension; ++index)
+            { components[index] += right.components[index]; }
+            return *this;
+        }
         Algebra<field, dimension, product_tensor>& operator-=(const Algebra<field, dimension, product_tensor>& right)
-        { components -= right.components; return *this; }
+        {
+            for (size_t index = 0; index < dimension; ++index)
+            { components[index] -= right.components[index]; }
+            return *this;
+        }
 
         // Умножение и деление на элемент поля.
         Algebra<field, dimension, product_tensor>& operator*=(const field& right)
-        { components *= right; return *this; }
+        {
+            for (size_t index = 0; index < dimension; ++index)
+            { components[index] *= right; }
+            return *this;
+        }
         Algebra<field, dimension, product_tensor>& operator/=(const field& right)
-        { components /= right; return *this; }
+        {
+            for (size_t index = 0; index < dimension; ++index)
+            { components[index] /= right; }
+            return *this;
+        }
 
         // Умножение на элемент алгебры.
         Algebra<field, dimension, product_tensor>& operator*=(const Algebra<field, dimension, product_tensor>& right)
         {
-            // Одномерное представление массива тензора произведения.
-            const field (&_product_tensor)[dimension * dimension * dimension] = reinterpret_cast<const field (&)[dimension * dimension * dimension]>(product_tensor);
-
-            // Новые компоненты элемента алгебры.
-            std::valarray<field> new_components = std::valarray<field>(field{0}, dimension);
+            std::array<field, dimension> new_components = components; // Копия наследует точность операндов (важно для полей вроде mpf_class).
+            _product(right, new_components);
+            components = std::move(new_components);
+            return *this;
+        }
 
-            // Цикл по базисным элементам.
+        // Умножение на элемент алгебры с последующим сложением: *this = *this * right + addend.
+        // Используется в итерационном процессе вместо выражения var * var + constant, не создающего временных объектов.
+        Algebra<field, dimension, product_tensor>& multiply_add(const Algebra<field, dimension, product_tensor>& right, const Algebra<field, dimension, product_tensor>& addend)
+        {
+            std::array<field, dimension> new_components = components; // Копия наследует точность операндов (важно для полей вроде mpf_class).
+            _product(right, new_components);
             for (size_t index = 0; index < dimension; ++index)
-            {
-                field component{0}; // Временная переменная для компонента на позиции index.
-                size_t component_offset = index * dimension * dimension; // Смещение в одномерном массиве при доступе к компоненте с индексом index.
-
-                // Цикл по строкам среза массива.
-                for (size_t row = 0; row < dimension; ++row)
-                {
-                    field sum{0}; // Временная переменная для произведения правого столбца компонент на строку среза.
-                    size_t row_offset = row * dimension + component_offset;
-
-                    // Произведение правого столбца компонент на строку среза.
-                    for (size_t column = 0; column < dimension; ++column)
-                    { sum += _product_tensor[row_offset + column] * right.components[column]; }
-
-                    // Умножение на компоненту левого столбца компонент.
-                    component += sum * components[row];
-                }
-                new_components[index] = component;
-            }
-
-            components = new_components;
+            { components[index] = std::move(new_components[index]); components[index] += addend.components[index]; }
             return *this;
         }
 
     protected:
+        // Вычисление произведения *this * right в new_components (допускается right == *this).
+        // Точность накопителей new_components задаётся вызывающей стороной.
+        // Тензор произведения известен на этапе компиляции, поэтому код генерируется только для его ненулевых
+        // структурных констант (для известных алгебр их dimension^2, а не dimension^3).
+        void _product(const Algebra<field, dimension, product_tensor>& right, std::array<field, dimension>& new_components) const
+        {
+            for (size_t index = 0; index < dimension; ++index)
+            { new_components[index] = 0; }
+            _accumulate(right, new_components, std::make_index_sequence<dimension * dimension * dimension>());
+        }
+
+        // Обход всех элементов тензора произведения.
+        template <size_t... entries>
+        void _accumulate(const Algebra<field, dimension, product_tensor>& right, std::array<field, dimension>& new_components, std::index_sequence<entries...>) const
+        { (_accumulate_entry<entries>(right, new_components), ...); }
+
+        // Вклад одной структурной константы: new[index] += product_tensor[index][row][column] * left[row] * right[column].
+        template <size_t entry>
+        void _accumulate_entry(const Algebra<field, dimension, product_tensor>& right, std::array<field, dimension>& new_components) const
+        {
+            constexpr size_t index  = entry / (dimension * dimension);
+            constexpr size_t row    = entry / dimension % dimension;
+            constexpr size_t column = entry % dimension;
+            constexpr double coefficient = product_tensor[index][row][column];
+
+            if constexpr (coefficient == 1.0)
+            { new_components[index] += components[row] * right.components[column]; }
+            else if constexpr (coefficient == -1.0)
+            { new_components[index] -= components[row] * right.components[column]; }
+            else if constexpr (coefficient != 0.0)
+            { new_components[index] += coefficient * (components[row] * right.components[column]); }
+        }
 
     private:
 
     };
 
     // Сумма элементов векторного пространства.
-    template <class field, const size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     Algebra<field, dimension, product_tensor> operator+(const Algebra<field, dimension, product_tensor>& left, const Algebra<field, dimension, product_tensor>& right)
     {
         Algebra<field, dimension, product_tensor> result = left;
         result += right;
         return result;
     }
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
+    Algebra<field, dimension, product_tensor> operator+(Algebra<field, dimension, product_tensor>&& left, const Algebra<field, dimension, product_tensor>& right)
+    {
+        left += right;
+        return std::move(left);
+    }
 
     // Разность элементов векторного пространства.
-    template <class field, const size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     Algebra<field, dimension, product_tensor> operator-(const Algebra<field, dimension, product_tensor>& left, const Algebra<field, dimension, product_tensor>& right)
     {
         Algebra<field, dimension, product_tensor> result = left;
         result -= right;
         return result;
     }
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
+    Algebra<field, dimension, product_tensor> operator-(Algebra<field, dimension, product_tensor>&& left, const Algebra<field, dimension, product_tensor>& right)
+    {
+        left -= right;
+        return std::move(left);
+    }
 
     // Произведение элемента векторного пространства и элемента поля.
-    template <class field, const size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     Algebra<field, dimension, product_tensor> operator*(const Algebra<field, dimension, product_tensor>& left, const field& right)
     {
         Algebra<field, dimension, product_tensor> result = left;
         result *= right;
         return result;
     }
-    template <class field, size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
+    Algebra<field, dimension, product_tensor> operator*(Algebra<field, dimension, product_tensor>&& left, const field& right)
+    {
+        left *= right;
+        return std::move(left);
+    }
+    template <class field, size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     Algebra<field, dimension, product_tensor> operator*(const field& left, const Algebra<field, dimension, product_tensor>& right)
     {
         return right * left;
     }
 
     // Частное элемента векторного пространства и элемента поля.
-    template <class field, const size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     Algebra<field, dimension, product_tensor> operator/(const Algebra<field, dimension, product_tensor>& left, const field& right)
     {
         Algebra<field, dimension, product_tensor> result = left;
         result /= right;
         return result;
     }
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
+    Algebra<field, dimension, product_tensor> operator/(Algebra<field, dimension, product_tensor>&& left, const field& right)
+    {
+        left /= right;
+        return std::move(left);
+    }
 
     // Произведение элементов алгебры.
-    template <class field, const size_t dimension, const field (&product_tensor)[dimension][dimension][dimension]>
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
     Algebra<field, dimension, product_tensor> operator*(const Algebra<field, dimension, product_tensor>& left, const Algebra<field, dimension, product_tensor>& right)
     {
         Algebra<field, dimension, product_tensor> result = left;
         result *= right;
         return result;
     }
+    template <class field, const size_t dimension, const double (&product_tensor)[dimension][dimension][dimension]>
+    Algebra<field, dimension, product_tensor> operator*(Algebra<field, dimension, product_tensor>&& left, const Algebra<field, dimension, product_tensor>& right)
+    {
+        left *= right;
+        return std::move(left);
+    }
 
 
     ////////////////     Complex     ///////////////
     // Комплексные числа.
-    const double complex_pt[2][2][2]
+    inline constexpr double complex_pt[2][2][2]
     {
         {
             // Real.
@@ -154,7 +222,7 @@ namespace algebra
 
     ////////////////  SplitComplex  ////////////////
     // Двойные числа.
-    const double split_complex_pt[2][2][2]
+    inline constexpr double split_complex_pt[2][2][2]
     {
         {
             // xi_1
@@ -170,6 +238,187 @@ namespace algebra
         }
     };
     using SplitComplex = Algebra<double, 2, split_complex_pt>;
+
+    ////////////////    Quaternion   ///////////////
+    // Кватернионы.
+    inline constexpr double quaternion_pt[4][4][4]
+    {
+        {
+            // 1
+            //    1     i     j     k
+            {  1.0,  0.0,  0.0,  0.0 }, // 1
+            {  0.0, -1.0,  0.0,  0.0 }, // i
+            {  0.0,  0.0, -1.0,  0.0 }, // j
+            {  0.0,  0.0,  0.0, -1.0 }  // k
+        },
+        {
+            // i
+            //    1     i     j     k
+            {  0.0,  1.0,  0.0,  0.0 }, // 1
+            {  1.0,  0.0,  0.0,  0.0 }, // i
+            {  0.0,  0.0,  0.0,  1.0 }, // j
+            {  0.0,  0.0, -1.0,  0.0 }  // k
+        },
+        {
+            // j
+            //    1     i     j     k
+            {  0.0,  0.0,  1.0,  0.0 }, // 1
+            {  0.0,  0.0,  0.0, -1.0 }, // i
+            {  1.0,  0.0,  0.0,  0.0 }, // j
+            {  0.0,  1.0,  0.0,  0.0 }  // k
+        },
+        {
+            // k
+            //    1     i     j     k
+            {  0.0,  0.0,  0.0,  1.0 }, // 1
+            {  0.0,  0.0,  1.0,  0.0 }, // i
+            {  0.0, -1.0,  0.0,  0.0 }, // j
+            {  1.0,  0.0,  0.0,  0.0 }  // k
+        }
+    };
+    using Quaternion = Algebra<double, 4, quaternion_pt>;
+
+    ////////////////    Bicomplex    ///////////////
+    // Бикомплексные числа (i^2 = j^2 = -1, k = ij, k^2 = 1).
+    inline constexpr double bicomplex_pt[4][4][4]
+    {
+        {
+            // 1
+            //    1     i     j     k
+            {  1.0,  0.0,  0.0,  0.0 }, // 1
+            {  0.0, -1.0,  0.0,  0.0 }, // i
+            {  0.0,  0.0, -1.0,  0.0 }, // j
+            {  0.0,  0.0,  0.0,  1.0 }  // k
+        },
+        {
+            // i
+            //    1     i     j     k
+            {  0.0,  1.0,  0.0,  0.0 }, // 1
+            {  1.0,  0.0,  0.0,  0.0 }, // i
+            {  0.0,  0.0,  0.0, -1.0 }, // j
+            {  0.0,  0.0, -1.0,  0.0 }  // k
+        },
+        {
+            // j
+            //    1     i     j     k
+            {  0.0,  0.0,  1.0,  0.0 }, // 1
+            {  0.0,  0.0,  0.0, -1.0 }, // i
+            {  1.0,  0.0,  0.0,  0.0 }, // j
+            {  0.0, -1.0,  0.0,  0.0 }  // k
+        },
+        {
+            // k
+            //    1     i     j     k
+            {  0.0,  0.0,  0.0,  1.0 }, // 1
+            {  0.0,  0.0,  1.0,  0.0 }, // i
+            {  0.0,  1.0,  0.0,  0.0 }, // j
+            {  1.0,  0.0,  0.0,  0.0 }  // k
+        }
+    };
+    using Bicomplex = Algebra<double, 4, bicomplex_pt>;
+
+    ////////////////     Octonion    ///////////////
+    // Октонионы (построение Кэли — Диксона из кватернионов).
+    inline constexpr double octonion_pt[8][8][8]
+    {
+        {
+            // 1
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // 1
+            {  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e1
+            {  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e2
+            {  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0 }, // e3
+            {  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0 }, // e4
+            {  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0 }, // e5
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0 }, // e6
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0 }  // e7
+        },
+        {
+            // e1
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // 1
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e1
+            {  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0 }, // e2
+            {  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e3
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0 }, // e4
+            {  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0 }, // e5
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0 }, // e6
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0 }  // e7
+        },
+        {
+            // e2
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // 1
+            {  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0 }, // e1
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e2
+            {  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e3
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0 }, // e4
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0 }, // e5
+            {  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0 }, // e6
+            {  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0 }  // e7
+        },
+        {
+            // e3
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0 }, // 1
+            {  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e1
+            {  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e2
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e3
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0 }, // e4
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0 }, // e5
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0 }, // e6
+            {  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0 }  // e7
+        },
+        {
+            // e4
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0 }, // 1
+            {  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0 }, // e1
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0 }, // e2
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0 }, // e3
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e4
+            {  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e5
+            {  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e6
+            {  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0 }  // e7
+        },
+        {
+            // e5
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0 }, // 1
+            {  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0 }, // e1
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0 }, // e2
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0 }, // e3
+            {  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e4
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e5
+            {  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0 }, // e6
+            {  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }  // e7
+        },
+        {
+            // e6
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0 }, // 1
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0 }, // e1
+            {  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0 }, // e2
+            {  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0,  0.0 }, // e3
+            {  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e4
+            {  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0,  0.0 }, // e5
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e6
+            {  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }  // e7
+        },
+        {
+            // e7
+            //    1    e1    e2    e3    e4    e5    e6    e7
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  1.0 }, // 1
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  0.0, -1.0,  0.0 }, // e1
+            {  0.0,  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0 }, // e2
+            {  0.0,  0.0,  0.0,  0.0,  1.0,  0.0,  0.0,  0.0 }, // e3
+            {  0.0,  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0 }, // e4
+            {  0.0,  0.0, -1.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e5
+            {  0.0,  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }, // e6
+            {  1.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0,  0.0 }  // e7
+        }
+    };
+    using Octonion = Algebra<double, 8, octonion_pt>;
 }
 
 #endif
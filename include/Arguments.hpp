@@ -0,0 +1,55 @@
+#ifndef ALFRACTAL_ARGUMENTS
+#define ALFRACTAL_ARGUMENTS
+
+#include <cinttypes>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+
+namespace alfrac
+{
+    ////////////////    arguments    ///////////////
+    // Разбор числовых значений ключей командной строки программ.
+    // Значение принимается, лишь если строка целиком - число в заданных пределах: "-1" не превращается в большое
+    // целое без знака, а "12abc" и числа вне диапазона типа дают ошибку, а не исключение.
+    namespace arguments
+    {
+        constexpr size_t max_workers = 4096; // Наибольшее число потоков-вычислителей в ключе -j.
+
+        // Разбор десятичного числа в пределах [min, max]; false при ошибке (value при этом не изменяется).
+        bool parse_unsigned(const char* text, uint64_t& value, uint64_t min, uint64_t max);
+        bool parse_signed(const char* text, int64_t& value, int64_t min, int64_t max);
+        bool parse_real(const char* text, double& value, double min, double max); // Бесконечности и NaN не допускаются.
+
+        // Пределы не участвуют в выводе типа: parse(text, size, 1) для size_t size.
+        template <class T>
+        using Bound = typename std::common_type<T>::type;
+
+        // Разбор значения числовой переменной в пределах [min, max] (по умолчанию - весь диапазон её типа).
+        template <class T>
+        bool parse(const char* text, T& value, Bound<T> min = std::numeric_limits<T>::lowest(), Bound<T> max = std::numeric_limits<T>::max())
+        {
+            if constexpr (std::is_floating_point<T>::value)
+            {
+                double parsed = 0.0;
+                if (!parse_real(text, parsed, static_cast<double>(min), static_cast<double>(max))) { return false; }
+                value = static_cast<T>(parsed);
+            }
+            else if constexpr (std::is_signed<T>::value)
+            {
+                int64_t parsed = 0;
+                if (!parse_signed(text, parsed, static_cast<int64_t>(min), static_cast<int64_t>(max))) { return false; }
+                value = static_cast<T>(parsed);
+            }
+            else
+            {
+                uint64_t parsed = 0;
+                if (!parse_unsigned(text, parsed, static_cast<uint64_t>(min), static_cast<uint64_t>(max))) { return false; }
+                value = static_cast<T>(parsed);
+            }
+            return true;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef ALFRACTAL_COMPLETIONQUEUE
+#define ALFRACTAL_COMPLETIONQUEUE
+
+#include <atomic>
+#include <utility>
+
+namespace alfrac
+{
+    ////////////////  CompletionQueue  ///////////////
+    // Очередь уведомлений о готовности результатов без блокировок.
+    // Помещать элементы могут любые потоки (потоки-вычислители), извлекать - лишь один (поток интерфейса).
+    // Очередь - односвязный список с фиктивным первым узлом: добавление - один обмен указателя на последний узел,
+    // извлечение не требует атомарных операций чтения-записи. Добавленный элемент становится видимым извлекающему
+    // потоку, как только добавивший поток свяжет его с предыдущим узлом.
+    template <class Item>
+    class CompletionQueue
+    {
+    public:
+        CompletionQueue();
+        // Запрет конструктора-копирования.
+        CompletionQueue(const CompletionQueue&) = delete;
+        ~CompletionQueue();
+
+        void push(Item item); // Добавление элемента (из любого потока).
+        bool pop(Item& item); // Извлечение элемента (из одного потока); false, если очередь пуста.
+
+        // Запрет присвоения-копирования.
+        CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    protected:
+        struct Node
+        {
+            std::atomic<Node*> next{nullptr};
+            Item item;
+        };
+
+        std::atomic<Node*> last; // Последний добавленный узел (общий для добавляющих потоков).
+        Node* first;             // Фиктивный узел: следующий за ним содержит первый элемент (лишь для извлекающего потока).
+
+    private:
+
+    };
+
+    template <class Item>
+    CompletionQueue<Item>::CompletionQueue()
+    {
+        first = new Node();
+        last.store(first, std::memory_order_relaxed);
+    }
+
+    template <class Item>
+    CompletionQueue<Item>::~CompletionQueue()
+    {
+        while (first)
+        {
+            Node* next = first->next.load(std::memory_order_relaxed);
+            delete first;
+            first = next;
+        }
+    }
+
+    template <class Item>
+    void CompletionQueue<Item>::push(Item item)
+    {
+        Node* node = new Node();
+        node->item = std::move(item);
+        Node* previous = last.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    template <class Item>
+    bool CompletionQueue<Item>::pop(Item& item)
+    {
+        Node* next = first->next.load(std::memory_order_acquire);
+        if (!next) { return false; }
+
+        // Узел с извлечённым элементом становится новым фиктивным.
+        item = std::move(next->item);
+        next->item = Item();
+        delete first;
+        first = next;
+        return true;
+    }
+}
+
+#endif
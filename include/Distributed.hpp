@@ -0,0 +1,163 @@
+#ifndef ALFRACTAL_DISTRIBUTED
+#define ALFRACTAL_DISTRIBUTED
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <future>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    // Обсчёт на нескольких процессах и машинах.
+    // Адрес - "unix:ПУТЬ" (Unix-сокет) или "УЗЕЛ:ПОРТ" (TCP; при ожидании подключений узел можно опустить), см. Socket.hpp.
+    // Сообщения - кадры с заголовком (сигнатура "AFWP", тип, длина) и содержимым в формате wire (см. Wire.hpp).
+    // Подключившись, вычислитель сообщает версию протокола, итерационную формулу (см. Fractal::formula()) и число
+    // потоков; запросы и результаты сопровождаются номером, назначенным координатором.
+
+    ////////////////  WorkerServer   ///////////////
+    // Вычислитель: принимает запросы координаторов и обсчитывает их своим Fractal (с его хранилищем и очередью).
+    // Соединения обслуживаются независимо; результат отправляется, как только готов (порядок не сохраняется).
+    // При разрыве соединения его незавершённые запросы отменяются.
+    class WorkerServer
+    {
+    public:
+        explicit WorkerServer(std::shared_ptr<Fractal> init_fractal);
+        // Запрет конструктора-копирования.
+        WorkerServer(const WorkerServer&) = delete;
+        ~WorkerServer();
+
+        bool serve(const std::string& address); // Приём подключений (не возвращается, пока принимаются; false, если адрес занят или неверен).
+
+        // Запрет присвоения-копирования.
+        WorkerServer& operator=(const WorkerServer&) = delete;
+
+    protected:
+        // Соединение с координатором.
+        struct Connection
+        {
+            ~Connection(); // Сокет закрывается с последней ссылкой (её держат и уведомления незавершённых запросов).
+
+            int socket = -1;
+            std::mutex mutex_send; // mutex для контроля записи в сокет.
+            std::mutex mutex_requests;                                         // mutex для контроля доступа к requests.
+            std::unordered_map<uint64_t, Scheduler::CancelToken> requests;     // Признаки отмены незавершённых запросов.
+            std::atomic<bool> closed{false}; // Поток соединения завершён (его можно присоединить).
+        };
+
+        // Запрос в обработке: результат отправляется тем, кто вторым из двоих (уведомление о готовности и поток,
+        // получивший future) отметит свою часть.
+        struct Pending
+        {
+            std::mutex mutex_state;
+            std::future<Fractal::Data> future;
+            bool attached = false; // future получен.
+            bool ready    = false; // Уведомление о готовности получено.
+        };
+
+        std::shared_ptr<Fractal> fractal;
+
+        // Опорные орбиты последних видов: тайлы одного вида разделяют орбиту, как и в одном процессе.
+        std::vector<std::shared_ptr<ReferenceOrbit>> references;
+        std::mutex mutex_references;
+
+        std::vector<std::thread> threads; // Потоки соединений (параллельно connections).
+        std::vector<std::shared_ptr<Connection>> connections;
+        std::mutex mutex_connections;
+
+        void _serve_connection(std::shared_ptr<Connection> connection); // Чтение запросов соединения до его разрыва.
+        void _complete(const std::shared_ptr<Connection>& connection, uint64_t id, Pending& pending, bool notified); // Отметка готовности и отправка результата.
+        std::shared_ptr<ReferenceOrbit> _reference(const mpf_vector_2d& center, mp_bitcnt_t precision, int64_t iterations_limit, const mpf_class& max_absolute);
+
+    private:
+
+    };
+
+
+
+    ////////////////   Coordinator   ///////////////
+    // Распределение запросов между вычислителями (см. WorkerServer).
+    // Запросы ожидают в общей очереди с приоритетами и отправляются вычислителю с наименьшей загрузкой (число
+    // запросов в обработке на поток), не более двух на поток, так что быстрые машины получают больше работы.
+    // Соединение с каждым вычислителем обслуживает свой поток: он подключается (и переподключается после разрыва
+    // раз в секунду), принимает результаты и при разрыве возвращает незавершённые запросы в очередь для отправки
+    // другим вычислителям. Запрос, на котором соединение разрывалось max_attempts раз, завершается исключением.
+    // Отменённые запросы удаляются из очереди; отправленные досчитываются, но их результат не нужен.
+    class Coordinator
+    {
+    public:
+        static constexpr size_t max_attempts = 3; // Число отправок одного запроса.
+
+        explicit Coordinator(const std::vector<std::string>& init_addresses);
+        explicit Coordinator(const std::string& addresses); // Адреса через запятую.
+        // Запрет конструктора-копирования.
+        Coordinator(const Coordinator&) = delete;
+        ~Coordinator();
+
+        std::future<Fractal::Data> request_calc(const Fractal::Request& request); // Запрос (уведомление Request::notify поддерживается).
+        void discard_cancelled(); // Удалить отменённые запросы из очереди.
+        void reprioritise();      // Перечитать изменяемые приоритеты запросов в очереди.
+        void terminate();         // Закрыть соединения (ожидающие запросы отбрасываются).
+
+        size_t get_workers_number() const; // Число потоков подключённых вычислителей.
+        int64_t get_queue_length() const;  // Число запросов, ожидающих отправки.
+
+        // Запрет присвоения-копирования.
+        Coordinator& operator=(const Coordinator&) = delete;
+
+    protected:
+        // Запрос в очереди или в обработке.
+        struct Task
+        {
+            uint64_t id;
+            double priority;
+            uint64_t sequence;
+            std::shared_ptr<const std::vector<uint8_t>> payload; // Запрос в формате wire.
+            std::shared_ptr<std::promise<Fractal::Data>> promise;
+            std::function<void()> notify;
+            Scheduler::CancelToken cancelled;
+            Scheduler::PriorityToken priority_token; // Изменяемый приоритет (может отсутствовать).
+            size_t attempts = 0; // Число отправок.
+        };
+        // Порядок в куче: на вершине запрос с наименьшим приоритетом, при равенстве - поступивший раньше.
+        struct TaskCompare
+        {
+            bool operator()(const Task& left, const Task& right) const;
+        };
+
+        // Соединение с вычислителем.
+        struct Worker
+        {
+            std::string address;
+            int socket = -1;
+            bool connected = false;
+            uint64_t generation = 0; // Номер подключения: отправка, назначенная прежнему подключению, не выполняется.
+            size_t threads = 0; // Потоков у вычислителя.
+            std::unordered_map<uint64_t, Task> in_flight; // Отправленные запросы.
+            std::mutex mutex_send; // mutex для контроля записи в сокет (и его закрытия; захватывается до mutex_state).
+            std::thread thread;    // Поток соединения.
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<Task> pending; // Очередь запросов (двоичная куча).
+        uint64_t next_id = 1;
+        uint64_t next_sequence = 0;
+        mutable std::mutex mutex_state; // mutex для контроля доступа к pending и состоянию вычислителей.
+        std::atomic<bool> terminated{false};
+
+        void _run_worker(Worker& worker); // Поток соединения: подключение, приём результатов, переподключение.
+        void _dispatch();                 // Отправка запросов из очереди вычислителям со свободными местами.
+
+    private:
+
+    };
+}
+
+#endif
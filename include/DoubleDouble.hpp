@@ -0,0 +1,111 @@
+#ifndef ALFRACTAL_DOUBLEDOUBLE
+#define ALFRACTAL_DOUBLEDOUBLE
+
+#include <cmath>
+
+namespace algebra
+{
+    ////////////////  DoubleDouble   ///////////////
+    // Число с плавающей точкой двойной-двойной точности (около 106 бит мантиссы).
+    // Значение представляется неупорядоченной суммой hi + lo, где |lo| <= ulp(hi) / 2.
+    class DoubleDouble
+    {
+    public:
+        double hi;
+        double lo;
+
+        DoubleDouble()
+            : hi{0.0}, lo{0.0}
+        { }
+        DoubleDouble(double init_hi)
+            : hi{init_hi}, lo{0.0}
+        { }
+        explicit DoubleDouble(double init_hi, double init_lo)
+            : hi{init_hi}, lo{init_lo}
+        { }
+
+        // Приближение числом двойной точности.
+        explicit operator double() const
+        { return hi + lo; }
+
+        // Нахождение противоположного элемента.
+        DoubleDouble operator-() const
+        { return DoubleDouble(-hi, -lo); }
+
+        // Сложение и вычитание.
+        DoubleDouble& operator+=(const DoubleDouble& right)
+        {
+            double s, e;
+            two_sum(hi, right.hi, s, e);
+            double t, f;
+            two_sum(lo, right.lo, t, f);
+            e += t;
+            quick_two_sum(s, e, s, e);
+            e += f;
+            quick_two_sum(s, e, hi, lo);
+            return *this;
+        }
+        DoubleDouble& operator-=(const DoubleDouble& right)
+        { return *this += -right; }
+
+        // Умножение.
+        DoubleDouble& operator*=(const DoubleDouble& right)
+        {
+            double p = hi * right.hi;
+            double e = std::fma(hi, right.hi, -p); // Точная ошибка округления произведения старших частей.
+            e += hi * right.lo + lo * right.hi;
+            quick_two_sum(p, e, hi, lo);
+            return *this;
+        }
+
+        // Деление (используется редко, поэтому достаточно одной итерации уточнения).
+        DoubleDouble& operator/=(const DoubleDouble& right)
+        {
+            double q1 = hi / right.hi;
+            DoubleDouble remainder = *this;
+            remainder -= right * DoubleDouble(q1);
+            double q2 = remainder.hi / right.hi;
+            quick_two_sum(q1, q2, hi, lo);
+            return *this;
+        }
+
+        // Сравнение.
+        friend bool operator<(const DoubleDouble& left, const DoubleDouble& right)
+        { return left.hi < right.hi || (left.hi == right.hi && left.lo < right.lo); }
+        friend bool operator>(const DoubleDouble& left, const DoubleDouble& right)
+        { return right < left; }
+        friend bool operator==(const DoubleDouble& left, const DoubleDouble& right)
+        { return left.hi == right.hi && left.lo == right.lo; }
+        friend bool operator!=(const DoubleDouble& left, const DoubleDouble& right)
+        { return !(left == right); }
+
+        friend DoubleDouble operator+(DoubleDouble left, const DoubleDouble& right)
+        { return left += right; }
+        friend DoubleDouble operator-(DoubleDouble left, const DoubleDouble& right)
+        { return left -= right; }
+        friend DoubleDouble operator*(DoubleDouble left, const DoubleDouble& right)
+        { return left *= right; }
+        friend DoubleDouble operator/(DoubleDouble left, const DoubleDouble& right)
+        { return left /= right; }
+
+    protected:
+        // Точная сумма двух чисел: a + b = s + e.
+        static void two_sum(double a, double b, double& s, double& e)
+        {
+            s = a + b;
+            double v = s - a;
+            e = (a - (s - v)) + (b - v);
+        }
+        // Точная сумма двух чисел при условии |a| >= |b|.
+        static void quick_two_sum(double a, double b, double& s, double& e)
+        {
+            s = a + b;
+            e = b - (s - a);
+        }
+
+    private:
+
+    };
+}
+
+#endif
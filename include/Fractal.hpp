@@ -2,21 +2,19 @@
 #define ALFRACTAL_FRACTAL
 
 #include <cinttypes>
-#include <queue>
+#include <vector>
 #include <memory>
-#include <shared_mutex>
 #include <future>
+#include <functional>
 
 #include <gmpxx.h>
 #include "Algebra.hpp"
+#include "DoubleDouble.hpp"
+#include "Scheduler.hpp"
+#include "IterationTable.hpp"
 
 namespace alfrac
 {
-    ////////////////      CONST      ///////////////
-    const mp_bitcnt_t precision_bits = 128;
-
-
-
     ////////////////     STRUCTS     ///////////////
     // Вектор с координатами типа mpf_class.
     struct mpf_vector_2d
@@ -55,33 +53,27 @@ namespace alfrac
 
 
     ////////////////     Algebra     ///////////////
-    // Таблица произведений для алгебры.
-    const mpf_class product_tensor_mpf[2][2][2]
-    {
-        {
-            // x_1
-            // 1                            2
-            { mpf_class(1, precision_bits), mpf_class(0,  precision_bits) }, // 1
-            { mpf_class(0, precision_bits), mpf_class(-1, precision_bits) }  // 2
-        },
-        {
-            // x_2
-            // 1                            2
-            { mpf_class(0, precision_bits), mpf_class(1, precision_bits) }, // 1
-            { mpf_class(1, precision_bits), mpf_class(0, precision_bits) }  // 2
-        }
-    };
-
-    // Тип элемента алгебры.
-    using alg_mpf = algebra::Algebra<mpf_class, 2, product_tensor_mpf>;
+    // Типы элементов алгебры для разных уровней точности.
+    using alg_mpf    = algebra::Algebra<mpf_class, 2, algebra::complex_pt>;
+    using alg_dd     = algebra::Algebra<algebra::DoubleDouble, 2, algebra::complex_pt>;
+    using alg_double = algebra::Complex;
 
 
 
     ////////////////     Fractal     ///////////////
+    class ReferenceOrbit; // Опорная орбита для расчёта методом возмущений (см. Perturbation.hpp).
+    class TileStore;      // Хранилище обсчитанных регионов на диске (см. TileStore.hpp).
+    class Instrumentation; // Счётчики и трассировка конвейера обсчёта (см. Instrumentation.hpp).
+    class Coordinator;     // Распределение запросов между процессами и машинами (см. Distributed.hpp).
+
     // Класс для проведения расчётов, связанных с вычислением структуры фрактала.
     class Fractal
     {
     public:
+        class Progress; // Промежуточные результаты прогрессивного обсчёта (определён ниже).
+        struct Data;    // Результаты обсчёта региона (определена ниже).
+        struct Orbits;  // Состояние орбит для продолжения расчёта (определена ниже).
+
         // Структура для хранения и передачи данных о запросе на обсчёт региона алгебраической плоскости.
         struct Request
         {
@@ -92,9 +84,35 @@ namespace alfrac
             size_t grid_x;
             size_t grid_y;
 
-            mp_bitcnt_t precision;    // Точность арифметики чисел с плавающей точкой.
+            mp_bitcnt_t precision;    // Точность координат прямоугольника (точность арифметики выбирается автоматически, см. required_precision()).
             int64_t iterations_limit; // Максимальное число итераций на одну точку сетки.
             mpf_class max_absolute;   // Максимальное значение модуля числа.
+
+            std::shared_ptr<ReferenceOrbit> reference; // Опорная орбита вида (если задана, глубокие приближения считаются методом возмущений).
+            std::shared_ptr<Progress> progress;        // Приёмник промежуточных результатов (если задан, сетка обсчитывается прогрессивно, от грубой к точной).
+            bool subdivide = false;                    // Пропускать ли однородные области сетки (метод Мариани-Силвера; прогрессивный режим при этом не используется).
+            bool smooth = false;                       // Вычислять ли непрерывное число итераций (Data::smooth).
+
+            // Продолжение расчёта с большим числом итераций (см. Orbits).
+            bool keep_orbits = false;             // Сохранять ли в результате состояние орбит точек, не покинувших круг (не используется с subdivide).
+            std::shared_ptr<const Data> resume;   // Результат того же региона и сетки с не большим iterations_limit: покинувшие круг точки
+                                                  // берутся из него, остальные итерируются дальше из сохранённого состояния. Результат без
+                                                  // сохранённых орбит или полученный иным уровнем точности игнорируется (расчёт с начала).
+
+            // Планирование.
+            double priority = 0.0;           // Приоритет (запросы с меньшим значением обрабатываются раньше).
+            Scheduler::PriorityToken priority_token; // Изменяемый приоритет (если задан, заменяет priority; новое значение
+                                                     // учитывается очередью после вызова Fractal::reprioritise()).
+            Scheduler::CancelToken cancelled; // Признак отмены (если задан; проверяется в очереди и между столбцами сетки).
+            std::function<void()> notify;     // Уведомление о готовности future (результат или исключение); вызывается потоком-
+                                              // вычислителем или, если результат найден в хранилище, в request_calc(). Запрос,
+                                              // отменённый до начала расчёта, уведомления не получает.
+        };
+
+        // Исключение, передаваемое через future отменённого во время расчёта запроса.
+        struct Cancelled : public std::exception
+        {
+            const char* what() const noexcept override;
         };
 
         // Структура для хранения и передачи данных о результатах обсчёта региона.
@@ -104,14 +122,66 @@ namespace alfrac
             size_t grid_x;
             size_t grid_y;
 
-            std::vector<int64_t> iterations; // Таблица числа итераций для каждой точки.
+            IterationTable iterations;       // Таблица числа итераций для каждой точки (в наименьшем типе, вмещающем iterations_limit).
+            std::vector<float> smooth;       // Непрерывное число итераций в том же порядке (лишь при Request::smooth, иначе пуста):
+                                             // дробная часть сглаживает границы полос; не покинувшие круг точки получают iterations_limit.
             int64_t iterations_limit;        // Максимальное число итераций на одну точку сетки.
+            size_t stride = 1;               // Шаг по обеим осям, с которым заполнена таблица (точка (x, y) приближается точкой,
+                                             // округлённой вниз до кратных stride координат); 1 - таблица заполнена полностью.
+            std::shared_ptr<const Orbits> orbits; // Состояние орбит (лишь при Request::keep_orbits).
 
             Data();
             explicit Data(const Fractal::Request& request); // Автоматическая настройка метаданных по данным о запросе.
         };
 
-        Fractal();
+        // Промежуточные результаты прогрессивного обсчёта.
+        // Вычислитель публикует таблицу после каждого прохода, интерфейс забирает её, когда успевает.
+        class Progress
+        {
+        public:
+            Progress();
+            explicit Progress(std::function<void()> init_notify); // notify вызывается после каждой публикации.
+
+            void publish(const Fractal::Data& partial); // Публикация результата очередного прохода.
+            bool fetch(Fractal::Data& partial, uint64_t& known_generation); // Получение результата, если он новее known_generation.
+
+        protected:
+            Fractal::Data data;      // Последний опубликованный результат.
+            uint64_t generation = 0; // Число публикаций.
+            std::mutex mutex_data;   // mutex для контроля доступа к data.
+            std::function<void()> notify; // Уведомление о публикации (может отсутствовать).
+        };
+
+        // Уровень точности арифметики, используемый при обсчёте.
+        enum class Tier
+        {
+            Double,       // Числа двойной точности (53 бита).
+            DoubleDouble, // Числа двойной-двойной точности (106 бит).
+            Perturbation, // Метод возмущений: отклонения от опорной орбиты в double.
+            Mpf           // Длинная арифметика GMP.
+        };
+
+        // Состояние орбит точек, не покинувших круг за iterations_limit итераций: продолжение итерирования из него
+        // даёт тот же результат, что и расчёт с начала с большим iterations_limit.
+        struct Orbits
+        {
+            static constexpr uint32_t none = UINT32_MAX; // Точка без состояния: покинула круг или признана принадлежащей множеству.
+
+            Fractal::Tier tier;             // Уровень точности, которым получены состояния.
+            mp_bitcnt_t precision = 0;      // Точность длинной арифметики (Tier::Mpf) или опорной орбиты (Tier::Perturbation).
+            mpf_vector_2d reference_center; // Опорная точка (Tier::Perturbation).
+            size_t state_size = 0;          // Число значений в состоянии одной точки.
+            std::vector<uint32_t> slots;    // Номер состояния каждой точки сетки (в порядке Data::iterations) или none.
+            std::vector<double> values;     // Состояния в double (все уровни, кроме Tier::Mpf).
+            std::vector<mpf_class> mpf_values; // Состояния в длинной арифметике (Tier::Mpf).
+
+            // Согласованы ли состояния с сеткой из points точек и ядром, состояние точки которого - kernel_state_size значений:
+            // номера состояний не выходят за пределы массива состояний уровня tier.
+            bool is_consistent(size_t points, size_t kernel_state_size) const;
+            size_t memory_usage() const; // Занимаемая память в байтах (оценка).
+        };
+
+        explicit Fractal(size_t workers_number = 0); // Число потоков-вычислителей (0 - по числу аппаратных потоков).
         Fractal(const Fractal& fractal) = delete; // Запрет конструктора-копирования.
         ~Fractal();
 
@@ -119,22 +189,43 @@ namespace alfrac
         Fractal::Data calculate(const Fractal::Request& request);                 // Расчёт в текущем потоке.
         std::future<Fractal::Data> request_calc(const Fractal::Request& request); // Запрос на проведение расчётов в отдельном потоке.
 
-        void loop();            // Цикл для рассчётов.
-        void terminate_loops(); // Завершить все циклы рассчётов.
+        // Выбор точности по масштабу.
+        static mp_bitcnt_t required_precision(const Fractal::Request& request); // Число бит, достаточное для различения соседних точек сетки.
+        static Fractal::Tier choose_tier(const Fractal::Request& request);      // Наиболее дешёвый уровень точности, достаточный для запроса.
+        static size_t state_size(Fractal::Tier tier);                           // Число значений в состоянии точки ядра уровня tier (см. Orbits).
+        static const char* formula();                                           // Обозначение итерационной формулы и алгебры (входит в ключ TileStore).
+
+        // Подключение хранилища на диске: найденные в нём запросы не обсчитываются, обсчитанные - записываются.
+        // Вызывается до первого запроса.
+        void set_store(std::shared_ptr<TileStore> new_store);
+
+        // Подключение удалённых вычислителей: запросы, не найденные в хранилище, отправляются им вместо местной
+        // очереди (результаты записывают хранилища вычислителей). Вызывается до первого запроса.
+        void set_remote(std::shared_ptr<Coordinator> new_remote);
+
+        // Подключение счётчиков и трассировки обсчёта. Вызывается до первого запроса.
+        void set_instrumentation(std::shared_ptr<Instrumentation> new_instrumentation);
+        std::shared_ptr<Instrumentation> get_instrumentation() const;
+
+        void discard_cancelled(); // Удалить отменённые запросы из очереди.
+        void reprioritise();      // Перечитать изменяемые приоритеты запросов в очереди (Request::priority_token).
+        void terminate_loops(); // Завершить работу потоков-вычислителей.
+        size_t get_workers_number() const; // Число потоков-вычислителей.
+        int64_t get_queue_length() const; // Число запросов в очереди.
+        std::vector<Scheduler::Utilization> get_utilization() const; // Время работы и простоя каждого потока-вычислителя.
 
         Fractal& operator=(const Fractal& right) = delete; // Запрет присвоения-копирования.
 
     protected:
-        // Запросы.
-        std::queue< std::pair< Fractal::Request, std::promise< Fractal::Data> > > requests_queue; // Очередь запросов на обсчёт.
-        std::shared_mutex mutex_requests_queue;   // shared_mutex для контроля доступа к requests_queue.
+        Fractal::Data _calculate(const Fractal::Request& request); // Внутренняя версия расчёта.
 
-        // Механизмы синфронизации.
-        std::atomic<bool> in_loop = true;           // Переменная для контроля циклов расчётов.
-        std::condition_variable condition_requests; // Условная переменная для реализации функции ожидания.
-        std::mutex mutex_condition_requests;        // mutex для реализации функции ожидания.
 
-        Fractal::Data _calculate(const Fractal::Request& request); // Внутренняя версия расчёта.
+        std::shared_ptr<TileStore> store; // Хранилище обсчитанных регионов (может отсутствовать).
+        std::shared_ptr<Instrumentation> instrumentation; // Счётчики и трассировка (могут отсутствовать).
+        std::shared_ptr<Coordinator> remote; // Удалённые вычислители (могут отсутствовать).
+
+        // Пул потоков-вычислителей (объявлен последним, чтобы потоки завершались раньше разрушения остальных полей).
+        Scheduler scheduler;
 
     private:
 
@@ -3,26 +3,101 @@
 
 #include <cinttypes>
 #include <memory>
+#include <list>
 #include <unordered_map>
+#include <vector>
 #include <SFML/Graphics.hpp>
 #include "Fractal.hpp"
+#include "Palette.hpp"
+#include "CompletionQueue.hpp"
 
 namespace alfrac
 {
     // Получение прямоугольника, в котором полностью лежит область видимости sf::View
     sf::FloatRect getViewBounds(const sf::View& view);
 
+    ////////////////    TileAtlas    ///////////////
+    // Общие текстуры для изображений тайлов.
+    // Каждая страница атласа - большая текстура, разбитая на ячейки размером с тайл; тайл занимает ячейку и загружает
+    // в неё лишь свой прямоугольник. Все тайлы одной страницы рисуются одним массивом вершин, поэтому число смен текстуры
+    // и вызовов отрисовки за кадр определяется числом страниц, а не тайлов. Страница, лишившаяся всех тайлов,
+    // освобождает текстуру.
+    class TileAtlas
+    {
+    public:
+        // Ячейка атласа.
+        struct Slot
+        {
+            size_t page = 0;       // Номер страницы.
+            sf::IntRect rectangle; // Прямоугольник ячейки на текстуре страницы.
+        };
+
+        explicit TileAtlas(unsigned int init_slot_width, unsigned int init_slot_height);
+        // Запрет конструктора-копирования.
+        TileAtlas(const TileAtlas&) = delete;
+        // Запрет присвоения-копирования.
+        TileAtlas& operator=(const TileAtlas&) = delete;
+
+        bool allocate(Slot& slot);     // Выделение ячейки (false, если текстуру страницы создать не удалось).
+        void release(const Slot& slot); // Освобождение ячейки.
+        void update(const Slot& slot, const sf::Uint8* pixels); // Загрузка изображения (RGBA размером с ячейку) в ячейку.
+
+        size_t pages_number() const;
+        const sf::Texture* get_texture(size_t page) const; // Текстура страницы (nullptr, если страница пуста).
+        size_t get_slots_used() const;                   // Число занятых ячеек.
+        unsigned int get_slot_width() const;
+        unsigned int get_slot_height() const;
+
+    protected:
+        // Страница атласа.
+        struct Page
+        {
+            std::unique_ptr<sf::Texture> texture; // Текстура (отсутствует у пустой страницы).
+            std::vector<unsigned int> free_slots; // Номера свободных ячеек.
+        };
+
+        unsigned int slot_width;
+        unsigned int slot_height;
+        unsigned int columns; // Ячеек в строке страницы.
+        unsigned int rows;    // Строк ячеек на странице.
+        std::vector<Page> pages;
+        size_t slots_used = 0;
+
+    private:
+
+    };
+
+
+
     ////////////////      Tile      ////////////////
     // Класс для отображения прямоугольной части фрактала.
+    // Изображение тайла хранится в ячейке атласа (см. TileAtlas); тайл рисуется GUI вместе с другими тайлами той же
+    // страницы атласа, сам по себе - лишь через sf::Drawable.
     class Tile : public sf::Drawable, public sf::Transformable
     {
     public:
-        Tile();
-        Tile(std::future<Fractal::Data> future); // Конструктор, принимающий на вход future для получения результатов обсчёта региона фрактала.
-        ~Tile();
+        Tile(); // Тайл без данных (запрос привязывается start()).
+        explicit Tile(Fractal::Data init_data); // Завершённый тайл с готовыми данными.
+        ~Tile(); // Незавершённый тайл при разрушении отменяет свой запрос.
+
+        // Привязка запроса: future для получения результатов обсчёта региона фрактала, признак отмены запроса,
+        // приёмник промежуточных результатов (для прогрессивного запроса) и изменяемый приоритет запроса.
+        void start(std::future<Fractal::Data> future, Scheduler::CancelToken init_cancelled = nullptr, std::shared_ptr<Fractal::Progress> init_progress = nullptr,
+                   Scheduler::PriorityToken init_priority = nullptr);
+        // Получение результата или промежуточного результата, если они готовы (не блокирует; вызывается по уведомлению
+        // о готовности, см. Fractal::Request::notify). Новые данные требуют раскраски.
+        void receive();
+        bool outdated(const Palette& palette) const; // Требуется ли раскраска (новые данные или смена палитры).
+        void adopt_image(Tile& previous); // Перенос изображения тайла того же региона: до раскраски новых данных виден прежний результат.
+        void cancel(); // Отмена запроса на обсчёт региона.
+        void set_priority(double new_priority); // Изменение приоритета запроса (учитывается после Fractal::reprioritise()).
+        bool completed() const; // Завершён ли обсчёт тайла.
+        const Fractal::Data& get_data() const; // Данные о регионе (результат или последний промежуточный результат).
+        size_t memory_usage() const; // Оценка занимаемой тайлом памяти (включая ячейку атласа) в байтах.
+        void recolour(const Palette& palette, const std::shared_ptr<TileAtlas>& atlas); // Раскраска данных палитрой и загрузка в ячейку атласа.
 
-        void check(); // Проверка окончания вычисления региона фрактала.
-        void recolour(sf::Color gradient_start = sf::Color::Black, sf::Color gradient_end = sf::Color::Blue, sf::Color error = sf::Color::Red); // Построение градиента.
+        const TileAtlas::Slot* get_slot() const; // Ячейка атласа с изображением тайла (nullptr, если изображения нет).
+        void append_vertices(sf::VertexArray& vertices) const; // Добавление четырёхугольника тайла (sf::Quads) в массив вершин страницы.
 
         // sf::Drawable
         virtual void draw(sf::RenderTarget &target, sf::RenderStates states) const override;
@@ -31,15 +106,120 @@ namespace alfrac
         std::future<Fractal::Data> _future; // Внутренний объект для ожидания результатов обсчёта региона фрактала.
         Fractal::Data data;                 // Данные о регионе фракткала.
         bool is_completed = false;          // Завершён ли обсчёт тайла.
+        Scheduler::CancelToken cancelled;   // Признак отмены запроса.
+        Scheduler::PriorityToken priority;  // Изменяемый приоритет запроса.
+        std::shared_ptr<Fractal::Progress> progress; // Приёмник промежуточных результатов.
+        uint64_t progress_generation = 0;            // Номер последнего отображённого промежуточного результата.
+
+        std::shared_ptr<TileAtlas> atlas; // Атлас, ячейку которого занимает тайл (отсутствует, пока ячейки нет).
+        TileAtlas::Slot slot;             // Ячейка атласа (коды пикселей после загрузки в неё не хранятся).
+        uint64_t palette_id = 0;          // Палитра, которой раскрашено изображение (0 - изображение не соответствует данным).
+
+    private:
+
+    };
+
+
+
+    ////////////////   TileAddress   ///////////////
+    // Положение тайла в пирамиде уровней детализации: тайл уровня level с номерами (x, y) покрывает квадрат
+    // [x, x + 1] x [y, y + 1], умноженный на 2^-level, алгебраической плоскости (ось y направлена вверх).
+    // Четыре тайла уровня level + 1 в точности покрывают один тайл уровня level, а адрес не зависит от центра
+    // и масштаба вида, поэтому тайлы переживают их смену.
+    struct TileAddress
+    {
+        int64_t level = 0;
+        mpz_class x;
+        mpz_class y;
+
+        TileAddress();
+        explicit TileAddress(int64_t init_level, mpz_class init_x, mpz_class init_y);
+
+        TileAddress parent() const;             // Тайл предыдущего уровня, содержащий данный.
+        TileAddress child(int dx, int dy) const; // Четверть тайла на следующем уровне (dx, dy - 0 или 1).
+        mpf_rectangle rectangle(mp_bitcnt_t precision) const; // Покрываемый прямоугольник.
 
-        std::vector<sf::Uint8> pixels; // Коды пикселей в формате RGBA.
-        sf::Texture texture;           // Текстура.
-        sf::Sprite sprite;             // Спрайт.
+        bool operator==(const TileAddress& right) const;
+    };
+
+    // Хэширование адреса тайла.
+    struct TileAddressHasher
+    {
+        std::size_t operator()(const TileAddress& address) const;
+    };
+
+
+
+    ////////////////    TileCache    ///////////////
+    // Таблица тайлов с ограничением по занимаемой памяти.
+    // Тайлы упорядочены по давности использования; при превышении бюджета удаляются давно не использованные тайлы,
+    // кроме отображаемых в данный момент.
+    class TileCache
+    {
+    public:
+        // Статистика обращений.
+        struct Statistics
+        {
+            uint64_t hits      = 0; // Найденные тайлы.
+            uint64_t misses    = 0; // Отсутствующие тайлы.
+            uint64_t evictions = 0; // Тайлы, удалённые из-за превышения бюджета.
+            size_t   tiles     = 0; // Число тайлов.
+            size_t   bytes     = 0; // Занимаемая память (на момент последнего trim()).
+        };
+
+        explicit TileCache(size_t init_budget);
+
+        // Поиск тайла. Найденный тайл становится последним использованным; если visible, он защищается от удаления
+        // до следующего вызова next_frame().
+        std::shared_ptr<Tile> find(const TileAddress& address, bool visible);
+        void insert(const TileAddress& address, std::shared_ptr<Tile> tile, bool visible); // Добавление тайла.
+        template <class Predicate>
+        void erase_if(Predicate predicate); // Удаление тайлов, для которых predicate(address, tile) истинно (не считаются вытеснением;
+                                            // незавершённые отменяют свои запросы, даже если тайл ещё отображается).
+        void clear(); // Удаление всех тайлов.
+
+        void next_frame(); // Снятие защиты с тайлов, отображавшихся до текущего обновления.
+        void trim();       // Вытеснение тайлов до соответствия бюджету.
+
+        void set_budget(size_t new_budget);
+        size_t get_budget() const;
+        const Statistics& get_statistics() const;
+
+    protected:
+        struct Entry
+        {
+            TileAddress address;
+            std::shared_ptr<Tile> tile;
+            uint64_t visible_frame; // Номер обновления, в котором тайл отображался последний раз.
+        };
+
+        std::list<Entry> entries; // Тайлы в порядке использования (в начале - последний использованный).
+        std::unordered_map<TileAddress, std::list<Entry>::iterator, TileAddressHasher> index; // Поиск тайлов по адресу.
+        size_t budget;            // Бюджет памяти в байтах.
+        uint64_t frame = 1;       // Номер текущего обновления.
+        Statistics statistics;
 
     private:
 
     };
 
+    template <class Predicate>
+    void TileCache::erase_if(Predicate predicate)
+    {
+        for (auto iterator = entries.begin(); iterator != entries.end(); )
+        {
+            if (predicate(iterator->address, *iterator->tile))
+            {
+                iterator->tile->cancel();
+                index.erase(iterator->address);
+                iterator = entries.erase(iterator);
+            }
+            else
+            { ++iterator; }
+        }
+        statistics.tiles = entries.size();
+    }
+
 
 
     ////////////////       GUI       ///////////////
@@ -61,19 +241,29 @@ namespace alfrac
             mpf_class     fractal_scale_factor = 1.0;                     // Текущий масштаб фрактала.
 
             // Точность вычисления фраткала.
-            mp_bitcnt_t precision        = 1024;
+            mp_bitcnt_t precision        = 1024; // Точность координат (пересчитывается по глубине приближения в rescale_fractal()).
             int64_t     iterations_limit = 64;
             mpf_class   max_absolute     = 4.0;
 
             // Интерфейс.
             bool draw_ui              = true;
-            bool request_on_downscale = false; // Стоит ли запращшивать новые тайлы, если масштаб меньше первоначального
-                                               // (включение данного параметра ведёт к уменьшению производительности при сильном отдалении камеры).
             size_t max_tiles_number = 1024;
+            bool   progressive      = true;  // Обсчитывать ли тайлы прогрессивно (сначала грубо, затем с уточнением).
+            bool   subdivide        = false; // Пропускать ли однородные области тайлов (метод Мариани-Силвера).
+            int    prefetch_margin  = 1;     // Ширина (в тайлах) полосы вокруг экрана, тайлы которой запрашиваются заранее с пониженным приоритетом.
+            int    fallback_levels  = 8;     // Сколько уровней вверх ищутся тайлы-предки, замещающие не готовые тайлы.
+            size_t tile_cache_budget = 256u << 20; // Бюджет памяти таблицы тайлов в байтах (отображаемые тайлы не вытесняются и при превышении).
+            bool   keep_orbits      = true;  // Сохранять ли орбиты точек тайлов, чтобы при увеличении числа итераций продолжать их, а не считать заново
+                                             // (кроме длинной арифметики, где состояние точки занимает сотни байт).
+            bool   smooth           = true;  // Вычислять ли непрерывное число итераций (раскраска без полос).
+            size_t palette          = 0;     // Номер палитры в Palette::presets().
+            double upload_budget_ms    = 4.0;        // Бюджет времени раскраски и загрузки тайлов на кадр в мс (при 60 кадрах/с кадр длится 16,7 мс).
+            size_t upload_budget_bytes = 4u << 20;   // Бюджет объёма загрузки изображений тайлов на кадр в байтах.
         };
         Settings settings;
 
         GUI(std::shared_ptr<Fractal> init_fractal);
+        GUI(std::shared_ptr<Fractal> init_fractal, const Settings& init_settings);
         ~GUI();
 
         void loop(); // Цикл отрисовки.
@@ -84,22 +274,30 @@ namespace alfrac
         sf::View view;           // Основная камера.
         sf::View ui_view;        // Камера для интерфейса.
 
-        //int64_t min_scale_power = 0; // минимальная степень приближения, при которой возможен запрос новых тайлов (см. Settings::request_on_downscale)
-
         // Тайлы.
-        // Временная реализация хэширования вектора с целыми координатамами.
-        struct _Vector2iHasher
-        {
-            std::size_t operator()(const sf::Vector2i& vector) const
-            {
-                return std::hash<int64_t>()(static_cast<int64_t>(vector.x) + (static_cast<int64_t>(vector.y) << 31 << 1));
-            }
-        };
-        std::unordered_map<sf::Vector2i, std::shared_ptr<Tile>, _Vector2iHasher> tiles; // Сетка отрисованных тайлов.
-        std::vector<std::shared_ptr<Tile>> onscreen_tiles; // Массив отображаемых тайлов.
+        TileCache tiles; // Сетка отрисованных тайлов.
+        std::vector<std::shared_ptr<Tile>> onscreen_tiles; // Массив отображаемых тайлов (в порядке рисования).
+        std::vector<int64_t> onscreen_layers;              // Слои отображаемых тайлов: тайлы одного слоя не перекрываются.
+        std::shared_ptr<TileAtlas> atlas;                  // Атлас изображений тайлов.
+        std::shared_ptr<CompletionQueue<std::weak_ptr<Tile>>> completions; // Тайлы, для которых готов результат или промежуточный результат.
+        std::vector<sf::VertexArray> atlas_vertices;       // Вершины тайлов каждой страницы атласа (переиспользуются между кадрами).
+        size_t draw_calls = 0;                             // Вызовов отрисовки тайлов в последнем кадре.
+
+        std::shared_ptr<ReferenceOrbit> reference; // Опорная орбита текущего вида (общая для всех его тайлов).
 
         void fetch_tiles(const sf::FloatRect& rectangle); // Обновление отображаемых тайлов, попавших в rectangle.
+        void change_iterations_limit(int64_t new_iterations_limit); // Смена числа итераций с пересчётом (продолжением) отображаемых тайлов.
+        Fractal::Request make_request(const TileAddress& address, float priority) const; // Запрос на обсчёт тайла по текущим настройкам.
+        std::shared_ptr<Tile> synthesise_tile(const TileAddress& address); // Тайл из четырёх завершённых тайлов следующего уровня (nullptr, если их нет).
+        void place_tile(Tile& tile, const TileAddress& address) const; // Положение и масштаб тайла в координатах вида.
+        std::shared_ptr<Tile> request_tile(Fractal::Request& request); // Тайл, обсчитываемый по запросу (с уведомлением через completions).
+        void receive_tiles(); // Получение результатов тайлов, о готовности которых пришли уведомления.
+        void draw_tiles(Instrumentation* instrumentation); // Раскраска (в пределах бюджета на кадр) и рисование отображаемых тайлов
+                                                           // (по вызову на страницу атласа и слой).
+        int64_t detail_level() const; // Уровень пирамиды, тексели которого не крупнее пикселей экрана.
+        mp_bitcnt_t level_precision(int64_t level) const; // Точность координат, достаточная для тайлов уровня level.
         void rescale_fractal(); // Изменение масштаба отрисовки фрактала.
+        void update_reference(); // Пересоздание опорной орбиты по текущему центру и параметрам точности.
 
     private:
 
@@ -0,0 +1,48 @@
+#ifndef ALFRACTAL_IMAGEWRITER
+#define ALFRACTAL_IMAGEWRITER
+
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace alfrac
+{
+    ////////////////   ImageWriter   ///////////////
+    // Построчная запись RGB-изображения в файл.
+    // Строки передаются сверху вниз по мере готовности, так что изображение целиком в памяти не хранится.
+    class ImageWriter
+    {
+    public:
+        ImageWriter(const ImageWriter& image_writer) = delete; // Запрет конструктора-копирования.
+        virtual ~ImageWriter();
+
+        // Создание записи в файл path; формат выбирается по расширению (.ppm или .png). nullptr при ошибке.
+        static std::unique_ptr<ImageWriter> open(const std::string& path, size_t width, size_t height);
+        // Кодирование изображения rgb (3 * width * height байт, строки сверху вниз) в память в формате format ("ppm"
+        // или "png"). false, если формат не поддерживается.
+        static bool encode(const std::string& format, const uint8_t* rgb, size_t width, size_t height, std::vector<uint8_t>& output);
+
+        virtual bool write_row(const uint8_t* rgb) = 0; // Запись очередной строки (3 * width байт).
+        virtual bool finish() = 0;                      // Завершение записи (после последней строки).
+
+        size_t get_width() const;
+        size_t get_height() const;
+
+        ImageWriter& operator=(const ImageWriter& right) = delete; // Запрет присвоения-копирования.
+
+    protected:
+        ImageWriter(std::FILE* init_file, size_t init_width, size_t init_height);
+
+        std::FILE* file;      // Файл изображения.
+        size_t width;
+        size_t height;
+        size_t rows_written = 0; // Число записанных строк.
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef ALFRACTAL_INSTRUMENTATION
+#define ALFRACTAL_INSTRUMENTATION
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace alfrac
+{
+    ////////////////  Instrumentation  ///////////////
+    // Счётчики и трассировка конвейера обсчёта.
+    // Счётчики (атомарные, без блокировок) собираются всегда. Отрезки времени и отсчёты длины очереди записываются,
+    // лишь пока включена трассировка, и выгружаются в формате Chrome trace event (chrome://tracing, Perfetto).
+    class Instrumentation
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // Накопленные значения счётчиков.
+        struct Snapshot
+        {
+            uint64_t tasks         = 0; // Обсчитанные запросы.
+            uint64_t queue_wait_ns = 0; // Суммарное время ожидания запросов в очереди.
+            uint64_t compute_ns    = 0; // Суммарное время обсчёта.
+            // Итерации по таблицам результатов: точки, признанные внутренними досрочно, засчитываются по пределу, а точки,
+            // заполненные подразбиением или продолженные с прежнего предела, - как обсчитанные с начала.
+            // Это не число выполненных итераций, а равноценное ему без досрочного выхода и повторного использования.
+            uint64_t limit_equivalent_iterations = 0;
+            uint64_t uploads       = 0; // Загрузки тайлов в текстуры.
+            uint64_t upload_ns     = 0; // Суммарное время раскраски и загрузки тайлов.
+        };
+
+        Instrumentation();
+        Instrumentation(const Instrumentation& instrumentation) = delete; // Запрет конструктора-копирования.
+        ~Instrumentation();
+
+        // Учёт событий (потокобезопасно).
+        void add_task(Clock::time_point submitted, Clock::time_point started, Clock::time_point finished, uint64_t limit_equivalent_iterations);
+        void add_upload(Clock::time_point started, Clock::time_point finished);
+        void add_queue_length(int64_t length); // Отсчёт длины очереди (только для трассировки).
+
+        Snapshot get_snapshot() const;
+
+        void set_tracing(bool enabled); // Включение/выключение записи трассировки (записанные события сохраняются).
+        bool is_tracing() const;
+        bool export_trace(const std::string& path); // Запись трассировки в файл JSON; false при ошибке.
+
+        Instrumentation& operator=(const Instrumentation& right) = delete; // Запрет присвоения-копирования.
+
+    protected:
+        // Событие трассировки: отрезок времени (phase 'X'), асинхронный отрезок, который может перекрываться с другими (phase 'A'),
+        // или значение счётчика (phase 'C').
+        struct Event
+        {
+            const char* name;
+            char phase;
+            uint32_t thread;
+            uint64_t start_ns;
+            uint64_t duration_ns;
+            int64_t value; // Итерации отрезка обсчёта (по пределу, см. Snapshot) или значение счётчика.
+        };
+
+        // Счётчики.
+        std::atomic<uint64_t> tasks{0};
+        std::atomic<uint64_t> queue_wait_ns{0};
+        std::atomic<uint64_t> compute_ns{0};
+        std::atomic<uint64_t> limit_equivalent_iterations{0};
+        std::atomic<uint64_t> uploads{0};
+        std::atomic<uint64_t> upload_ns{0};
+
+        // Трассировка.
+        Clock::time_point origin;     // Начало отсчёта времени событий.
+        std::atomic<bool> tracing{false};
+        std::vector<Event> events;    // Записанные события (не более max_events).
+        std::unordered_map<std::thread::id, uint32_t> threads; // Номера потоков в трассировке.
+        std::mutex mutex_events;      // mutex для контроля доступа к events и threads.
+
+        void _record(const char* name, char phase, Clock::time_point start, Clock::time_point finish, int64_t value); // Запись события.
+        uint64_t _since_origin(Clock::time_point time) const; // Время от начала отсчёта в наносекундах.
+
+    private:
+
+    };
+}
+
+#endif
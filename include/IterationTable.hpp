@@ -0,0 +1,69 @@
+#ifndef ALFRACTAL_ITERATIONTABLE
+#define ALFRACTAL_ITERATIONTABLE
+
+#include <cinttypes>
+#include <cstddef>
+#include <vector>
+
+namespace alfrac
+{
+    namespace wire
+    {
+        class Writer; // Запись двоичного представления (см. Wire.hpp).
+        class Reader; // Чтение двоичного представления (см. Wire.hpp).
+    }
+
+    //////////////// IterationTable  ///////////////
+    // Таблица чисел итераций точек сетки.
+    // Значения хранятся в наименьшем беззнаковом целом типе, вмещающем предельное число итераций (1, 2, 4 или 8 байт,
+    // порядок байт машины). Таблицу можно сжать (compress()): значения кодируются блоками по block_size точек как серии
+    // одинаковых значений (длина серии и разность со значением предыдущей серии, varint). Чтение доступно и в сжатом
+    // виде (распаковывается лишь нужный блок), запись распаковывает таблицу.
+    class IterationTable
+    {
+    public:
+        static constexpr size_t block_size = 256; // Точек в сжатом блоке.
+
+        IterationTable();
+        explicit IterationTable(size_t init_size, int64_t iterations_limit); // Таблица нулей.
+
+        size_t size() const;
+        bool empty() const;
+        uint32_t width() const; // Байт на значение (1, 2, 4 или 8).
+        static uint32_t width(int64_t iterations_limit); // Наименьшее число байт на значение, вмещающее iterations_limit.
+
+        // Доступ к значениям.
+        int64_t get(size_t index) const;
+        void set(size_t index, int64_t value);
+        void read(size_t first, size_t count, int64_t* output) const; // Чтение count подряд идущих значений.
+
+        // Несжатые значения (width() байт на точку) для быстрой обработки; nullptr, если таблица сжата.
+        const uint8_t* raw() const;
+        uint8_t* raw();
+
+        // Сжатие.
+        void compress();
+        void decompress();
+        bool compressed() const;
+
+        size_t memory_usage() const; // Занимаемая память в байтах.
+
+        // Двоичное представление: сжатая таблица передаётся блоками как есть, несжатая - значениями в порядке little-endian.
+        void save(wire::Writer& writer) const;
+        bool load(wire::Reader& reader); // false, если данные повреждены (таблица при этом пуста).
+
+    protected:
+        size_t count = 0;
+        uint32_t value_width = 8;
+        std::vector<uint8_t> bytes;   // Несжатые значения или сжатые блоки.
+        std::vector<uint32_t> blocks; // Смещения сжатых блоков в bytes и конец последнего (пуст для несжатой таблицы).
+
+        void _read_block(size_t block, int64_t* output) const; // Распаковка блока сжатой таблицы.
+        bool _check_block(size_t block) const; // Корректен ли сжатый блок (для данных, полученных извне).
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,613 @@
+#ifndef ALFRACTAL_KERNEL
+#define ALFRACTAL_KERNEL
+
+#include <cinttypes>
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    ////////////////     Kernel      ///////////////
+    // Ядра итерационного процесса z -> z^2 + c для разных уровней точности (см. Fractal::Tier).
+    // Ядро подготавливает параметры сетки запроса при создании и вычисляет число итераций для
+    // произвольного набора точек одного столбца сетки; порядок обхода сетки задаёт kernel::run().
+    namespace kernel
+    {
+        // Приведение числа длинной арифметики к аппаратному типу.
+        template <class field>
+        field convert(const mpf_class& value);
+
+        template <>
+        inline double convert<double>(const mpf_class& value)
+        { return value.get_d(); }
+
+        template <>
+        inline algebra::DoubleDouble convert<algebra::DoubleDouble>(const mpf_class& value)
+        {
+            double hi = value.get_d();
+            mpf_class rest(value - hi, value.get_prec());
+            return algebra::DoubleDouble(hi, rest.get_d());
+        }
+
+        // Проверка отмены запроса.
+        inline bool is_cancelled(const Fractal::Request& request)
+        { return request.cancelled && request.cancelled->load(std::memory_order_relaxed); }
+
+        // Принадлежность точки главной кардиоиде или кругу периода 2 (лишь для комплексных чисел).
+        // Проверка ведётся в double с запасом interior_margin, поэтому точки вблизи границ ей не подтверждаются
+        // и итерируются обычным образом.
+        const double interior_margin = 1.0e-9;
+
+        inline bool is_interior(double x, double y)
+        {
+            double shifted_x = x - 0.25;
+            double sqr_y = y * y;
+            double q = shifted_x * shifted_x + sqr_y;
+            if (q * (q + shifted_x) < 0.25 * sqr_y - interior_margin) { return true; }
+
+            double bulb_x = x + 1.0;
+            return bulb_x * bulb_x + sqr_y < 0.0625 - interior_margin;
+        }
+
+        // Поиск цикла орбиты по Бренту: значение орбиты запоминается на шагах 0, 1, 3, 7, 15, ...; если орбита
+        // вернулась к запомненному значению ближе, чем на 2^-(bits - period_guard_bits), где bits - точность
+        // арифметики ядра, точка считается принадлежащей множеству.
+        const int period_guard_bits = 8;
+
+        inline bool is_save_step(int64_t step)
+        { return ((step + 1) & step) == 0; }
+
+        // Непрерывное число итераций (normalized iteration count) точки, покинувшей круг радиуса R после step итераций
+        // со значением орбиты z: step + 1 - log2(ln|z|^2 / ln R^2). Значение лежит в [step, step + 1] и тем меньше
+        // отличается на границах полос одинакового числа итераций, чем больше R.
+        inline float smooth_iterations(int64_t step, double sqr_absolute, double log_sqr_max_absolute)
+        {
+            double value = static_cast<double>(step);
+            if (!(log_sqr_max_absolute > 0.0)) { return static_cast<float>(value); }
+
+            double fraction = 1.0 - std::log2(std::log(sqr_absolute) / log_sqr_max_absolute);
+            return static_cast<float>(value + std::min(std::max(fraction, 0.0), 1.0));
+        }
+
+        // Состояния орбит точек столбца для продолжения расчёта (см. Fractal::Orbits).
+        // Состояние точки - Kernel::state_size значений типа Kernel::Value; состав определяется ядром.
+        template <class Value>
+        struct States
+        {
+            int64_t first_step = 0;       // Число итераций, после которого получены состояния input.
+            const Value* input = nullptr; // Состояния, из которых продолжается итерирование (nullptr - итерирование с начала).
+            Value* output = nullptr;      // Состояния после итерирования (записываются лишь для точек с alive[i]; может отсутствовать).
+            uint8_t* alive = nullptr;     // Не покинула ли точка круг и не признана ли принадлежащей множеству.
+        };
+
+        // Хранилище состояний в Fractal::Orbits для типа значений ядра.
+        template <class Value>
+        std::vector<Value>& orbit_values(Fractal::Orbits& orbits);
+
+        template <>
+        inline std::vector<double>& orbit_values<double>(Fractal::Orbits& orbits)
+        { return orbits.values; }
+
+        template <>
+        inline std::vector<mpf_class>& orbit_values<mpf_class>(Fractal::Orbits& orbits)
+        { return orbits.mpf_values; }
+
+        template <class Value>
+        const std::vector<Value>& orbit_values(const Fractal::Orbits& orbits);
+
+        template <>
+        inline const std::vector<double>& orbit_values<double>(const Fractal::Orbits& orbits)
+        { return orbits.values; }
+
+        template <>
+        inline const std::vector<mpf_class>& orbit_values<mpf_class>(const Fractal::Orbits& orbits)
+        { return orbits.mpf_values; }
+
+        // Запись числа поля в состояние (double-double занимает два значения) и чтение из него.
+        inline void store_field(double value, double* output)
+        { output[0] = value; }
+        inline void store_field(const algebra::DoubleDouble& value, double* output)
+        {
+            output[0] = value.hi;
+            output[1] = value.lo;
+        }
+        inline void load_field(const double* input, double& value)
+        { value = input[0]; }
+        inline void load_field(const double* input, algebra::DoubleDouble& value)
+        { value = algebra::DoubleDouble(input[0], input[1]); }
+
+
+        ////////////////     Generic     ///////////////
+        // Ядро над произвольной алгеброй alg с полем field точности field_bits (используется для double-double).
+        template <class alg, class field>
+        class Generic
+        {
+        public:
+            // Состояние точки: компоненты текущего и запомненного значений орбиты.
+            using Value = double;
+            static constexpr size_t field_size = sizeof(field) / sizeof(double);
+            static constexpr size_t dimension = std::tuple_size<decltype(alg::components)>::value;
+            static constexpr size_t state_size = 2 * dimension * field_size;
+
+            Generic(const Fractal::Request& request, int field_bits)
+                : iterations_limit{request.iterations_limit}
+            {
+                const mpf_rectangle& rectangle = request.rectangle;
+
+                // Левый нижний угол и шаг сетки в арифметике field.
+                left   = convert<field>(rectangle.bottom_left.x);
+                bottom = convert<field>(rectangle.bottom_left.y);
+                step_x = convert<field>(mpf_class((rectangle.top_right.x - rectangle.bottom_left.x) / static_cast<unsigned long>(request.grid_x)));
+                step_y = convert<field>(mpf_class((rectangle.top_right.y - rectangle.bottom_left.y) / static_cast<unsigned long>(request.grid_y)));
+
+                field max_absolute = convert<field>(request.max_absolute);
+                sqr_max_absolute = max_absolute * max_absolute;
+                log_sqr_max_absolute = std::log(static_cast<double>(sqr_max_absolute));
+                sqr_period_tolerance = field{std::ldexp(1.0, -2 * (field_bits - period_guard_bits))};
+            }
+
+            void column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states = nullptr, float* smooth = nullptr)
+            {
+                alg constant;
+                alg var;
+                alg saved;
+                constant.components[0] = left + step_x * field{static_cast<double>(x)};
+                bool resumed = states && states->input;
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    constant.components[1] = bottom + step_y * field{static_cast<double>(ys[i])};
+                    if (!resumed && is_complex && is_interior(static_cast<double>(constant.components[0]), static_cast<double>(constant.components[1])))
+                    {
+                        iterations[i] = iterations_limit;
+                        if (smooth) { smooth[i] = static_cast<float>(iterations_limit); }
+                        if (states && states->alive) { states->alive[i] = false; }
+                        continue;
+                    }
+
+                    var = alg();
+                    saved = var;
+                    if (resumed) { _load(states->input + i * state_size, var, saved); }
+
+                    bool alive = true;
+                    int64_t step = resumed ? states->first_step : 0;
+                    for (; step < iterations_limit; ++step)
+                    {
+                        var.multiply_add(var, constant);
+
+                        field sqr_absolute = var.components[0] * var.components[0] + var.components[1] * var.components[1];
+                        if (sqr_absolute > sqr_max_absolute)
+                        {
+                            if (smooth) { smooth[i] = smooth_iterations(step, static_cast<double>(sqr_absolute), log_sqr_max_absolute); }
+                            alive = false;
+                            break;
+                        }
+
+                        field delta_x = var.components[0] - saved.components[0];
+                        field delta_y = var.components[1] - saved.components[1];
+                        if (!(delta_x * delta_x + delta_y * delta_y > sqr_period_tolerance)) { step = iterations_limit; alive = false; break; }
+                        if (is_save_step(step)) { saved = var; }
+                    }
+                    iterations[i] = step;
+                    if (smooth && step == iterations_limit) { smooth[i] = static_cast<float>(iterations_limit); }
+
+                    if (states && states->alive) { states->alive[i] = alive; }
+                    if (alive && states && states->output) { _store(var, saved, states->output + i * state_size); }
+                }
+            }
+
+        protected:
+            // Проверка принадлежности кардиоиде и кругу применима лишь к итерированию z -> z^2 + c над комплексными числами.
+            static constexpr bool is_complex = std::is_same<alg, algebra::Algebra<field, 2, algebra::complex_pt>>::value;
+
+            int64_t iterations_limit;
+            field left, bottom, step_x, step_y;
+            field sqr_max_absolute;
+            double log_sqr_max_absolute; // Для непрерывного числа итераций.
+            field sqr_period_tolerance;
+
+            static void _load(const Value* state, alg& var, alg& saved)
+            {
+                for (size_t index = 0; index < dimension; ++index)
+                {
+                    load_field(state + index * field_size, var.components[index]);
+                    load_field(state + (dimension + index) * field_size, saved.components[index]);
+                }
+            }
+            static void _store(const alg& var, const alg& saved, Value* state)
+            {
+                for (size_t index = 0; index < dimension; ++index)
+                {
+                    store_field(var.components[index], state + index * field_size);
+                    store_field(saved.components[index], state + (dimension + index) * field_size);
+                }
+            }
+        };
+
+
+        ////////////////   Vectorized    ///////////////
+        // Ядро в арифметике double с одновременным итерированием нескольких точек (см. Vectorized.hpp).
+        class Vectorized
+        {
+        public:
+            // Состояние точки: текущее и запомненное значения орбиты (x, y, saved_x, saved_y).
+            using Value = double;
+            static constexpr size_t state_size = 4;
+
+            explicit Vectorized(const Fractal::Request& request);
+
+            void column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states = nullptr, float* smooth = nullptr);
+
+        protected:
+            int64_t iterations_limit;
+            double left, bottom, step_x, step_y;
+            double sqr_max_absolute;
+            double log_sqr_max_absolute; // Для непрерывного числа итераций.
+            double sqr_period_tolerance;
+            std::vector<double> constant_x; // Параметры точек столбца, не отсеянных проверкой is_interior().
+            std::vector<double> constant_y;
+            std::vector<size_t> indices;    // Номера этих точек в столбце.
+            std::vector<int64_t> values;    // Результаты для этих точек.
+            std::vector<double> escape;     // Квадраты модулей их орбит при выходе из круга.
+            std::vector<double> var_x, var_y, saved_x, saved_y; // Состояния орбит этих точек (при продолжении расчёта).
+            std::vector<uint8_t> alive;
+        };
+
+
+        ////////////////  Perturbation   ///////////////
+        // Ядро метода возмущений: точки итерируют в double своё отклонение от опорной орбиты запроса.
+        class Perturbation
+        {
+        public:
+            // Состояние точки: отклонение орбиты, индекс опорной орбиты и те же запомненные значения
+            // (delta_x, delta_y, index, saved_delta_x, saved_delta_y, saved_index).
+            using Value = double;
+            static constexpr size_t state_size = 6;
+
+            explicit Perturbation(const Fractal::Request& request);
+
+            void column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states = nullptr, float* smooth = nullptr);
+
+        protected:
+            int64_t iterations_limit;
+            const std::vector<double>& orbit_x; // Опорная орбита.
+            const std::vector<double>& orbit_y;
+            size_t last;                        // Индекс последнего значения опорной орбиты.
+            double offset_x, offset_y;          // Отклонение левого нижнего угла от опорной точки.
+            double center_x, center_y;          // Опорная точка (для проверки is_interior()).
+            double step_x, step_y;
+            double sqr_max_absolute;
+            double log_sqr_max_absolute;      // Для непрерывного числа итераций.
+            double period_tolerance;          // Порог поиска цикла по каждой компоненте разности орбит.
+            double period_relative_tolerance; // Он же в долях модуля слагаемых разности (разрешение double).
+        };
+
+
+        ////////////////       Mpf       ///////////////
+        // Ядро длинной арифметики на рабочих регистрах потока (без выделения памяти во внутреннем цикле).
+        class Mpf
+        {
+        public:
+            // Состояние точки: текущее и запомненное значения орбиты (x, y, saved_x, saved_y).
+            using Value = mpf_class;
+            static constexpr size_t state_size = 4;
+
+            explicit Mpf(const Fractal::Request& request, mp_bitcnt_t precision);
+
+            void column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states = nullptr, float* smooth = nullptr);
+
+        protected:
+            int64_t iterations_limit;
+            mp_bitcnt_t precision;
+            double sqr_max_absolute;
+            double log_sqr_max_absolute; // Для непрерывного числа итераций.
+            int64_t period_exponent; // Порог поиска цикла: разность орбит меньше 2^period_exponent.
+
+            bool _is_small(mpf_srcptr value) const; // Меньше ли |value| порога поиска цикла.
+        };
+
+
+        ////////////////   Subdivision   ///////////////
+        // Обход сетки методом Мариани-Силвера: сначала вычисляется граница прямоугольника; если число итераций
+        // на всей границе одинаково, внутренность заполняется этим значением без вычислений, иначе прямоугольник
+        // делится на четыре части. Смежные части разделяют общую сторону, и вычисленные точки не пересчитываются.
+        // Прямоугольники со стороной не более subdivision_min_size точек обсчитываются полностью (граница небольшого
+        // прямоугольника - столбцы из нескольких точек, на которых векторное ядро работает неэффективно).
+        // Заполнение опирается на связность множества Мандельброта и его дополнения: область, ограниченная точками
+        // одного уровня, не содержит точек иного уровня. На сетке это верно лишь с точностью до дискретизации:
+        // нити дополнения тоньше шага сетки проходят между точками границы внутрь областей, где точки достигают
+        // предела итераций, не будучи внутренними. Поэтому предел итераций заполняется, лишь если все точки
+        // границы признаны принадлежащими множеству (проверкой is_interior() или поиском цикла).
+        // Непрерывное число итераций (request.smooth) заполняется лишь внутри множества (где оно равно пределу);
+        // однородные прямоугольники вне множества при request.smooth вычисляются полностью.
+        const size_t subdivision_min_size = 16;
+
+        template <class Kernel>
+        class Subdivision
+        {
+        public:
+            Subdivision(Kernel& init_kernel, const Fractal::Request& init_request, Fractal::Data& init_result)
+                : kernel(init_kernel), request(init_request), result(init_result),
+                  known(init_request.grid_x * init_request.grid_y, false), unresolved(init_request.grid_x * init_request.grid_y, false)
+            {
+                ys.reserve(request.grid_y);
+                values.reserve(request.grid_y);
+                alive.reserve(request.grid_y);
+                smooth_values.reserve(request.grid_y);
+            }
+
+            // Обсчёт прямоугольника [x_begin, x_end) x [y_begin, y_end).
+            void solve(size_t x_begin, size_t y_begin, size_t x_end, size_t y_end)
+            {
+                if (x_begin >= x_end || y_begin >= y_end) { return; }
+                _solve(x_begin, y_begin, x_end - 1, y_end - 1);
+            }
+
+        protected:
+            Kernel& kernel;
+            const Fractal::Request& request;
+            Fractal::Data& result;
+            std::vector<bool> known;      // Вычислены ли точки сетки.
+            std::vector<bool> unresolved; // Достигли ли точки сетки предела итераций, не будучи признанными принадлежащими множеству.
+            std::vector<size_t> ys;       // Точки текущего столбца.
+            std::vector<int64_t> values;  // Результаты для точек текущего столбца.
+            std::vector<uint8_t> alive;   // Не покинули ли они круг и не признаны ли принадлежащими множеству.
+            std::vector<float> smooth_values; // Непрерывное число итераций для них (при request.smooth).
+
+            // Обсчёт прямоугольника [x_first, x_last] x [y_first, y_last] (граничные точки включены).
+            void _solve(size_t x_first, size_t y_first, size_t x_last, size_t y_last)
+            {
+                // Небольшие прямоугольники обсчитываются полностью.
+                if (x_last - x_first < subdivision_min_size || y_last - y_first < subdivision_min_size)
+                {
+                    for (size_t x = x_first; x <= x_last; ++x)
+                    { _compute(x, y_first, y_last + 1, 1); }
+                    return;
+                }
+
+                // Граница: левый и правый столбцы целиком, верхняя и нижняя строки.
+                _compute(x_first, y_first, y_last + 1, 1);
+                _compute(x_last,  y_first, y_last + 1, 1);
+                for (size_t x = x_first + 1; x < x_last; ++x)
+                { _compute(x, y_first, y_last + 1, y_last - y_first); }
+                if (is_cancelled(request)) { return; }
+
+                if (_is_uniform(x_first, y_first, x_last, y_last))
+                {
+                    int64_t value = result.iterations.get(x_first * request.grid_y + y_first);
+                    bool fill = result.smooth.empty() || value == request.iterations_limit;
+                    for (size_t x = x_first + 1; x < x_last; ++x)
+                    {
+                        if (!fill)
+                        {
+                            _compute(x, y_first + 1, y_last, 1);
+                            continue;
+                        }
+                        for (size_t y = y_first + 1; y < y_last; ++y)
+                        {
+                            size_t index = x * request.grid_y + y;
+                            result.iterations.set(index, value);
+                            if (!result.smooth.empty()) { result.smooth[index] = static_cast<float>(value); }
+                            known[index] = true;
+                        }
+                    }
+                    return;
+                }
+
+                // Деление на четыре части с общими средними линиями.
+                size_t x_middle = x_first + (x_last - x_first) / 2;
+                size_t y_middle = y_first + (y_last - y_first) / 2;
+                _solve(x_first,  y_first,  x_middle, y_middle);
+                _solve(x_middle, y_first,  x_last,   y_middle);
+                _solve(x_first,  y_middle, x_middle, y_last);
+                _solve(x_middle, y_middle, x_last,   y_last);
+            }
+
+            // Вычисление ещё не известных точек столбца x с координатами y_begin + k * y_step < y_end.
+            void _compute(size_t x, size_t y_begin, size_t y_end, size_t y_step)
+            {
+                if (is_cancelled(request)) { return; }
+
+                ys.clear();
+                for (size_t y = y_begin; y < y_end; y += y_step)
+                {
+                    if (!known[x * request.grid_y + y]) { ys.push_back(y); }
+                }
+                if (ys.empty()) { return; }
+                values.resize(ys.size());
+                alive.resize(ys.size());
+                bool smooth = !result.smooth.empty();
+                if (smooth) { smooth_values.resize(ys.size()); }
+
+                States<typename Kernel::Value> states;
+                states.alive = alive.data();
+                kernel.column(x, ys.data(), ys.size(), values.data(), &states, smooth ? smooth_values.data() : nullptr);
+                for (size_t i = 0; i < ys.size(); ++i)
+                {
+                    size_t index = x * request.grid_y + ys[i];
+                    result.iterations.set(index, values[i]);
+                    if (smooth) { result.smooth[index] = smooth_values[i]; }
+                    known[index] = true;
+                    unresolved[index] = alive[i] != 0;
+                }
+            }
+
+            // Одинаково ли число итераций на границе прямоугольника (предел итераций - при условии, что все точки
+            // границы признаны принадлежащими множеству).
+            bool _is_uniform(size_t x_first, size_t y_first, size_t x_last, size_t y_last) const
+            {
+                const IterationTable& iterations = result.iterations;
+                const size_t grid_y = request.grid_y;
+                int64_t value = iterations.get(x_first * grid_y + y_first);
+                auto differs = [&](size_t index) { return iterations.get(index) != value || unresolved[index]; };
+
+                for (size_t y = y_first; y <= y_last; ++y)
+                {
+                    if (differs(x_first * grid_y + y) || differs(x_last * grid_y + y)) { return false; }
+                }
+                for (size_t x = x_first + 1; x < x_last; ++x)
+                {
+                    if (differs(x * grid_y + y_first) || differs(x * grid_y + y_last)) { return false; }
+                }
+                return true;
+            }
+        };
+
+
+        ////////////////       run       ///////////////
+        // Обход сетки запроса ядром kernel.
+        // Если задан request.subdivide, сетка обсчитывается методом Мариани-Силвера (см. Subdivision) за один проход.
+        // Иначе, если запрос прогрессивный (задан request.progress), сетка обсчитывается в несколько проходов: сначала
+        // каждая progressive_stride-я точка по обеим осям, затем шаг уменьшается вдвое, и в каждом проходе
+        // вычисляются лишь точки, не покрытые предыдущими. Результат каждого прохода публикуется.
+        // Если задан resume (проверенный вызывающим результат того же ядра с сохранёнными орбитами), итерируются лишь
+        // точки с сохранённым состоянием, за один проход. Если задан orbits, в него записываются состояния точек,
+        // не покинувших круг (кроме режима subdivide). Непрерывное число итераций заполняется, если выделен result.smooth.
+        const size_t progressive_stride = 8;
+
+        template <class Kernel>
+        void run(Kernel& kernel, const Fractal::Request& request, Fractal::Data& result,
+                 const Fractal::Data* resume = nullptr, Fractal::Orbits* orbits = nullptr)
+        {
+            if (request.subdivide && !resume)
+            {
+                Subdivision<Kernel> subdivision(kernel, request, result);
+                subdivision.solve(0, 0, request.grid_x, request.grid_y);
+                result.stride = 1;
+                return;
+            }
+
+            using Value = typename Kernel::Value;
+            const size_t state_size = Kernel::state_size;
+
+            std::vector<size_t> ys;         // Точки текущего столбца.
+            std::vector<int64_t> values;    // Результаты для точек текущего столбца.
+            std::vector<float> smooth;      // Непрерывное число итераций для них.
+            const bool is_smooth = !result.smooth.empty();
+            ys.reserve(request.grid_y);
+            values.reserve(request.grid_y);
+            if (is_smooth) { smooth.reserve(request.grid_y); }
+
+            // Состояния орбит точек текущего столбца.
+            States<Value> states;
+            std::vector<Value> input;
+            std::vector<Value> output;
+            std::vector<uint8_t> alive;
+            if (orbits)
+            {
+                orbits->state_size = state_size;
+                orbits->slots.assign(request.grid_x * request.grid_y, Fractal::Orbits::none);
+            }
+
+            // Обсчёт точек ys столбца x и перенос состояний оставшихся в круге точек в orbits.
+            auto compute = [&](size_t x)
+            {
+                values.resize(ys.size());
+                if (is_smooth) { smooth.resize(ys.size()); }
+                if (orbits)
+                {
+                    output.resize(ys.size() * state_size);
+                    alive.resize(ys.size());
+                    states.output = output.data();
+                    states.alive = alive.data();
+                }
+                kernel.column(x, ys.data(), ys.size(), values.data(), orbits || states.input ? &states : nullptr, is_smooth ? smooth.data() : nullptr);
+
+                for (size_t i = 0; i < ys.size(); ++i)
+                { result.iterations.set(x * request.grid_y + ys[i], values[i]); }
+                if (is_smooth)
+                {
+                    for (size_t i = 0; i < ys.size(); ++i)
+                    { result.smooth[x * request.grid_y + ys[i]] = smooth[i]; }
+                }
+                if (!orbits) { return; }
+
+                std::vector<Value>& kept = orbit_values<Value>(*orbits);
+                for (size_t i = 0; i < ys.size(); ++i)
+                {
+                    if (!alive[i]) { continue; }
+                    orbits->slots[x * request.grid_y + ys[i]] = static_cast<uint32_t>(kept.size() / state_size);
+                    kept.insert(kept.end(), output.begin() + i * state_size, output.begin() + (i + 1) * state_size);
+                }
+            };
+
+            if (resume)
+            {
+                // Покинувшие круг точки сохраняют число итераций, признанные принадлежащими множеству получают новый предел.
+                const Fractal::Orbits& previous = *resume->orbits;
+                const std::vector<Value>& previous_values = orbit_values<Value>(previous);
+                std::vector<int64_t> previous_iterations(request.grid_y); // Прежние результаты столбца (таблица может быть сжата).
+                states.first_step = resume->iterations_limit;
+                for (size_t x = 0; x < request.grid_x; ++x)
+                {
+                    if (is_cancelled(request)) { return; }
+
+                    ys.clear();
+                    input.clear();
+                    resume->iterations.read(x * request.grid_y, request.grid_y, previous_iterations.data());
+                    for (size_t y = 0; y < request.grid_y; ++y)
+                    {
+                        size_t index = x * request.grid_y + y;
+                        uint32_t slot = previous.slots[index];
+                        if (slot == Fractal::Orbits::none)
+                        {
+                            int64_t value = previous_iterations[y];
+                            bool escaped = value < resume->iterations_limit;
+                            result.iterations.set(index, escaped ? value : request.iterations_limit);
+                            if (is_smooth) { result.smooth[index] = escaped ? resume->smooth[index] : static_cast<float>(request.iterations_limit); }
+                            continue;
+                        }
+                        ys.push_back(y);
+                        input.insert(input.end(), previous_values.begin() + slot * state_size, previous_values.begin() + (slot + 1) * state_size);
+                    }
+                    if (ys.empty()) { continue; }
+
+                    states.input = input.data();
+                    compute(x);
+                }
+                result.stride = 1;
+                return;
+            }
+
+            size_t stride = request.progress ? progressive_stride : 1;
+            bool refine = false; // Обсчитаны ли уже точки с шагом 2 * stride.
+            while (true)
+            {
+                for (size_t x = 0; x < request.grid_x; x += stride)
+                {
+                    // Запрос прерывается между столбцами сетки.
+                    if (is_cancelled(request)) { return; }
+
+                    // В столбцах, пройденных предыдущим проходом, пропускаются уже вычисленные точки.
+                    size_t y_begin = 0;
+                    size_t y_step  = stride;
+                    if (refine && x % (2 * stride) == 0)
+                    {
+                        y_begin = stride;
+                        y_step  = 2 * stride;
+                    }
+
+                    ys.clear();
+                    for (size_t y = y_begin; y < request.grid_y; y += y_step)
+                    { ys.push_back(y); }
+                    compute(x);
+                }
+
+                result.stride = stride;
+                if (stride == 1) { break; }
+
+                request.progress->publish(result);
+                stride /= 2;
+                refine = true;
+            }
+        }
+    }
+}
+
+#endif
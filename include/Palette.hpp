@@ -0,0 +1,59 @@
+#ifndef ALFRACTAL_PALETTE
+#define ALFRACTAL_PALETTE
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    ////////////////     Palette     ///////////////
+    // Раскраска результатов обсчёта.
+    // Палитра - градиент по равномерно расставленным опорным цветам, повторяющийся каждые period итераций. При создании
+    // он табулируется в lut_size цветов, и цвет точки - элемент таблицы с номером, пропорциональным дробной части
+    // (непрерывного, если есть Data::smooth) числа итераций, делённого на period: вычислений над каналами нет.
+    // Палитра не участвует в обсчёте, поэтому её смена требует лишь повторной раскраски готовых данных.
+    class Palette
+    {
+    public:
+        static constexpr size_t lut_size = 4096; // Число цветов в таблице (степень двойки).
+
+        // Цвет RGBA.
+        struct Colour
+        {
+            uint8_t r, g, b, a;
+        };
+
+        Palette(); // Линейный градиент от чёрного к синему за iterations_limit итераций (внутренние точки - чёрные).
+        // Палитра из опорных цветов stops (не менее одного); period - число итераций на повтор градиента (0 - iterations_limit данных).
+        explicit Palette(const std::string& init_name, const std::vector<Colour>& stops, double init_period = 0.0, Colour init_inside = Colour{ 0, 0, 0, 255 });
+
+        // Раскраска результата: 4 байта RGBA на точку в порядке Data::iterations. Незаполненные точки промежуточного
+        // результата (stride > 1) получают цвет ближайшей вычисленной.
+        void colour(const Fractal::Data& data, uint8_t* rgba) const;
+        // Раскраска count точек таблицы, начиная с first (smooth - значения этих точек, может отсутствовать).
+        void colour(const IterationTable& iterations, const float* smooth, size_t first, size_t count, int64_t iterations_limit, uint8_t* rgba) const;
+
+        const std::string& get_name() const;
+        uint64_t get_id() const; // Номер палитры: совпадает лишь у копий одной палитры.
+
+        static const std::vector<Palette>& presets(); // Встроенные палитры (первая совпадает с Palette()).
+        static const Palette* find(const std::string& name); // Встроенная палитра по названию (nullptr, если её нет).
+
+    protected:
+        std::string name;
+        double period;               // Итераций на повтор градиента (0 - iterations_limit данных).
+        uint32_t inside;             // Цвет точек, не покинувших круг (RGBA в порядке байт памяти).
+        std::vector<uint32_t> lut;   // Таблица цветов градиента (lut_size элементов, RGBA в порядке байт памяти).
+        uint64_t id;
+
+        static uint32_t _pack(Colour colour); // Упаковка цвета в порядке байт памяти.
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef ALFRACTAL_PERTURBATION
+#define ALFRACTAL_PERTURBATION
+
+#include <cinttypes>
+#include <vector>
+#include <mutex>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    ////////////////  ReferenceOrbit  ///////////////
+    // Опорная орбита для расчёта методом возмущений.
+    // Орбита одной точки (центра вида) считается в длинной арифметике один раз и разделяется между всеми тайлами вида,
+    // после чего каждая точка сетки итерирует лишь своё малое отклонение от опорной орбиты в арифметике double.
+    class ReferenceOrbit
+    {
+    public:
+        explicit ReferenceOrbit(const mpf_vector_2d& init_center, mp_bitcnt_t init_precision, int64_t init_iterations_limit, const mpf_class& init_max_absolute);
+        ReferenceOrbit(const ReferenceOrbit& reference) = delete; // Запрет конструктора-копирования.
+        ~ReferenceOrbit();
+
+        const mpf_vector_2d& get_center() const; // Опорная точка.
+        mp_bitcnt_t get_precision() const;       // Точность, с которой считается орбита.
+        int64_t get_iterations_limit() const;    // Максимальная длина орбиты.
+        const mpf_class& get_max_absolute() const; // Радиус круга, покидание которого обрывает орбиту.
+
+        // Значения орбиты Z_0 = 0, Z_1, ..., Z_{length - 1}, приведённые к double.
+        // Орбита обрывается на первом значении, покинувшем круг радиуса max_absolute.
+        // Вычисляется при первом обращении (потокобезопасно).
+        const std::vector<double>& get_orbit_x();
+        const std::vector<double>& get_orbit_y();
+        size_t length();
+
+        ReferenceOrbit& operator=(const ReferenceOrbit& right) = delete; // Запрет присвоения-копирования.
+
+    protected:
+        mpf_vector_2d center;     // Опорная точка.
+        mp_bitcnt_t precision;    // Точность арифметики.
+        int64_t iterations_limit; // Максимальная длина орбиты.
+        mpf_class max_absolute;   // Максимальное значение модуля числа.
+
+        std::vector<double> orbit_x; // Действительные части значений орбиты.
+        std::vector<double> orbit_y; // Мнимые части значений орбиты.
+        std::once_flag once_calculated; // Флаг однократного вычисления орбиты.
+
+        void _calculate(); // Вычисление орбиты.
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef ALFRACTAL_RENDERER
+#define ALFRACTAL_RENDERER
+
+#include <cinttypes>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+#include "Palette.hpp"
+
+namespace alfrac
+{
+    ////////////////    Renderer     ///////////////
+    // Обсчёт изображения произвольного размера без графического интерфейса.
+    // Изображение делится на полосы высотой tile_size строк, полоса - на тайлы tile_size x tile_size, каждый из которых
+    // обсчитывается отдельным запросом к Fractal. Пока собирается одна полоса, вычислители уже считают следующую,
+    // поэтому в памяти находятся не более двух полос.
+    class Renderer
+    {
+    public:
+        // Параметры изображения.
+        struct View
+        {
+            mpf_vector_2d center;      // Центр изображения.
+            mpf_class width;           // Ширина изображения в координатах фрактала (высота - по соотношению сторон).
+            size_t image_width  = 0;   // Размеры изображения в пикселях.
+            size_t image_height = 0;
+            int64_t iterations_limit = 64;
+            mpf_class max_absolute = 4.0;
+            mp_bitcnt_t precision = 0; // Точность координат (0 - по глубине приближения, см. coordinate_precision()).
+            size_t tile_size = 256;    // Сторона тайла в пикселях.
+            bool smooth = false;       // Раскрашивать ли по непрерывному числу итераций.
+            Palette palette;           // Палитра.
+
+            std::shared_ptr<ReferenceOrbit> reference; // Опорная орбита (если не задана, строится по центру).
+        };
+
+        // Получатель строк изображения (RGB, сверху вниз); false прерывает обсчёт.
+        using RowCallback = std::function<bool(const uint8_t* rgb, size_t row)>;
+
+        explicit Renderer(std::shared_ptr<Fractal> init_fractal);
+
+        bool render(const View& view, const RowCallback& callback); // Обсчёт изображения; false, если прерван.
+
+        static mp_bitcnt_t coordinate_precision(const View& view); // Точность координат, достаточная для вида.
+
+    protected:
+        std::shared_ptr<Fractal> fractal; // Вычислитель.
+
+        // Полоса изображения в процессе обсчёта.
+        struct Band
+        {
+            size_t first_row;
+            size_t rows;
+            std::vector<std::future<Fractal::Data>> tiles;
+        };
+
+        Band _request_band(const View& view, const mpf_rectangle& frame, const mpf_class& step, size_t first_row); // Запрос тайлов полосы.
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef ALFRACTAL_SCHEDULER
+#define ALFRACTAL_SCHEDULER
+
+#include <cinttypes>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+namespace alfrac
+{
+    ////////////////    Scheduler    ///////////////
+    // Пул потоков-вычислителей с перехватом работы (work stealing).
+    // У каждого потока своя очередь задач с приоритетами; опустошив её, поток забирает задачи из чужих очередей.
+    // Задачи, отменённые до начала выполнения, из очередей удаляются и не выполняются.
+    // Приоритет задачи, добавленной с PriorityToken, может меняться до начала её выполнения (см. reprioritise()).
+    class Scheduler
+    {
+    public:
+        using Task = std::function<void()>;
+        using CancelToken = std::shared_ptr<std::atomic<bool>>;     // Признак отмены задачи.
+        using PriorityToken = std::shared_ptr<std::atomic<double>>; // Изменяемый приоритет задачи.
+
+        // Время работы и простоя потока-вычислителя с момента запуска.
+        struct Utilization
+        {
+            uint64_t busy_ns; // Выполнение задач.
+            uint64_t idle_ns; // Поиск задач и ожидание (учитывается при начале следующей задачи).
+        };
+
+        explicit Scheduler(size_t init_workers_number = 0); // 0 - по числу аппаратных потоков.
+        Scheduler(const Scheduler& scheduler) = delete; // Запрет конструктора-копирования.
+        ~Scheduler();
+
+        // Добавление задачи в очередь. Задачи с меньшим значением priority выполняются раньше,
+        // при равных приоритетах - в порядке поступления. Если задан priority_token, приоритет берётся из него.
+        void submit(Task task, double priority = 0.0, CancelToken cancelled = nullptr, PriorityToken priority_token = nullptr);
+        void purge();        // Удаление отменённых задач из всех очередей.
+        void reprioritise(); // Перечитывание изменяемых приоритетов задач в очередях.
+        void terminate();    // Завершение работы потоков (задачи, оставшиеся в очередях, отбрасываются).
+
+        size_t get_workers_number() const; // Число потоков-вычислителей.
+        int64_t get_queue_length() const; // Число задач в очередях.
+        std::vector<Utilization> get_utilization() const; // Время работы и простоя каждого потока.
+
+        Scheduler& operator=(const Scheduler& right) = delete; // Запрет присвоения-копирования.
+
+    protected:
+        // Задача в очереди.
+        struct Entry
+        {
+            double priority;       // Приоритет (меньшее значение - раньше).
+            uint64_t sequence;     // Порядковый номер поступления.
+            Task task;             // Задача.
+            CancelToken cancelled; // Признак отмены (может отсутствовать).
+            PriorityToken priority_token; // Изменяемый приоритет (может отсутствовать).
+
+            bool is_cancelled() const;
+        };
+        // Порядок в куче: на вершине задача с наименьшим приоритетом, при равенстве - поступившая раньше.
+        struct EntryCompare
+        {
+            bool operator()(const Entry& left, const Entry& right) const;
+        };
+
+        // Очередь задач одного потока (двоичная куча).
+        struct Worker
+        {
+            std::vector<Entry> tasks; // Очередь задач.
+            std::mutex mutex_tasks;   // mutex для контроля доступа к tasks.
+            std::atomic<uint64_t> busy_ns{0}; // Время выполнения задач.
+            std::atomic<uint64_t> idle_ns{0}; // Время простоя.
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers; // Очереди потоков.
+        std::vector<std::thread> threads;             // Потоки-вычислители.
+        std::atomic<size_t> next_worker{0};           // Очередь, в которую будет помещена следующая задача.
+        std::atomic<uint64_t> next_sequence{0};       // Порядковый номер следующей задачи.
+
+        // Механизмы синхронизации.
+        // Счётчик pending увеличивается под mutex_sleep, поэтому оповещение не может быть потеряно между
+        // проверкой условия ожидания и засыпанием потока.
+        std::atomic<int64_t> pending{0};   // Число задач в очередях (кратковременно может быть отрицательным).
+        std::atomic<bool> in_loop{true};   // Переменная для контроля циклов потоков.
+        std::mutex mutex_sleep;            // mutex для реализации функции ожидания.
+        std::condition_variable condition_tasks; // Условная переменная для реализации функции ожидания.
+
+        void loop(size_t index);                      // Цикл потока-вычислителя.
+        bool _pop(size_t index, Scheduler::Task& task); // Извлечение задачи из своей очереди или перехват из чужой.
+        bool _pop_from(Worker& worker, Scheduler::Task& task); // Извлечение первой неотменённой задачи из очереди.
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef ALFRACTAL_SEQUENCE
+#define ALFRACTAL_SEQUENCE
+
+#include <cinttypes>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+#include "Renderer.hpp"
+
+namespace alfrac
+{
+    ////////////////    Sequence     ///////////////
+    // Обсчёт последовательности кадров приближения к точке (для видео).
+    // Обсчитываются лишь ключевые кадры, отстоящие друг от друга в keyframe_zoom раз; ключевой кадр строится
+    // в keyframe_zoom раз крупнее кадра, так что все промежуточные кадры получаются из него пересэмплированием без
+    // потери разрешения. Все ключевые кадры используют одну опорную орбиту. Пока кадры одного ключевого кадра
+    // пересэмплируются и передаются на запись (в отдельном потоке), вычислители уже считают следующий ключевой кадр.
+    class Sequence
+    {
+    public:
+        // Траектория приближения: ширина кадра меняется по геометрической прогрессии от start_width до end_width.
+        struct Path
+        {
+            mpf_vector_2d center;       // Центр всех кадров.
+            mpf_class start_width;      // Ширина первого кадра в координатах фрактала.
+            mpf_class end_width;        // Ширина последнего кадра (не больше start_width).
+            size_t frames = 2;          // Число кадров.
+            size_t image_width  = 0;    // Размеры кадра в пикселях.
+            size_t image_height = 0;
+            int64_t iterations_limit = 64;
+            mpf_class max_absolute = 4.0;
+            unsigned long keyframe_zoom = 2; // Приближение между соседними ключевыми кадрами.
+            size_t tile_size = 256;     // Сторона тайла в пикселях.
+            bool smooth = false;        // Раскрашивать ли по непрерывному числу итераций.
+            Palette palette;            // Палитра.
+            size_t queue_size = 4;      // Наибольшее число кадров, ожидающих записи.
+        };
+
+        // Получатель кадров (RGB, 3 * image_width * image_height байт, строки сверху вниз) в порядке номеров.
+        // Вызывается из потока записи; false прерывает обсчёт.
+        using FrameCallback = std::function<bool(const uint8_t* rgb, size_t frame)>;
+
+        explicit Sequence(std::shared_ptr<Fractal> init_fractal);
+
+        bool render(const Path& path, const FrameCallback& callback); // Обсчёт последовательности; false, если прерван.
+
+        static size_t keyframes_number(const Path& path); // Число ключевых кадров траектории.
+
+    protected:
+        std::shared_ptr<Fractal> fractal; // Вычислитель.
+        Renderer renderer;                // Обсчёт ключевых кадров.
+
+        // Обсчитанный ключевой кадр.
+        struct Keyframe
+        {
+            size_t width  = 0;
+            size_t height = 0;
+            std::vector<uint8_t> rgb;
+            bool complete = false;
+        };
+
+        static Renderer::View _keyframe_view(const Path& path, size_t index); // Вид ключевого кадра с номером index.
+        Keyframe _render_keyframe(const Renderer::View& view, const std::function<bool()>& is_cancelled);
+        static void _resample(const Path& path, const Keyframe& keyframe, double scale, uint8_t* frame); // Кадр с шагом сетки scale шагов ключевого кадра.
+
+    private:
+
+    };
+}
+
+#endif
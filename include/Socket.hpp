@@ -0,0 +1,26 @@
+#ifndef ALFRACTAL_SOCKET
+#define ALFRACTAL_SOCKET
+
+#include <cinttypes>
+#include <string>
+
+namespace alfrac
+{
+    ////////////////       net       ///////////////
+    // Сокеты для обмена между процессами (см. Distributed.hpp, TileServer.hpp).
+    // Адрес - "unix:ПУТЬ" (Unix-сокет) или "УЗЕЛ:ПОРТ" (TCP; при ожидании подключений узел можно опустить).
+    namespace net
+    {
+        // Открытие сокета по адресу: подключение или (listening) ожидание подключений. -1 при ошибке.
+        int open_socket(const std::string& address, bool listening);
+        // Параметры соединения TCP: без задержки мелких кадров и с проверкой живости (обнаружение пропавших машин).
+        void tune_socket(int socket);
+
+        // Запись и чтение ровно size байт (false при разрыве соединения). Запись в разорванное соединение не
+        // порождает SIGPIPE.
+        bool write_all(int socket, const void* buffer, size_t size);
+        bool read_all(int socket, void* buffer, size_t size);
+    }
+}
+
+#endif
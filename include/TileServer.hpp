@@ -0,0 +1,149 @@
+#ifndef ALFRACTAL_TILESERVER
+#define ALFRACTAL_TILESERVER
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <future>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    ////////////////   TileServer    ///////////////
+    // Сервер тайлов: один Fractal (с его очередью, хранилищем и удалёнными вычислителями) обслуживает многих клиентов
+    // (браузерные интерфейсы, другие программы).
+    // Тайлы адресуются как в веб-картах: тайл уровня level с номерами (x, y), 0 <= x, y < 2^level, покрывает
+    // квадрат со стороной 4 * 2^-level, отсчитанный от левого верхнего угла [-2, 2] x [-2, 2] (номер y растёт вниз).
+    // Для level >= 1 это тайл TileAddress(level - 2, x - 2^(level - 1), 2^(level - 1) - 1 - y) интерфейса.
+    // Результаты обсчёта хранятся в общем кэше с ограничением по памяти независимо от палитры (раскраска выполняется
+    // при ответе), а одинаковые запросы, поступившие во время обсчёта, ожидают один и тот же результат.
+    //
+    // Протокол - HTTP/1.1 (с сохранением соединения):
+    //   GET /tile/LEVEL/X/Y.png?iterations=N&smooth=1&palette=NAME&size=N - изображение тайла (.png или .ppm);
+    //   GET /stats - статистика кэша в JSON.
+    // Тайл однозначно определяется адресом и параметрами, поэтому ответ разрешено кэшировать без ограничения срока.
+    class TileServer
+    {
+    public:
+        // Настройки сервера.
+        struct Settings
+        {
+            size_t cache_budget = size_t(512) << 20; // Бюджет памяти кэша в байтах.
+            size_t max_tile_size = 1024;             // Наибольшая сторона тайла в точках.
+            int64_t max_iterations = int64_t(1) << 24; // Наибольшее предельное число итераций.
+            int64_t max_level = 900;                 // Наибольший уровень (глубже метод возмущений неприменим и тайлы считаются медленно).
+            mpf_class max_absolute = 4.0;            // Максимальное значение модуля числа.
+            int64_t reference_levels = 4;            // Тайлы глубоких уровней разделяют опорную орбиту в центре предка на столько уровней выше.
+        };
+
+        // Параметры обсчёта тайла (палитра в них не входит).
+        struct Key
+        {
+            int64_t level = 0;
+            mpz_class x;
+            mpz_class y;
+            size_t tile_size = 256;
+            int64_t iterations_limit = 256;
+            bool smooth = false;
+
+            bool operator==(const Key& right) const;
+        };
+        struct KeyHasher
+        {
+            std::size_t operator()(const Key& key) const;
+        };
+
+        // Статистика обращений.
+        struct Statistics
+        {
+            uint64_t requests  = 0; // Запросы тайлов.
+            uint64_t hits      = 0; // Тайлы, найденные в кэше.
+            uint64_t coalesced = 0; // Запросы, присоединённые к уже выполняющемуся обсчёту.
+            uint64_t computed  = 0; // Запросы, отправленные на обсчёт.
+            uint64_t evictions = 0; // Тайлы, удалённые из-за превышения бюджета.
+            size_t   tiles     = 0; // Число тайлов в кэше.
+            size_t   bytes     = 0; // Занимаемая кэшем память.
+        };
+
+        explicit TileServer(std::shared_ptr<Fractal> init_fractal);
+        TileServer(std::shared_ptr<Fractal> init_fractal, const Settings& init_settings);
+        // Запрет конструктора-копирования.
+        TileServer(const TileServer&) = delete;
+        ~TileServer();
+
+        bool serve(const std::string& address); // Приём подключений (см. WorkerServer::serve()).
+
+        // Результат обсчёта тайла (из кэша, из уже выполняющегося обсчёта или нового). Исключения обсчёта передаются
+        // вызывающему.
+        std::shared_ptr<const Fractal::Data> get_tile(const Key& key);
+        Fractal::Request make_request(const Key& key); // Запрос на обсчёт тайла.
+        bool is_valid(const Key& key) const;           // Соответствие адреса и параметров ограничениям Settings.
+
+        Statistics get_statistics() const;
+
+        // Запрет присвоения-копирования.
+        TileServer& operator=(const TileServer&) = delete;
+
+    protected:
+        // Соединение с клиентом.
+        struct Connection
+        {
+            ~Connection();
+
+            int socket = -1;
+            std::atomic<bool> closed{false}; // Поток соединения завершён (его можно присоединить).
+        };
+
+        // Ответ на запрос.
+        struct Response
+        {
+            int status = 200;
+            std::string content_type = "text/plain; charset=utf-8";
+            std::vector<uint8_t> body;
+            bool immutable = false; // Разрешено ли кэшировать без ограничения срока.
+        };
+
+        struct Entry
+        {
+            Key key;
+            std::shared_ptr<const Fractal::Data> data;
+            size_t bytes;
+        };
+
+        std::shared_ptr<Fractal> fractal;
+        Settings settings;
+
+        // Кэш в порядке использования (в начале - последний использованный) и обсчитываемые тайлы.
+        std::list<Entry> entries;
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHasher> index;
+        std::unordered_map<Key, std::shared_future<std::shared_ptr<const Fractal::Data>>, KeyHasher> in_flight;
+        Statistics statistics;
+        mutable std::mutex mutex_cache; // mutex для контроля доступа к кэшу, in_flight и statistics.
+
+        // Опорные орбиты глубоких уровней (последние использованные - в конце).
+        std::vector<std::pair<Key, std::shared_ptr<ReferenceOrbit>>> references;
+        std::mutex mutex_references;
+
+        std::vector<std::thread> threads; // Потоки соединений (параллельно connections).
+        std::vector<std::shared_ptr<Connection>> connections;
+        std::mutex mutex_connections;
+
+        void _serve_connection(std::shared_ptr<Connection> connection); // Чтение запросов соединения до его разрыва.
+        Response _respond(const std::string& target); // Ответ на запрос GET ресурса target.
+        std::shared_ptr<ReferenceOrbit> _reference(const Key& key, mp_bitcnt_t precision); // Опорная орбита для тайла.
+        void _trim(); // Вытеснение тайлов до соответствия бюджету (под mutex_cache).
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef ALFRACTAL_TILESTORE
+#define ALFRACTAL_TILESTORE
+
+#include <cinttypes>
+#include <string>
+#include <atomic>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    ////////////////    TileStore    ///////////////
+    // Хранилище обсчитанных регионов фрактала на диске.
+    // Каждый результат хранится в отдельном файле, имя которого - хэш ключа. Ключ составляется из точных значений
+    // координат прямоугольника, параметров сетки, точности, числа итераций, max_absolute и итерационной формулы
+    // (см. Fractal::formula()) и также записывается в файл, так что совпадение хэшей не приводит к ошибке.
+    // Числа итераций хранятся так же, как в несжатой IterationTable (в наименьшем целом типе, вмещающем iterations_limit);
+    // файл читается через mmap.
+    // Непрерывные числа итераций (Request::smooth, входит в ключ) записываются за ними в float.
+    // Ошибки ввода-вывода не прерывают работу: регион, не найденный или не записанный на диск, просто обсчитывается.
+    class TileStore
+    {
+    public:
+        explicit TileStore(const std::string& init_directory); // Директория создаётся при необходимости.
+        TileStore(const TileStore& tile_store) = delete; // Запрет конструктора-копирования.
+        ~TileStore();
+
+        bool load(const Fractal::Request& request, Fractal::Data& result); // Поиск результата запроса; true, если найден.
+        bool save(const Fractal::Request& request, const Fractal::Data& result); // Запись результата запроса (атомарная замена файла).
+
+        static std::string key(const Fractal::Request& request); // Ключ запроса.
+        const std::string& get_directory() const;
+
+        TileStore& operator=(const TileStore& right) = delete; // Запрет присвоения-копирования.
+
+    protected:
+        // Заголовок файла; за ним следуют ключ (key_size байт), числа итераций (value_size байт на точку, порядок байт машины)
+        // и, при Request::smooth, непрерывные числа итераций (float на точку).
+        struct Header
+        {
+            char magic[4];            // "AFTS".
+            uint32_t version;         // Версия формата.
+            uint32_t key_size;        // Длина ключа.
+            uint32_t value_size;      // Байт на одно число итераций (1, 2, 4 или 8).
+            uint64_t grid_x;
+            uint64_t grid_y;
+            int64_t iterations_limit;
+        };
+
+        std::string directory;                // Директория хранилища.
+        std::atomic<uint64_t> next_temporary{0}; // Номер следующего временного файла (для одновременной записи из разных потоков).
+
+        std::string _path(const std::string& request_key) const; // Путь к файлу по ключу.
+
+    private:
+
+    };
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef ALFRACTAL_VECTORIZED
+#define ALFRACTAL_VECTORIZED
+
+#include <cinttypes>
+#include <cstddef>
+
+namespace alfrac
+{
+    ////////////////   Vectorized    ///////////////
+    // Векторизованное ядро итерационного процесса z -> z^2 + c для комплексных чисел двойной точности.
+    // Несколько точек итерируются одновременно (по точке на элемент векторного регистра), ушедшие за пределы
+    // круга точки маскируются. Набор команд выбирается во время выполнения.
+    namespace vectorized
+    {
+        // Набор векторных команд.
+        enum class InstructionSet
+        {
+            Scalar, // Без векторизации (1 точка).
+            SSE2,   // 2 точки.
+            AVX2,   // 4 точки.
+            AVX512  // 8 точек.
+        };
+
+        InstructionSet detect();                   // Наилучший набор команд, поддерживаемый процессором.
+        const char* name(InstructionSet isa);      // Название набора команд.
+        size_t width(InstructionSet isa);          // Число точек, итерируемых одновременно.
+
+        // Состояние орбит count точек для продолжения итерирования (массивы по count элементов).
+        struct State
+        {
+            double* var_x;   // Вход: значение орбиты после first_step итераций; выход: после итерирования.
+            double* var_y;
+            double* saved_x; // Запомненное для поиска цикла значение орбиты (вход и выход).
+            double* saved_y;
+            uint8_t* alive;  // Выход: 1, если точка не покинула круг и не признана периодической.
+        };
+
+        // Вычисление числа итераций для count точек с параметрами (constant_x[i], constant_y[i]).
+        // Точка, орбита которой вернулась к запомненному значению ближе, чем на sqrt(sqr_period_tolerance),
+        // считается принадлежащей множеству (получает iterations_limit итераций).
+        // Результат совпадает с последовательным вычислением в double с точностью до бита.
+        void escape_time(const double* constant_x, const double* constant_y, size_t count,
+                         int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, int64_t* iterations);
+        void escape_time(InstructionSet isa, const double* constant_x, const double* constant_y, size_t count,
+                         int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, int64_t* iterations);
+
+        // То же с продолжением орбит: итерирование начинается с шага first_step из состояния state (если state задан)
+        // и заканчивается записью состояния в state. Продолжение орбит, сохранённых после L итераций, даёт тот же
+        // результат, что и итерирование с начала.
+        // Если задан escape, в него записывается квадрат модуля первого значения орбиты вне круга (для непрерывного
+        // числа итераций; у не покинувших круг точек значение не определено).
+        void escape_time(InstructionSet isa, const double* constant_x, const double* constant_y, size_t count, int64_t first_step,
+                         int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, State* state, int64_t* iterations,
+                         double* escape = nullptr);
+    }
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef ALFRACTAL_WIRE
+#define ALFRACTAL_WIRE
+
+#include <cinttypes>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <gmpxx.h>
+#include "Fractal.hpp"
+
+namespace alfrac
+{
+    ////////////////      wire       ///////////////
+    // Двоичное представление запросов и результатов для передачи между процессами (см. Distributed.hpp).
+    // Целые записываются в порядке little-endian независимо от машины, double и float - своими битами, числа длинной
+    // арифметики - точно (знак, двоичный порядок и байты мантиссы, см. Writer::put_mpf()), поэтому обсчёт
+    // на другой машине совпадает с местным. Читатель проверяет границы буфера: повреждённые данные дают ошибку,
+    // а не аварийное завершение.
+    namespace wire
+    {
+        // Запись в буфер.
+        class Writer
+        {
+        public:
+            void put_u8(uint8_t value);
+            void put_u32(uint32_t value);
+            void put_u64(uint64_t value);
+            void put_i64(int64_t value);
+            void put_f32(float value);
+            void put_f64(double value);
+            void put_bytes(const void* data, size_t size);
+            void put_string(const std::string& value);
+            void put_mpf(const mpf_class& value); // Точность, знак, двоичный порядок и мантисса (без потерь).
+
+            const std::vector<uint8_t>& get_bytes() const;
+            std::vector<uint8_t>& get_bytes();
+
+        protected:
+            std::vector<uint8_t> bytes;
+
+        private:
+
+        };
+
+        // Чтение из буфера. После первой ошибки (выход за границы, недопустимое значение) все чтения возвращают нули.
+        class Reader
+        {
+        public:
+            explicit Reader(const uint8_t* init_position, size_t size);
+
+            uint8_t  get_u8();
+            uint32_t get_u32();
+            uint64_t get_u64();
+            int64_t  get_i64();
+            float    get_f32();
+            double   get_f64();
+            bool get_bytes(void* data, size_t size);
+            std::string get_string();
+            mpf_class get_mpf();
+            size_t get_count(size_t element_size); // Число элементов массива (не больше, чем помещается в оставшиеся байты).
+
+            void fail();       // Пометка данных как повреждённых.
+            bool failed() const;
+            size_t remaining() const;
+
+        protected:
+            const uint8_t* position;
+            const uint8_t* end;
+            bool is_failed = false;
+
+            const uint8_t* _take(size_t size); // Следующие size байт (nullptr при выходе за границы).
+
+        private:
+
+        };
+
+        // Запрос: прямоугольник, сетка, точность, параметры обсчёта, опорная орбита (параметрами, а не значениями:
+        // получатель строит её сам) и продолжаемый результат. Приёмник промежуточных результатов, признак отмены
+        // и уведомление не передаются.
+        // make_reference позволяет получателю разделять опорные орбиты между запросами (по умолчанию строится новая).
+        using ReferenceFactory = std::function<std::shared_ptr<ReferenceOrbit>(const mpf_vector_2d& center, mp_bitcnt_t precision,
+                                                                               int64_t iterations_limit, const mpf_class& max_absolute)>;
+        void write_request(Writer& writer, const Fractal::Request& request);
+        bool read_request(Reader& reader, Fractal::Request& request, const ReferenceFactory& make_reference = nullptr);
+
+        // Результат: таблица итераций (сжатая, если это выгодно), непрерывные числа итераций и состояние орбит.
+        void write_data(Writer& writer, const Fractal::Data& data);
+        bool read_data(Reader& reader, Fractal::Data& data);
+    }
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "Arguments.hpp"
+#include <cerrno>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+namespace alfrac
+{
+    namespace arguments
+    {
+        namespace
+        {
+            // Число начинается сразу с цифры (или со знака минус, если он допустим): strtoull() и strtod() иначе
+            // пропускают пробелы и принимают знак минус у чисел без знака.
+            bool starts_with_number(const char* text, bool allow_minus)
+            {
+                if (!text) { return false; }
+                if (allow_minus && *text == '-') { ++text; }
+                return std::isdigit(static_cast<unsigned char>(*text)) != 0 || *text == '.';
+            }
+        }
+
+        bool parse_unsigned(const char* text, uint64_t& value, uint64_t min, uint64_t max)
+        {
+            if (!starts_with_number(text, false)) { return false; }
+
+            char* end = nullptr;
+            errno = 0;
+            unsigned long long parsed = std::strtoull(text, &end, 10);
+            if (errno != 0 || *end != '\0' || end == text || parsed < min || parsed > max) { return false; }
+            value = static_cast<uint64_t>(parsed);
+            return true;
+        }
+
+        bool parse_signed(const char* text, int64_t& value, int64_t min, int64_t max)
+        {
+            if (!starts_with_number(text, true)) { return false; }
+
+            char* end = nullptr;
+            errno = 0;
+            long long parsed = std::strtoll(text, &end, 10);
+            if (errno != 0 || *end != '\0' || end == text || parsed < min || parsed > max) { return false; }
+            value = static_cast<int64_t>(parsed);
+            return true;
+        }
+
+        bool parse_real(const char* text, double& value, double min, double max)
+        {
+            if (!starts_with_number(text, true)) { return false; }
+
+            char* end = nullptr;
+            errno = 0;
+            double parsed = std::strtod(text, &end);
+            if (errno != 0 || *end != '\0' || end == text || !std::isfinite(parsed) || parsed < min || parsed > max) { return false; }
+            value = parsed;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,508 @@
+#include "Distributed.hpp"
+#include "Wire.hpp"
+#include "Perturbation.hpp"
+#include "Socket.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace alfrac
+{
+    namespace
+    {
+        const char     frame_magic[4]   = { 'A', 'F', 'W', 'P' };
+        const uint32_t protocol_version = 1;
+        const size_t   header_size      = 16;           // Сигнатура, тип (uint32) и длина содержимого (uint64).
+        const uint64_t max_frame_size   = uint64_t(1) << 30;
+        const size_t   references_kept  = 4;            // Опорных орбит в кэше вычислителя.
+
+        // Типы кадров.
+        enum Message : uint32_t
+        {
+            Hello   = 1, // Вычислитель -> координатор: версия, формула, число потоков.
+            Request = 2, // Координатор -> вычислитель: номер и запрос.
+            Result  = 3  // Вычислитель -> координатор: номер, признак успеха, результат или текст исключения.
+        };
+
+        // Кадр из двух частей содержимого (например, номера запроса и общего для всех отправок запроса).
+        bool send_frame(int socket, uint32_t type, const std::vector<uint8_t>& head, const std::vector<uint8_t>& body = std::vector<uint8_t>())
+        {
+            wire::Writer header;
+            header.put_bytes(frame_magic, sizeof(frame_magic));
+            header.put_u32(type);
+            header.put_u64(head.size() + body.size());
+            return net::write_all(socket, header.get_bytes().data(), header_size) &&
+                   net::write_all(socket, head.data(), head.size()) && net::write_all(socket, body.data(), body.size());
+        }
+
+        bool receive_frame(int socket, uint32_t& type, std::vector<uint8_t>& payload)
+        {
+            uint8_t header_bytes[header_size];
+            if (!net::read_all(socket, header_bytes, header_size)) { return false; }
+
+            wire::Reader header(header_bytes, header_size);
+            char magic[4];
+            header.get_bytes(magic, sizeof(magic));
+            type = header.get_u32();
+            uint64_t size = header.get_u64();
+            if (std::memcmp(magic, frame_magic, sizeof(magic)) != 0 || size > max_frame_size) { return false; }
+
+            payload.resize(static_cast<size_t>(size));
+            return net::read_all(socket, payload.data(), payload.size());
+        }
+
+        std::vector<std::string> split_addresses(const std::string& addresses)
+        {
+            std::vector<std::string> result;
+            size_t first = 0;
+            while (first <= addresses.size())
+            {
+                size_t comma = std::min(addresses.find(',', first), addresses.size());
+                if (comma > first) { result.push_back(addresses.substr(first, comma - first)); }
+                first = comma + 1;
+            }
+            return result;
+        }
+    }
+
+
+    ////////////////  WorkerServer   ///////////////
+    // Вычислитель: принимает запросы координаторов.
+    // PUBLIC:
+    WorkerServer::WorkerServer(std::shared_ptr<Fractal> init_fractal) : fractal{std::move(init_fractal)} { }
+    WorkerServer::~WorkerServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock_connections(mutex_connections);
+            for (const std::shared_ptr<Connection>& connection : connections) { ::shutdown(connection->socket, SHUT_RDWR); }
+        }
+        for (std::thread& thread : threads) { thread.join(); }
+    }
+
+    bool WorkerServer::serve(const std::string& address)
+    {
+        int listener = net::open_socket(address, true);
+        if (listener < 0) { return false; }
+
+        while (true)
+        {
+            int socket = ::accept(listener, nullptr, nullptr);
+            if (socket < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED) { continue; }
+                break;
+            }
+            net::tune_socket(socket);
+
+            std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+            connection->socket = socket;
+            std::lock_guard<std::mutex> lock_connections(mutex_connections);
+
+            // Потоки закрытых соединений присоединяются, чтобы не накапливались при переподключениях.
+            for (size_t index = connections.size(); index-- > 0;)
+            {
+                if (!connections[index]->closed.load()) { continue; }
+                threads[index].join();
+                threads.erase(threads.begin() + static_cast<std::ptrdiff_t>(index));
+                connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(index));
+            }
+            connections.push_back(connection);
+            threads.emplace_back(&WorkerServer::_serve_connection, this, connection);
+        }
+        ::close(listener);
+        return true;
+    }
+
+    // PROTECTED:
+    WorkerServer::Connection::~Connection()
+    {
+        if (socket >= 0) { ::close(socket); }
+    }
+
+    void WorkerServer::_serve_connection(std::shared_ptr<Connection> connection)
+    {
+        wire::Writer hello;
+        hello.put_u32(protocol_version);
+        hello.put_string(Fractal::formula());
+        hello.put_u64(fractal->get_workers_number());
+        bool open;
+        {
+            std::lock_guard<std::mutex> lock_send(connection->mutex_send);
+            open = send_frame(connection->socket, Hello, hello.get_bytes());
+        }
+
+        wire::ReferenceFactory make_reference = [this](const mpf_vector_2d& center, mp_bitcnt_t precision, int64_t iterations_limit, const mpf_class& max_absolute)
+        { return _reference(center, precision, iterations_limit, max_absolute); };
+
+        uint32_t type;
+        std::vector<uint8_t> payload;
+        while (open && receive_frame(connection->socket, type, payload))
+        {
+            if (type != Request) { continue; }
+
+            wire::Reader reader(payload.data(), payload.size());
+            uint64_t id = reader.get_u64();
+            Fractal::Request request;
+            if (!wire::read_request(reader, request, make_reference))
+            {
+                // Повреждённый запрос: координатор получает исключение вместо результата.
+                wire::Writer failure;
+                failure.put_u64(id);
+                failure.put_u8(0);
+                failure.put_string("Повреждённый запрос.");
+                std::lock_guard<std::mutex> lock_send(connection->mutex_send);
+                send_frame(connection->socket, Result, failure.get_bytes());
+                continue;
+            }
+
+            request.cancelled = std::make_shared<std::atomic<bool>>(false);
+            {
+                std::lock_guard<std::mutex> lock_requests(connection->mutex_requests);
+                connection->requests[id] = request.cancelled;
+            }
+
+            std::shared_ptr<Pending> pending = std::make_shared<Pending>();
+            request.notify = [this, connection, id, pending]() { _complete(connection, id, *pending, true); };
+            std::future<Fractal::Data> future = fractal->request_calc(request);
+            {
+                std::lock_guard<std::mutex> lock_state(pending->mutex_state);
+                pending->future = std::move(future);
+            }
+            _complete(connection, id, *pending, false);
+        }
+
+        // Координатор отключился: его незавершённые запросы не нужны.
+        {
+            std::lock_guard<std::mutex> lock_requests(connection->mutex_requests);
+            for (auto& entry : connection->requests) { entry.second->store(true); }
+            connection->requests.clear();
+        }
+        fractal->discard_cancelled();
+        ::shutdown(connection->socket, SHUT_RDWR);
+        connection->closed.store(true);
+    }
+
+    void WorkerServer::_complete(const std::shared_ptr<Connection>& connection, uint64_t id, Pending& pending, bool notified)
+    {
+        {
+            std::lock_guard<std::mutex> lock_state(pending.mutex_state);
+            (notified ? pending.ready : pending.attached) = true;
+            if (!pending.ready || !pending.attached) { return; }
+        }
+        {
+            std::lock_guard<std::mutex> lock_requests(connection->mutex_requests);
+            connection->requests.erase(id);
+        }
+
+        wire::Writer writer;
+        writer.put_u64(id);
+        try
+        {
+            Fractal::Data result = pending.future.get();
+            result.iterations.compress();
+            writer.put_u8(1);
+            wire::write_data(writer, result);
+        }
+        catch (const std::exception& exception)
+        {
+            writer.put_u8(0);
+            writer.put_string(exception.what());
+        }
+
+        std::lock_guard<std::mutex> lock_send(connection->mutex_send);
+        send_frame(connection->socket, Result, writer.get_bytes());
+    }
+
+    std::shared_ptr<ReferenceOrbit> WorkerServer::_reference(const mpf_vector_2d& center, mp_bitcnt_t precision, int64_t iterations_limit, const mpf_class& max_absolute)
+    {
+        std::lock_guard<std::mutex> lock_references(mutex_references);
+        for (size_t index = 0; index < references.size(); ++index)
+        {
+            const std::shared_ptr<ReferenceOrbit>& reference = references[index];
+            if (reference->get_precision() == precision && reference->get_iterations_limit() == iterations_limit &&
+                reference->get_center().x == center.x && reference->get_center().y == center.y && reference->get_max_absolute() == max_absolute)
+            {
+                // Найденная орбита переносится в конец (последняя использованная).
+                std::shared_ptr<ReferenceOrbit> found = reference;
+                references.erase(references.begin() + static_cast<std::ptrdiff_t>(index));
+                references.push_back(found);
+                return found;
+            }
+        }
+
+        if (references.size() >= references_kept) { references.erase(references.begin()); }
+        references.push_back(std::make_shared<ReferenceOrbit>(center, precision, iterations_limit, max_absolute));
+        return references.back();
+    }
+
+    // PRIVATE:
+
+
+
+
+    ////////////////   Coordinator   ///////////////
+    // Распределение запросов между вычислителями.
+    // PUBLIC:
+    Coordinator::Coordinator(const std::vector<std::string>& init_addresses)
+    {
+        for (const std::string& address : init_addresses)
+        {
+            workers.emplace_back(new Worker());
+            workers.back()->address = address;
+        }
+        for (std::unique_ptr<Worker>& worker : workers)
+        { worker->thread = std::thread(&Coordinator::_run_worker, this, std::ref(*worker)); }
+    }
+    Coordinator::Coordinator(const std::string& addresses) : Coordinator(split_addresses(addresses)) { }
+    Coordinator::~Coordinator()
+    {
+        terminate();
+    }
+
+    std::future<Fractal::Data> Coordinator::request_calc(const Fractal::Request& request)
+    {
+        wire::Writer writer;
+        wire::write_request(writer, request);
+
+        Task task;
+        task.priority = request.priority_token ? request.priority_token->load() : request.priority;
+        task.priority_token = request.priority_token;
+        task.payload = std::make_shared<const std::vector<uint8_t>>(std::move(writer.get_bytes()));
+        task.promise = std::make_shared<std::promise<Fractal::Data>>();
+        task.notify = request.notify;
+        task.cancelled = request.cancelled;
+        std::future<Fractal::Data> future = task.promise->get_future();
+        {
+            std::lock_guard<std::mutex> lock_state(mutex_state);
+            task.id = next_id++;
+            task.sequence = next_sequence++;
+            pending.push_back(std::move(task));
+            std::push_heap(pending.begin(), pending.end(), TaskCompare());
+        }
+        _dispatch();
+        return future;
+    }
+
+    void Coordinator::discard_cancelled()
+    {
+        std::lock_guard<std::mutex> lock_state(mutex_state);
+        pending.erase(std::remove_if(pending.begin(), pending.end(), [](const Task& task) { return task.cancelled && task.cancelled->load(); }), pending.end());
+        std::make_heap(pending.begin(), pending.end(), TaskCompare());
+    }
+
+    void Coordinator::reprioritise()
+    {
+        std::lock_guard<std::mutex> lock_state(mutex_state);
+        for (Task& task : pending)
+        {
+            if (task.priority_token) { task.priority = task.priority_token->load(); }
+        }
+        std::make_heap(pending.begin(), pending.end(), TaskCompare());
+    }
+
+    void Coordinator::terminate()
+    {
+        if (terminated.exchange(true)) { return; }
+        {
+            std::lock_guard<std::mutex> lock_state(mutex_state);
+            for (std::unique_ptr<Worker>& worker : workers)
+            {
+                if (worker->connected) { ::shutdown(worker->socket, SHUT_RDWR); }
+            }
+        }
+        for (std::unique_ptr<Worker>& worker : workers)
+        {
+            if (worker->thread.joinable()) { worker->thread.join(); }
+        }
+
+        std::lock_guard<std::mutex> lock_state(mutex_state);
+        pending.clear();
+    }
+
+    size_t Coordinator::get_workers_number() const
+    {
+        std::lock_guard<std::mutex> lock_state(mutex_state);
+        size_t threads = 0;
+        for (const std::unique_ptr<Worker>& worker : workers)
+        {
+            if (worker->connected) { threads += worker->threads; }
+        }
+        return threads;
+    }
+
+    int64_t Coordinator::get_queue_length() const
+    {
+        std::lock_guard<std::mutex> lock_state(mutex_state);
+        return static_cast<int64_t>(pending.size());
+    }
+
+    // PROTECTED:
+    bool Coordinator::TaskCompare::operator()(const Task& left, const Task& right) const
+    {
+        if (left.priority != right.priority) { return left.priority > right.priority; }
+        return left.sequence > right.sequence;
+    }
+
+    void Coordinator::_run_worker(Worker& worker)
+    {
+        while (!terminated.load())
+        {
+            // Подключение и приветствие вычислителя.
+            int socket = net::open_socket(worker.address, false);
+            uint32_t type = 0;
+            std::vector<uint8_t> payload;
+            bool accepted = false;
+            if (socket >= 0)
+            {
+                net::tune_socket(socket);
+                if (receive_frame(socket, type, payload) && type == Hello)
+                {
+                    wire::Reader reader(payload.data(), payload.size());
+                    uint32_t version = reader.get_u32();
+                    std::string formula = reader.get_string();
+                    size_t threads = reader.get_u64();
+                    accepted = !reader.failed() && version == protocol_version && formula == Fractal::formula() && threads > 0;
+                    if (!accepted)
+                    { std::cerr << "Вычислитель " << worker.address << " несовместим (версия " << version << ", формула " << formula << ")." << std::endl; }
+                    else
+                    {
+                        std::lock_guard<std::mutex> lock_state(mutex_state);
+                        worker.socket = socket;
+                        ++worker.generation;
+                        worker.threads = threads;
+                        worker.connected = !terminated.load();
+                        accepted = worker.connected;
+                    }
+                }
+                if (!accepted) { ::close(socket); }
+            }
+
+            if (accepted)
+            {
+                _dispatch();
+                while (receive_frame(socket, type, payload))
+                {
+                    if (type != Result) { continue; }
+
+                    wire::Reader reader(payload.data(), payload.size());
+                    uint64_t id = reader.get_u64();
+                    Task task;
+                    {
+                        std::lock_guard<std::mutex> lock_state(mutex_state);
+                        auto found = worker.in_flight.find(id);
+                        if (found == worker.in_flight.end()) { continue; }
+                        task = std::move(found->second);
+                        worker.in_flight.erase(found);
+                    }
+
+                    bool succeeded = reader.get_u8() == 1;
+                    Fractal::Data result;
+                    if (succeeded && wire::read_data(reader, result))
+                    { task.promise->set_value(std::move(result)); }
+                    else
+                    {
+                        std::string message = succeeded ? "Повреждённый результат от " + worker.address + "." : reader.get_string();
+                        task.promise->set_exception(std::make_exception_ptr(std::runtime_error(message)));
+                    }
+                    if (task.notify) { task.notify(); }
+                    _dispatch();
+                }
+
+                // Соединение разорвано: отправленные запросы возвращаются в очередь.
+                // Сокет закрывается под mutex записи, чтобы отправка из _dispatch() не попала в повторно выданный дескриптор.
+                std::vector<Task> failed;
+                {
+                    std::lock_guard<std::mutex> lock_send(worker.mutex_send);
+                    std::lock_guard<std::mutex> lock_state(mutex_state);
+                    worker.connected = false;
+                    ::close(worker.socket);
+                    worker.socket = -1;
+                    for (auto& entry : worker.in_flight)
+                    {
+                        Task& task = entry.second;
+                        if (task.attempts >= max_attempts) { failed.push_back(std::move(task)); continue; }
+                        pending.push_back(std::move(task));
+                        std::push_heap(pending.begin(), pending.end(), TaskCompare());
+                    }
+                    worker.in_flight.clear();
+                }
+                if (!terminated.load()) { std::cerr << "Соединение с вычислителем " << worker.address << " разорвано." << std::endl; }
+                for (Task& task : failed)
+                {
+                    task.promise->set_exception(std::make_exception_ptr(std::runtime_error("Запрос прерывал соединение с вычислителями " +
+                                                                                           std::to_string(max_attempts) + " раз.")));
+                    if (task.notify) { task.notify(); }
+                }
+                _dispatch();
+            }
+
+            // Переподключение не чаще раза в секунду (с проверкой завершения).
+            for (int step = 0; step < 10 && !terminated.load(); ++step) { std::this_thread::sleep_for(std::chrono::milliseconds(100)); }
+        }
+    }
+
+    void Coordinator::_dispatch()
+    {
+        // Назначение выполняется под блокировкой, отправка - после неё (каждому вычислителю - под его mutex записи,
+        // с проверкой, что соединение, которому назначен запрос, не сменилось).
+        struct Send
+        {
+            Worker* worker;
+            int socket;
+            uint64_t generation;
+            uint64_t id;
+            std::shared_ptr<const std::vector<uint8_t>> payload;
+        };
+        std::vector<Send> sends;
+        {
+            std::lock_guard<std::mutex> lock_state(mutex_state);
+            while (!pending.empty())
+            {
+                Worker* target = nullptr;
+                double target_load = 0.0;
+                for (std::unique_ptr<Worker>& worker : workers)
+                {
+                    if (!worker->connected || worker->in_flight.size() >= 2 * worker->threads) { continue; }
+                    double load = static_cast<double>(worker->in_flight.size() + 1) / static_cast<double>(worker->threads);
+                    if (!target || load < target_load)
+                    {
+                        target = worker.get();
+                        target_load = load;
+                    }
+                }
+                if (!target) { break; }
+
+                std::pop_heap(pending.begin(), pending.end(), TaskCompare());
+                Task task = std::move(pending.back());
+                pending.pop_back();
+                if (task.cancelled && task.cancelled->load()) { continue; }
+
+                ++task.attempts;
+                sends.push_back(Send{ target, target->socket, target->generation, task.id, task.payload });
+                target->in_flight.emplace(task.id, std::move(task));
+            }
+        }
+
+        for (const Send& send : sends)
+        {
+            wire::Writer head;
+            head.put_u64(send.id);
+            std::lock_guard<std::mutex> lock_send(send.worker->mutex_send);
+
+            // Пока удерживается mutex записи, сокет не закрывается; если соединение, которому назначен запрос, уже
+            // разорвано, запрос возвращён в очередь его потоком.
+            {
+                std::lock_guard<std::mutex> lock_state(mutex_state);
+                if (!send.worker->connected || send.worker->generation != send.generation || send.worker->socket != send.socket) { continue; }
+            }
+
+            // Ошибка записи разрывает соединение: его поток вернёт запросы в очередь.
+            if (!send_frame(send.socket, Request, head.get_bytes(), *send.payload)) { ::shutdown(send.socket, SHUT_RDWR); }
+        }
+    }
+
+    // PRIVATE:
+}
@@ -1,7 +1,13 @@
 #include "Fractal.hpp"
-#include <thread>
-#include <chrono>
+#include "Perturbation.hpp"
+#include "Kernel.hpp"
+#include "TileStore.hpp"
+#include "Instrumentation.hpp"
+#include "Distributed.hpp"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 //#define DEBUG_OUTPUT_REQUESTS
 //#define DEBUG_OUTPUT_LOOP
@@ -9,6 +15,70 @@
 
 namespace alfrac
 {
+    namespace
+    {
+        // Запас бит на накопление ошибок округления в ходе итераций.
+        const mp_bitcnt_t guard_bits = 12;
+
+        // Число бит мантиссы, доступное на уровнях точности double и double-double.
+        const mp_bitcnt_t double_bits        = 53;
+        const mp_bitcnt_t double_double_bits = 106;
+
+        // Наименьший двоичный порядок шага сетки, при котором отклонения в методе возмущений ещё представимы в double.
+        const double perturbation_min_log2_step = -960.0;
+
+        // Двоичный логарифм модуля числа (без переполнения при значениях вне диапазона double).
+        double log2_abs(const mpf_class& value)
+        {
+            if (sgn(value) == 0) { return -std::numeric_limits<double>::infinity(); }
+
+            signed long int exponent;
+            double mantissa = mpf_get_d_2exp(&exponent, value.get_mpf_t());
+            return std::log2(std::fabs(mantissa)) + static_cast<double>(exponent);
+        }
+
+        // Сумма таблицы итераций результата (для счётчиков): точки, признанные внутренними досрочно, засчитываются по пределу,
+        // заполненные подразбиением и продолженные - как обсчитанные с начала (см. Instrumentation::Snapshot).
+        uint64_t limit_equivalent_iterations(const Fractal::Data& data)
+        {
+            uint64_t total = 0;
+            for (size_t index = 0; index < data.iterations.size(); ++index) { total += static_cast<uint64_t>(data.iterations.get(index)); }
+            return total;
+        }
+
+        // Пригоден ли результат request.resume для продолжения ядром уровня tier с точностью precision
+        // (для Tier::Perturbation - точность опорной орбиты) и состоянием точки из state_size значений.
+        bool is_resumable(const Fractal::Request& request, Fractal::Tier tier, mp_bitcnt_t precision, size_t state_size)
+        {
+            const Fractal::Data* previous = request.resume.get();
+            if (!previous || !previous->orbits || previous->stride != 1) { return false; }
+            if (previous->grid_x != request.grid_x || previous->grid_y != request.grid_y) { return false; }
+            if (previous->iterations_limit > request.iterations_limit) { return false; }
+            if (request.smooth && previous->smooth.size() != previous->iterations.size()) { return false; }
+
+            const Fractal::Orbits& orbits = *previous->orbits;
+            if (orbits.tier != tier || previous->iterations.size() != request.grid_x * request.grid_y) { return false; }
+            if (!orbits.is_consistent(previous->iterations.size(), state_size)) { return false; }
+            if (tier == Fractal::Tier::Mpf && orbits.precision != precision) { return false; }
+            if (tier == Fractal::Tier::Perturbation)
+            {
+                // Состояния - отклонения от опорной орбиты и индексы в ней: опора должна совпадать.
+                const mpf_vector_2d& center = request.reference->get_center();
+                return orbits.precision == precision && orbits.reference_center.x == center.x && orbits.reference_center.y == center.y;
+            }
+            return true;
+        }
+
+        // Двоичный логарифм шага сетки запроса.
+        double log2_grid_step(const Fractal::Request& request)
+        {
+            const mpf_rectangle& rectangle = request.rectangle;
+            mpf_class step_x = (rectangle.top_right.x - rectangle.bottom_left.x) / static_cast<unsigned long>(request.grid_x);
+            mpf_class step_y = (rectangle.top_right.y - rectangle.bottom_left.y) / static_cast<unsigned long>(request.grid_y);
+            return std::min(log2_abs(step_x), log2_abs(step_y));
+        }
+    }
+
     ////////////////     STRUCTS     ///////////////
     // mpf_vector_2d
     mpf_vector_2d::mpf_vector_2d() { }
@@ -76,10 +146,77 @@ namespace alfrac
     ////////      Data      ////////
     Fractal::Data::Data() { }
     Fractal::Data::Data(const Fractal::Request& request)
-        : grid_x{request.grid_x}, grid_y{request.grid_y}, iterations(request.grid_x * request.grid_y, 0), iterations_limit{request.iterations_limit}
-    { }
+        : grid_x{request.grid_x}, grid_y{request.grid_y}, iterations(request.grid_x * request.grid_y, request.iterations_limit), iterations_limit{request.iterations_limit}
+    {
+        if (request.smooth) { smooth.assign(iterations.size(), 0.0f); }
+    }
+
+    ////////     Orbits     ////////
+    bool Fractal::Orbits::is_consistent(size_t points, size_t kernel_state_size) const
+    {
+        if (kernel_state_size == 0 || state_size != kernel_state_size || slots.size() != points) { return false; }
 
-    Fractal::Fractal() { }
+        // Заполнен лишь массив состояний, соответствующий уровню точности.
+        size_t values_number = 0;
+        switch (tier)
+        {
+            case Fractal::Tier::Double:
+            case Fractal::Tier::DoubleDouble:
+            case Fractal::Tier::Perturbation:
+                if (!mpf_values.empty()) { return false; }
+                values_number = values.size();
+                break;
+            case Fractal::Tier::Mpf:
+                if (!values.empty()) { return false; }
+                values_number = mpf_values.size();
+                break;
+            default:
+                return false;
+        }
+        if (values_number % state_size != 0) { return false; }
+
+        size_t states = values_number / state_size;
+        for (uint32_t slot : slots)
+        {
+            if (slot != Fractal::Orbits::none && slot >= states) { return false; }
+        }
+        return true;
+    }
+    size_t Fractal::Orbits::memory_usage() const
+    {
+        size_t usage = sizeof(Orbits) + slots.capacity() * sizeof(uint32_t) + values.capacity() * sizeof(double);
+        for (const mpf_class& value : mpf_values)
+        { usage += sizeof(mpf_class) + (value.get_prec() / mp_bits_per_limb + 1) * sizeof(mp_limb_t); }
+        return usage;
+    }
+
+    ////////    Progress    ////////
+    Fractal::Progress::Progress() { }
+    Fractal::Progress::Progress(std::function<void()> init_notify) : notify{std::move(init_notify)} { }
+
+    void Fractal::Progress::publish(const Fractal::Data& partial)
+    {
+        {
+            std::lock_guard<std::mutex> lock_data(mutex_data);
+            data = partial;
+            ++generation;
+        }
+        if (notify) { notify(); }
+    }
+
+    bool Fractal::Progress::fetch(Fractal::Data& partial, uint64_t& known_generation)
+    {
+        std::lock_guard<std::mutex> lock_data(mutex_data);
+        if (generation == known_generation) { return false; }
+
+        partial = data;
+        known_generation = generation;
+        return true;
+    }
+
+    Fractal::Fractal(size_t workers_number)
+        : scheduler(workers_number)
+    { }
     Fractal::~Fractal() { }
 
     std::future<Fractal::Data> Fractal::request_calc(const Fractal::Request& request)
@@ -88,143 +225,225 @@ namespace alfrac
         std::cout << "Новый запрос." << std::endl;
         #endif
 
-        // Блокировка очереди запросов (запись).
-        std::unique_lock<std::shared_mutex> lock_requests_queue(mutex_requests_queue);
+        // std::function требует копируемости, поэтому promise хранится в shared_ptr.
+        std::shared_ptr<std::promise<Fractal::Data>> promise = std::make_shared<std::promise<Fractal::Data>>();
+        std::future<Fractal::Data> future = promise->get_future();
+
+        // Найденный в хранилище результат возвращается сразу, без постановки в очередь.
+        if (store)
+        {
+            Fractal::Data stored;
+            if (store->load(request, stored))
+            {
+                promise->set_value(std::move(stored));
+                if (request.notify) { request.notify(); }
+                return future;
+            }
+        }
+
+        if (remote) { return remote->request_calc(request); }
+
+        // Отменённый до начала расчёта запрос удаляется из очереди, и future получает std::future_error (broken_promise).
+        Instrumentation::Clock::time_point submitted = instrumentation ? Instrumentation::Clock::now() : Instrumentation::Clock::time_point();
+        scheduler.submit([this, request, promise, submitted]()
+        {
+            #ifdef DEBUG_OUTPUT_LOOP
+            std::cout << "Начата обработка запроса." << std::endl;
+            #endif
+
+            try
+            {
+                if (instrumentation) { instrumentation->add_queue_length(scheduler.get_queue_length()); }
+                Instrumentation::Clock::time_point started = instrumentation ? Instrumentation::Clock::now() : Instrumentation::Clock::time_point();
+
+                Fractal::Data result = _calculate(request);
+                if (instrumentation) { instrumentation->add_task(submitted, started, Instrumentation::Clock::now(), limit_equivalent_iterations(result)); }
+
+                if (store) { store->save(request, result); }
+                promise->set_value(std::move(result));
+            }
+            catch (...)
+            { promise->set_exception(std::current_exception()); }
+            if (request.notify) { request.notify(); }
 
-        std::promise<Fractal::Data> promise;
-        std::future<Fractal::Data> future = promise.get_future();
-        requests_queue.push(std::pair< Fractal::Request, std::promise<Fractal::Data> >(request, std::move(promise)));
+            #ifdef DEBUG_OUTPUT_LOOP
+            std::cout << "Запрос обработан." << std::endl;
+            #endif
+        }, request.priority, request.cancelled, request.priority_token);
 
         #ifdef DEBUG_OUTPUT_REQUESTS
         std::cout << "Запрос успешно добавлен в очередь." << std::endl;
         #endif
 
-        // Оповещение о добавлении в очередь.
-        condition_requests.notify_one();
-
         return future;
     }
 
     Fractal::Data Fractal::calculate(const Fractal::Request& request)
-    { return _calculate(std::move(request)); }
-
-    void Fractal::loop()
     {
-        while(in_loop.load())
-        {
-            // Проверка очереди запросов.
-            #ifdef DEBUG_OUTPUT_LOOP
-            std::cout << "Проверка очереди запросов." << std::endl;
-            #endif
+        Fractal::Data result;
+        if (store && store->load(request, result)) { return result; }
 
-            std::pair< Fractal::Request, std::promise<Fractal::Data> > request__promise;
-            bool is_empty = true;
+        Instrumentation::Clock::time_point started = instrumentation ? Instrumentation::Clock::now() : Instrumentation::Clock::time_point();
+        result = _calculate(request);
+        if (instrumentation) { instrumentation->add_task(started, started, Instrumentation::Clock::now(), limit_equivalent_iterations(result)); }
 
-            // Проверка на пустоту.
-            {
-                std::unique_lock<std::shared_mutex> lock_requests_queue(mutex_requests_queue);
-                is_empty = requests_queue.empty();
-                if (!is_empty)
-                {
-                    #ifdef DEBUG_OUTPUT_LOOP
-                    std::cout << "Очередь не пуста." << std::endl;
-                    #endif
+        if (store) { store->save(request, result); }
+        return result;
+    }
 
-                    // Если очередь не пустая, извлекаем последний запрос.
-                    request__promise = std::move(requests_queue.front());
-                    requests_queue.pop();
+    const char* Fractal::formula()
+    { return "z^2+c/complex"; }
 
-                    #ifdef DEBUG_OUTPUT_LOOP
-                    std::cout << "Из очереди извлечен очередной запрос." << std::endl;
-                    #endif
-                }
-            }
+    void Fractal::set_store(std::shared_ptr<TileStore> new_store)
+    { store = std::move(new_store); }
 
-            // Если очередь была не пуста, производится вычисление данных.
-            if (!is_empty)
-            {
-                #ifdef DEBUG_OUTPUT_LOOP
-                std::cout << "Начата обработка запроса." << std::endl;
-                #endif
+    void Fractal::set_remote(std::shared_ptr<Coordinator> new_remote)
+    { remote = std::move(new_remote); }
 
-                request__promise.second.set_value(std::move(_calculate(request__promise.first)));
+    void Fractal::set_instrumentation(std::shared_ptr<Instrumentation> new_instrumentation)
+    { instrumentation = std::move(new_instrumentation); }
+    std::shared_ptr<Instrumentation> Fractal::get_instrumentation() const
+    { return instrumentation; }
 
-                #ifdef DEBUG_OUTPUT_LOOP
-                std::cout << "Запрос обработан успешно." << std::endl;
-                #endif
-            }
-            // Простой, когда очередь пуста.
-            else
-            {
-                // Если очередь пустая, а цикл продолжается, производится переход в режим ожидания.
-                std::unique_lock<std::mutex> wait_lock(mutex_condition_requests);
-                condition_requests.wait(wait_lock);
-            }
-            //std::this_thread::sleep_for(100ms);
-        }
+    void Fractal::discard_cancelled()
+    {
+        scheduler.purge();
+        if (remote) { remote->discard_cancelled(); }
+    }
 
-        #ifdef DEBUG_OUTPUT_LOOP
-        std::cout << "Завершение цикла обработки." << std::endl;
-        #endif
-        return;
+    void Fractal::reprioritise()
+    {
+        scheduler.reprioritise();
+        if (remote) { remote->reprioritise(); }
     }
 
     void Fractal::terminate_loops()
     {
-        in_loop.store(false);
-        condition_requests.notify_all();
-        return;
+        if (remote) { remote->terminate(); }
+        scheduler.terminate();
     }
 
-    // PROTECTED:
-    Fractal::Data Fractal::_calculate(const Fractal::Request& request)
+    size_t Fractal::get_workers_number() const
+    { return scheduler.get_workers_number(); }
+    int64_t Fractal::get_queue_length() const
+    { return scheduler.get_queue_length() + (remote ? remote->get_queue_length() : 0); }
+    std::vector<Scheduler::Utilization> Fractal::get_utilization() const
+    { return scheduler.get_utilization(); }
+
+    mp_bitcnt_t Fractal::required_precision(const Fractal::Request& request)
     {
-        Fractal::Data result(request);
+        const mpf_rectangle& rectangle = request.rectangle;
 
-        mpf_rectangle _rectangle = request.rectangle;
-        _rectangle.set_prec(request.precision);
+        double log2_step = log2_grid_step(request);
 
-        alg_mpf constant({ mpf_class("-2.6", request.precision), mpf_class("-2.9", request.precision) });
-        alg_mpf var({ mpf_class(0.0, request.precision), mpf_class(0.0, request.precision) });
+        // Наибольший модуль координат, встречающихся в ходе итераций.
+        double log2_magnitude = std::max({ log2_abs(rectangle.bottom_left.x), log2_abs(rectangle.bottom_left.y),
+                                           log2_abs(rectangle.top_right.x),   log2_abs(rectangle.top_right.y),
+                                           log2_abs(request.max_absolute) });
 
-        mpf_class sqr_max_absolute = request.max_absolute * request.max_absolute;
+        // Вырожденная сетка: различать нечего.
+        if (!std::isfinite(log2_step) || !std::isfinite(log2_magnitude))
+        { return guard_bits; }
 
-        for (size_t x = 0; x < request.grid_x; ++x)
+        return static_cast<mp_bitcnt_t>(std::max(0.0, std::ceil(log2_magnitude - log2_step))) + guard_bits;
+    }
+
+    Fractal::Tier Fractal::choose_tier(const Fractal::Request& request)
+    {
+        mp_bitcnt_t bits = required_precision(request);
+        if (bits <= double_bits)        { return Fractal::Tier::Double; }
+        if (bits <= double_double_bits) { return Fractal::Tier::DoubleDouble; }
+        if (request.reference && log2_grid_step(request) > perturbation_min_log2_step) { return Fractal::Tier::Perturbation; }
+        return Fractal::Tier::Mpf;
+    }
+
+    size_t Fractal::state_size(Fractal::Tier tier)
+    {
+        switch (tier)
         {
-            for (size_t y = 0; y < request.grid_y; ++y)
-            {
-                var.components[0] = mpf_class(0.0, request.precision);
-                var.components[1] = mpf_class(0.0, request.precision);
-                constant.components[0] = request.rectangle.bottom_left.x + (request.rectangle.top_right.x - request.rectangle.bottom_left.x)
-                * mpf_class(static_cast<double>(x) / static_cast<double>(request.grid_x), request.precision);
-                constant.components[1] = request.rectangle.bottom_left.y + (request.rectangle.top_right.y - request.rectangle.bottom_left.y)
-                * mpf_class(static_cast<double>(y) / static_cast<double>(request.grid_y), request.precision);
+            case Fractal::Tier::Double:       return kernel::Vectorized::state_size;
+            case Fractal::Tier::DoubleDouble: return kernel::Generic<alg_dd, algebra::DoubleDouble>::state_size;
+            case Fractal::Tier::Perturbation: return kernel::Perturbation::state_size;
+            case Fractal::Tier::Mpf:          return kernel::Mpf::state_size;
+        }
+        return 0;
+    }
 
-                //std::cout << var.components[0] << " : " << var.components[1] << std::endl;
+    const char* Fractal::Cancelled::what() const noexcept
+    { return "Fractal request cancelled"; }
 
-                int64_t step = 0;
-                for (; step < request.iterations_limit; ++step)
-                {
-                    var = var * var + constant;
+    // PROTECTED:
+    Fractal::Data Fractal::_calculate(const Fractal::Request& request)
+    {
+        Fractal::Data result(request);
 
-                    mpf_class sqr_absolute = var.components[0] * var.components[0] + var.components[1] * var.components[1];
-                    //mpf_class sqr_absolute = var.components[0] * var.components[1];
-                    //std::cout << sqr_max_absolute.get_prec() << std::endl;
+        // Состояния орбит собираются отдельно и присоединяются к результату после расчёта: промежуточные
+        // результаты прогрессивного обсчёта публикуются без них.
+        std::shared_ptr<Fractal::Orbits> orbits;
+        if (request.keep_orbits && !request.subdivide) { orbits = std::make_shared<Fractal::Orbits>(); }
+        const Fractal::Data* resume = nullptr;
 
-                    #ifdef DEBUG_STEPS_OUTPUT
-                    std::cout << step << ": " << X.components[0] << " " << X.components[1] << "   " << sqr_absolute << '\n';
-                    #endif
+        switch (choose_tier(request))
+        {
+            case Fractal::Tier::Double:
+            {
+                if (orbits) { orbits->tier = Fractal::Tier::Double; }
+                if (is_resumable(request, Fractal::Tier::Double, 0, kernel::Vectorized::state_size)) { resume = request.resume.get(); }
 
-                    if (cmp(sqr_absolute, sqr_max_absolute) > 0) { break; }
+                kernel::Vectorized vectorized_kernel(request);
+                kernel::run(vectorized_kernel, request, result, resume, orbits.get());
+                break;
+            }
+            case Fractal::Tier::DoubleDouble:
+            {
+                if (orbits) { orbits->tier = Fractal::Tier::DoubleDouble; }
+                if (is_resumable(request, Fractal::Tier::DoubleDouble, 0, kernel::Generic<alg_dd, algebra::DoubleDouble>::state_size)) { resume = request.resume.get(); }
+
+                kernel::Generic<alg_dd, algebra::DoubleDouble> double_double_kernel(request, static_cast<int>(double_double_bits));
+                kernel::run(double_double_kernel, request, result, resume, orbits.get());
+                break;
+            }
+            case Fractal::Tier::Perturbation:
+            {
+                // Опорная орбита, покинувшая круг на первом же шаге, непригодна: считается в длинной арифметике.
+                if (request.reference->length() > 1)
+                {
+                    mp_bitcnt_t reference_precision = request.reference->get_precision();
+                    if (orbits)
+                    {
+                        orbits->tier = Fractal::Tier::Perturbation;
+                        orbits->precision = reference_precision;
+                        orbits->reference_center = request.reference->get_center();
+                    }
+                    if (is_resumable(request, Fractal::Tier::Perturbation, reference_precision, kernel::Perturbation::state_size)) { resume = request.resume.get(); }
+
+                    kernel::Perturbation perturbation_kernel(request);
+                    kernel::run(perturbation_kernel, request, result, resume, orbits.get());
+                    break;
                 }
-                result.iterations[x * request.grid_x + y] = step;
-                //mpf_class sqr_absolute = var.components[0] * var.components[0] - var.components[1] * var.components[1];
-                //mpf_class sqr_absolute = var.components[0] * var.components[1];
-                //if (sqr_absolute > sqr_max_absolute) { result.iterations[x * request.grid_x + y] = 0; }
-                //else { result.iterations[x * request.grid_x + y] = request.iterations_limit; }
+            }
+            [[fallthrough]];
+            case Fractal::Tier::Mpf:
+            {
+                // Точность округляется вверх до целого числа лимбов GMP.
+                mp_bitcnt_t precision = (required_precision(request) + mp_bits_per_limb - 1) / mp_bits_per_limb * mp_bits_per_limb;
+                if (orbits)
+                {
+                    orbits->tier = Fractal::Tier::Mpf;
+                    orbits->precision = precision;
+                }
+                if (is_resumable(request, Fractal::Tier::Mpf, precision, kernel::Mpf::state_size)) { resume = request.resume.get(); }
+
+                kernel::Mpf mpf_kernel(request, precision);
+                kernel::run(mpf_kernel, request, result, resume, orbits.get());
+                break;
             }
         }
 
+        // Ядра прерываются между столбцами сетки; неполный результат не возвращается.
+        if (kernel::is_cancelled(request)) { throw Fractal::Cancelled(); }
+
+        result.orbits = std::move(orbits);
         return result;
     }
 
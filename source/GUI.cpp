@@ -1,6 +1,11 @@
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <unordered_set>
 #include "GUI.hpp"
+#include "Perturbation.hpp"
+#include "Instrumentation.hpp"
 
 //#define DEBUG_OUTPUT_FUTURE_REQUEST
 
@@ -15,6 +20,37 @@ namespace alfrac
     const size_t tile_width  = 128;
     const size_t tile_height = 128;
 
+    // Наибольшая сторона текстуры страницы атласа тайлов (ограничивается и возможностями видеокарты).
+    const unsigned int atlas_page_size = 2048;
+
+    // Добавка к приоритету тайлов за пределами экрана (больше любого расстояния до центра среди видимых тайлов).
+    const float offscreen_priority = 1.0e6f;
+
+    // Запас бит точности координат сверх требуемого глубиной приближения.
+    const mp_bitcnt_t precision_guard_bits = 64;
+
+    // Степень масштабирования камеры, по достижении которой центр и масштаб фрактала переносятся в текущий вид
+    // (координаты вида хранятся в float и при сильном приближении камеры теряют точность).
+    const int64_t rebase_scale_power = 16;
+
+    namespace
+    {
+        // Умножение на 2^exponent.
+        void scale_2exp(mpf_class& value, int64_t exponent)
+        {
+            if (exponent >= 0) { mpf_mul_2exp(value.get_mpf_t(), value.get_mpf_t(), static_cast<mp_bitcnt_t>(exponent)); }
+            else               { mpf_div_2exp(value.get_mpf_t(), value.get_mpf_t(), static_cast<mp_bitcnt_t>(-exponent)); }
+        }
+
+        // Номер тайла уровня level, содержащего координату.
+        mpz_class tile_index(mpf_class coordinate, int64_t level)
+        {
+            scale_2exp(coordinate, level);
+            mpf_floor(coordinate.get_mpf_t(), coordinate.get_mpf_t());
+            return mpz_class(coordinate);
+        }
+    }
+
     sf::FloatRect getViewBounds(const sf::View& view)
     {
         // TODO: учесть вращение.
@@ -26,67 +62,267 @@ namespace alfrac
         return view_rect;
     }
 
+    ////////////////    TileAtlas    ///////////////
+    // Общие текстуры для изображений тайлов.
+    // PUBLIC:
+    TileAtlas::TileAtlas(unsigned int init_slot_width, unsigned int init_slot_height)
+        : slot_width{init_slot_width}, slot_height{init_slot_height}
+    {
+        unsigned int page_size = std::min(atlas_page_size, sf::Texture::getMaximumSize());
+        columns = std::max(1u, page_size / slot_width);
+        rows    = std::max(1u, page_size / slot_height);
+    }
+
+    bool TileAtlas::allocate(Slot& slot)
+    {
+        // Ячейки выделяются на первых страницах, чтобы последние пустели и освобождали текстуры.
+        size_t page = 0;
+        while (page < pages.size() && pages[page].texture && pages[page].free_slots.empty()) { ++page; }
+        if (page == pages.size()) { pages.emplace_back(); }
+
+        Page& target = pages[page];
+        if (!target.texture)
+        {
+            std::unique_ptr<sf::Texture> texture(new sf::Texture());
+            if (!texture->create(columns * slot_width, rows * slot_height)) { return false; }
+            target.texture = std::move(texture);
+
+            // Ячейки выдаются по порядку от начала страницы.
+            target.free_slots.resize(columns * rows);
+            for (unsigned int index = 0; index < columns * rows; ++index) { target.free_slots[index] = columns * rows - 1 - index; }
+        }
+
+        unsigned int index = target.free_slots.back();
+        target.free_slots.pop_back();
+        ++slots_used;
+
+        slot.page = page;
+        slot.rectangle = sf::IntRect(static_cast<int>((index % columns) * slot_width), static_cast<int>((index / columns) * slot_height),
+                                     static_cast<int>(slot_width), static_cast<int>(slot_height));
+        return true;
+    }
+
+    void TileAtlas::release(const Slot& slot)
+    {
+        Page& page = pages[slot.page];
+        unsigned int index = static_cast<unsigned int>(slot.rectangle.top) / slot_height * columns + static_cast<unsigned int>(slot.rectangle.left) / slot_width;
+        page.free_slots.push_back(index);
+        --slots_used;
+
+        if (page.free_slots.size() == columns * rows)
+        {
+            page.texture.reset();
+            page.free_slots.clear();
+        }
+    }
+
+    void TileAtlas::update(const Slot& slot, const sf::Uint8* pixels)
+    {
+        pages[slot.page].texture->update(pixels, slot_width, slot_height,
+                                         static_cast<unsigned int>(slot.rectangle.left), static_cast<unsigned int>(slot.rectangle.top));
+    }
+
+    size_t TileAtlas::pages_number() const
+    { return pages.size(); }
+    const sf::Texture* TileAtlas::get_texture(size_t page) const
+    { return pages[page].texture.get(); }
+    size_t TileAtlas::get_slots_used() const
+    { return slots_used; }
+    unsigned int TileAtlas::get_slot_width() const
+    { return slot_width; }
+    unsigned int TileAtlas::get_slot_height() const
+    { return slot_height; }
+
+    // PROTECTED:
+
+    // PRIVATE:
+
+
+
+
     ////////////////      Tile      ////////////////
     // Класс для отображения прямоугольной части фрактала.
     // PUBLIC:
-    Tile::Tile()
+    Tile::Tile() { }
+    Tile::Tile(Fractal::Data init_data) : Tile()
     {
-        sprite.rotate(-90.0f);
+        data = std::move(init_data);
+        is_completed = true;
     }
-    Tile::Tile(std::future<Fractal::Data> future) : Tile()
+    Tile::~Tile()
     {
-        _future = std::move(future);
+        cancel();
+        if (atlas) { atlas->release(slot); }
     }
-    Tile::~Tile()
+
+    void Tile::start(std::future<Fractal::Data> future, Scheduler::CancelToken init_cancelled, std::shared_ptr<Fractal::Progress> init_progress,
+                     Scheduler::PriorityToken init_priority)
     {
-        // ...
+        _future = std::move(future);
+        cancelled = std::move(init_cancelled);
+        progress = std::move(init_progress);
+        priority = std::move(init_priority);
     }
 
-    void Tile::check()
+    void Tile::receive()
     {
-        if (!is_completed)
+        if (is_completed) { return; }
+
+        if (_future.valid() && (_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
         {
-            if (_future.valid() && (_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+            #ifdef DEBUG_OUTPUT_FUTURE_REQUEST
+            std::cout << "Результат запроса готов к отрисовке." << std::endl;
+            #endif
+
+            try
+            {
+                data = _future.get();
+                palette_id = 0;
+                is_completed = true;
+                progress.reset();
+            }
+            catch (const std::exception& exception)
             {
+                // Запрос был отменён: тайл остаётся пустым.
                 #ifdef DEBUG_OUTPUT_FUTURE_REQUEST
-                std::cout << "Результат запроса готов к отрисовке." << std::endl;
+                std::cout << "Запрос не выполнен: " << exception.what() << std::endl;
                 #endif
-
-                data = std::move(_future.get());
-                recolour();
-                is_completed = true;
             }
         }
+        else if (progress && progress->fetch(data, progress_generation))
+        {
+            // Промежуточный результат отображается до завершения обсчёта.
+            palette_id = 0;
+        }
     }
-    void Tile::recolour(sf::Color gradient_start, sf::Color gradient_end, sf::Color error)
+    bool Tile::outdated(const Palette& palette) const
+    { return palette_id != palette.get_id() && !data.iterations.empty(); }
+    void Tile::adopt_image(Tile& previous)
     {
-        size_t size = data.grid_x * data.grid_y;
-        pixels = std::vector<sf::Uint8>(4 * size, 0);
-
-        // Получение цветов через линейный градиент.
-        for (size_t i = 0; i < size; ++i)
+        if (atlas || !previous.atlas) { return; }
+        atlas = std::move(previous.atlas);
+        slot = previous.slot;
+        palette_id = previous.palette_id;
+    }
+    void Tile::cancel()
+    {
+        if (!is_completed && cancelled) { cancelled->store(true); }
+    }
+    void Tile::set_priority(double new_priority)
+    {
+        if (!is_completed && priority) { priority->store(new_priority); }
+    }
+    bool Tile::completed() const
+    { return is_completed; }
+    const Fractal::Data& Tile::get_data() const
+    { return data; }
+    size_t Tile::memory_usage() const
+    {
+        size_t orbits_usage = data.orbits ? data.orbits->memory_usage() : 0;
+        size_t image_usage = atlas ? 4 * static_cast<size_t>(slot.rectangle.width) * static_cast<size_t>(slot.rectangle.height) : 0;
+        return sizeof(Tile) + data.iterations.memory_usage() + data.smooth.capacity() * sizeof(float) + orbits_usage + image_usage;
+    }
+    void Tile::recolour(const Palette& palette, const std::shared_ptr<TileAtlas>& target_atlas)
+    {
+        // Тайлы всех уровней одного размера: данные другого размера в ячейку не помещаются.
+        if (data.grid_x != target_atlas->get_slot_width() || data.grid_y != target_atlas->get_slot_height()) { return; }
+        if (!atlas)
         {
-            double relative_iteration = static_cast<double>(data.iterations[i] % data.iterations_limit) / static_cast<double>(data.iterations_limit);
-            //std::cout << data.terations[i] << std::endl;
-            pixels[i * 4]     = static_cast<sf::Uint8>(static_cast<double>(gradient_start.r) * (1.0 - relative_iteration) + static_cast<double>(gradient_end.r * relative_iteration));
-            pixels[i * 4 + 1] = static_cast<sf::Uint8>(static_cast<double>(gradient_start.g) * (1.0 - relative_iteration) + static_cast<double>(gradient_end.g * relative_iteration));
-            pixels[i * 4 + 2] = static_cast<sf::Uint8>(static_cast<double>(gradient_start.b) * (1.0 - relative_iteration) + static_cast<double>(gradient_end.b * relative_iteration));
-            pixels[i * 4 + 3] = static_cast<sf::Uint8>(static_cast<double>(gradient_start.a) * (1.0 - relative_iteration) + static_cast<double>(gradient_end.a * relative_iteration));
+            if (!target_atlas->allocate(slot)) { return; }
+            atlas = target_atlas;
         }
+
+        // Буфер пикселей общий для всех тайлов: раскраска выполняется лишь в потоке интерфейса.
+        static std::vector<sf::Uint8> pixels;
+        pixels.resize(4 * data.grid_x * data.grid_y);
+        palette.colour(data, pixels.data());
         pixels[0] = 255;
         pixels[1] = 255;
         pixels[2] = 255;
 
-        // Создание и применение текстуры.
-        texture.create(data.grid_x, data.grid_y);
-        texture.update(&pixels[0]);
-        sprite.setTexture(texture, true);
+        atlas->update(slot, pixels.data());
+        palette_id = palette.get_id();
+
+        // Готовые данные нужны лишь для перекраски, сборки уровней и продолжения обсчёта: они хранятся сжатыми.
+        if (is_completed) { data.iterations.compress(); }
+    }
+
+    const TileAtlas::Slot* Tile::get_slot() const
+    { return atlas ? &slot : nullptr; }
+
+    void Tile::append_vertices(sf::VertexArray& vertices) const
+    {
+        // Строки изображения - столбцы данных (ось x), поэтому четырёхугольник повёрнут на -90 градусов:
+        // положение тайла - его левый нижний угол.
+        sf::Transform transform = getTransform();
+        transform.rotate(-90.0f);
+
+        float left   = static_cast<float>(slot.rectangle.left);
+        float top    = static_cast<float>(slot.rectangle.top);
+        float width  = static_cast<float>(slot.rectangle.width);
+        float height = static_cast<float>(slot.rectangle.height);
+        const sf::Vector2f corners[4] = { sf::Vector2f(0.0f, 0.0f), sf::Vector2f(width, 0.0f), sf::Vector2f(width, height), sf::Vector2f(0.0f, height) };
+        for (const sf::Vector2f& corner : corners)
+        { vertices.append(sf::Vertex(transform.transformPoint(corner), sf::Vector2f(left + corner.x, top + corner.y))); }
     }
 
     void Tile::draw(sf::RenderTarget &target, sf::RenderStates states) const
     {
-        states.transform *= getTransform(); // Применение текущей трансформации.
-        target.draw(sprite, states);        // Отрисовка привязанного спрайта.
+        if (!atlas) { return; }
+
+        sf::VertexArray vertices(sf::Quads, 0);
+        append_vertices(vertices);
+        states.texture = atlas->get_texture(slot.page);
+        target.draw(vertices, states);
+    }
+
+    // PROTECTED:
+
+    // PRIVATE:
+
+
+
+
+    ////////////////   TileAddress   ///////////////
+    // Положение тайла в пирамиде уровней детализации.
+    // PUBLIC:
+    TileAddress::TileAddress() { }
+    TileAddress::TileAddress(int64_t init_level, mpz_class init_x, mpz_class init_y)
+        : level{init_level}, x{std::move(init_x)}, y{std::move(init_y)}
+    { }
+
+    TileAddress TileAddress::parent() const
+    {
+        TileAddress result(level - 1, x, y);
+        mpz_fdiv_q_2exp(result.x.get_mpz_t(), x.get_mpz_t(), 1);
+        mpz_fdiv_q_2exp(result.y.get_mpz_t(), y.get_mpz_t(), 1);
+        return result;
+    }
+
+    TileAddress TileAddress::child(int dx, int dy) const
+    { return TileAddress(level + 1, 2 * x + dx, 2 * y + dy); }
+
+    mpf_rectangle TileAddress::rectangle(mp_bitcnt_t precision) const
+    {
+        mpf_class left(x, precision);
+        mpf_class bottom(y, precision);
+        mpf_class right(x + 1, precision);
+        mpf_class top(y + 1, precision);
+        for (mpf_class* value : { &left, &bottom, &right, &top })
+        { scale_2exp(*value, -level); }
+        return mpf_rectangle(left, bottom, right, top);
+    }
+
+    bool TileAddress::operator==(const TileAddress& right) const
+    { return level == right.level && x == right.x && y == right.y; }
+
+    std::size_t TileAddressHasher::operator()(const TileAddress& address) const
+    {
+        // Младшие биты номеров различают соседние тайлы; старшие на одном экране совпадают.
+        std::size_t hash = std::hash<int64_t>()(address.level);
+        hash ^= std::hash<long>()(mpz_get_si(address.x.get_mpz_t())) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= std::hash<long>()(mpz_get_si(address.y.get_mpz_t())) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
     }
 
     // PROTECTED:
@@ -96,10 +332,91 @@ namespace alfrac
 
 
 
+    ////////////////    TileCache    ///////////////
+    // Таблица тайлов с ограничением по занимаемой памяти.
+    // PUBLIC:
+    TileCache::TileCache(size_t init_budget) : budget{init_budget} { }
+
+    std::shared_ptr<Tile> TileCache::find(const TileAddress& address, bool visible)
+    {
+        auto found = index.find(address);
+        if (found == index.end())
+        {
+            ++statistics.misses;
+            return nullptr;
+        }
+
+        ++statistics.hits;
+        entries.splice(entries.begin(), entries, found->second);
+        if (visible) { found->second->visible_frame = frame; }
+        return found->second->tile;
+    }
+
+    void TileCache::insert(const TileAddress& address, std::shared_ptr<Tile> tile, bool visible)
+    {
+        auto found = index.find(address);
+        if (found != index.end()) { entries.erase(found->second); }
+
+        entries.push_front(Entry{ address, std::move(tile), visible ? frame : 0 });
+        index[address] = entries.begin();
+        statistics.tiles = entries.size();
+    }
+
+    void TileCache::clear()
+    {
+        entries.clear();
+        index.clear();
+        statistics.tiles = 0;
+        statistics.bytes = 0;
+    }
+
+    void TileCache::next_frame()
+    { ++frame; }
+
+    void TileCache::trim()
+    {
+        // Размер тайлов меняется по мере завершения их обсчёта, поэтому пересчитывается целиком.
+        size_t bytes = 0;
+        for (const Entry& entry : entries)
+        { bytes += entry.tile->memory_usage(); }
+
+        // Вытеснение начинается с давно не использованных тайлов; отображаемые пропускаются.
+        auto iterator = entries.end();
+        while (bytes > budget && iterator != entries.begin())
+        {
+            --iterator;
+            if (iterator->visible_frame == frame) { continue; }
+
+            bytes -= iterator->tile->memory_usage();
+            index.erase(iterator->address);
+            iterator = entries.erase(iterator);
+            ++statistics.evictions;
+        }
+
+        statistics.tiles = entries.size();
+        statistics.bytes = bytes;
+    }
+
+    void TileCache::set_budget(size_t new_budget)
+    { budget = new_budget; }
+    size_t TileCache::get_budget() const
+    { return budget; }
+    const TileCache::Statistics& TileCache::get_statistics() const
+    { return statistics; }
+
+    // PROTECTED:
+
+    // PRIVATE:
+
+
+
+
     ////////////////      GUI       ////////////////
     // Основной класс для графического интерфейса.
     // PUBLIC:
-    GUI::GUI(std::shared_ptr<Fractal> init_fractal)
+    GUI::GUI(std::shared_ptr<Fractal> init_fractal) : GUI(init_fractal, Settings()) { }
+    GUI::GUI(std::shared_ptr<Fractal> init_fractal, const Settings& init_settings)
+        : settings(init_settings), tiles(init_settings.tile_cache_budget)
     {
         assigned_fractal = init_fractal;
 
@@ -119,6 +436,9 @@ namespace alfrac
         ui_view.setViewport(sf::FloatRect(0.0f, 0.0f, 1.0f, 1.0f));
 
         window.setView(view);
+
+        completions = std::make_shared<CompletionQueue<std::weak_ptr<Tile>>>();
+        atlas = std::make_shared<TileAtlas>(static_cast<unsigned int>(tile_width), static_cast<unsigned int>(tile_height));
     }
     GUI::~GUI()
     {
@@ -170,6 +490,24 @@ namespace alfrac
         bits_text.setPosition(0.0f, 32.0f);
         bits_text.setString(std::to_string(settings.precision) + " bits");
 
+        // Текст для статистики таблицы тайлов.
+        sf::Text cache_text;
+        cache_text.setFont(font);
+        cache_text.setCharacterSize(16);
+        cache_text.setFillColor(sf::Color::White);
+        cache_text.setPosition(0.0f, 48.0f);
+
+        // Текст для счётчиков конвейера обсчёта (обновляется раз в секунду по приращениям счётчиков).
+        std::shared_ptr<Instrumentation> instrumentation = assigned_fractal->get_instrumentation();
+        sf::Text pipeline_text;
+        pipeline_text.setFont(font);
+        pipeline_text.setCharacterSize(16);
+        pipeline_text.setFillColor(sf::Color::White);
+        pipeline_text.setPosition(0.0f, 64.0f);
+        Instrumentation::Snapshot last_snapshot;
+        std::vector<Scheduler::Utilization> last_utilization = assigned_fractal->get_utilization();
+        sf::Clock pipeline_clock;
+
         sf::Vector2f mouse_position;
         sf::Event window_event;
         while (window.isOpen())
@@ -234,9 +572,16 @@ namespace alfrac
 
                         view.setSize(static_cast<sf::Vector2f>(window.getSize()) * static_cast<float>(pow(settings.scale_base, settings.scale_power)));
                         window.setView(view);
-                        mouse_position = window.mapPixelToCoords(sf::Mouse::getPosition(window));
 
-                        fetch_tiles(getViewBounds(view));
+                        // Тайлы нужного уровня детализации запрашиваются сразу; до их готовности видны тайлы соседних уровней.
+                        if (std::abs(settings.scale_power) >= rebase_scale_power)
+                        {
+                            rescale_fractal();
+                            bits_text.setString(std::to_string(settings.precision) + " bits");
+                        }
+                        else
+                        { fetch_tiles(getViewBounds(view)); }
+                        mouse_position = window.mapPixelToCoords(sf::Mouse::getPosition(window));
 
                         int64_t camera_zoom  = static_cast<int64_t>(pow(settings.scale_base, static_cast<double>(-settings.scale_power - settings.fractal_scale_power)));
                         int64_t fractal_zoom = static_cast<int64_t>(pow(settings.scale_base, static_cast<double>(-settings.fractal_scale_power)));
@@ -251,6 +596,7 @@ namespace alfrac
                             case sf::Keyboard::R:
                             {
                                 rescale_fractal();
+                                bits_text.setString(std::to_string(settings.precision) + " bits");
 
                                 int64_t camera_zoom  = static_cast<int64_t>(pow(settings.scale_base, static_cast<double>(-settings.scale_power - settings.fractal_scale_power)));
                                 int64_t fractal_zoom = static_cast<int64_t>(pow(settings.scale_base, static_cast<double>(-settings.fractal_scale_power)));
@@ -263,18 +609,25 @@ namespace alfrac
                                 settings.draw_ui = !settings.draw_ui;
                                 break;
                             }
+                            case sf::Keyboard::P:
+                            {
+                                // Тайлы перекрашиваются при следующей отрисовке (см. GUI::draw_tiles()); пересчёта не требуется.
+                                settings.palette = (settings.palette + 1) % Palette::presets().size();
+                                break;
+                            }
+                            case sf::Keyboard::S:
+                            {
+                                // Новый режим применяется к тайлам, запрошенным после переключения.
+                                settings.subdivide = !settings.subdivide;
+                                break;
+                            }
                             case sf::Keyboard::Dash:
                             {
                                 if (sf::Keyboard::isKeyPressed(sf::Keyboard::I))
                                 {
-                                    settings.iterations_limit >>= 1;
+                                    change_iterations_limit(std::max<int64_t>(1, settings.iterations_limit >> 1));
                                     iterations_text.setString(std::to_string(settings.iterations_limit) + " iterations");
                                 }
-                                if (sf::Keyboard::isKeyPressed(sf::Keyboard::B))
-                                {
-                                    settings.precision >>= 1;
-                                    bits_text.setString(std::to_string(settings.precision) + " bits");
-                                }
 
                                 break;
                             }
@@ -282,14 +635,9 @@ namespace alfrac
                             {
                                 if (sf::Keyboard::isKeyPressed(sf::Keyboard::I))
                                 {
-                                    settings.iterations_limit <<= 1;
+                                    change_iterations_limit(settings.iterations_limit << 1);
                                     iterations_text.setString(std::to_string(settings.iterations_limit) + " iterations");
                                 }
-                                if (sf::Keyboard::isKeyPressed(sf::Keyboard::B))
-                                {
-                                    settings.precision <<= 1;
-                                    bits_text.setString(std::to_string(settings.precision) + " bits");
-                                }
 
                                 break;
                             }
@@ -315,11 +663,8 @@ namespace alfrac
 
             // Рисование тайлов.
             window.setView(view);
-            for (size_t i = 0; i < onscreen_tiles.size(); ++i)
-            {
-                onscreen_tiles[i]->check();
-                window.draw(*onscreen_tiles[i]);
-            }
+            receive_tiles();
+            draw_tiles(instrumentation.get());
 
             // Рисование элементов интерфейса.
             if (settings.draw_ui)
@@ -328,6 +673,45 @@ namespace alfrac
                 window.draw(scale_text);
                 window.draw(iterations_text);
                 window.draw(bits_text);
+
+                const TileCache::Statistics& statistics = tiles.get_statistics();
+                cache_text.setString(std::to_string(statistics.tiles) + " tiles, " + std::to_string(statistics.bytes >> 20) + " MiB, " +
+                                     std::to_string(statistics.hits) + " hits, " + std::to_string(statistics.misses) + " misses, " +
+                                     std::to_string(statistics.evictions) + " evictions, " + std::to_string(atlas->pages_number()) + " pages, " +
+                                     std::to_string(draw_calls) + " draws");
+                window.draw(cache_text);
+
+                if (instrumentation)
+                {
+                    if (pipeline_clock.getElapsedTime().asSeconds() >= 1.0f)
+                    {
+                        double elapsed = pipeline_clock.restart().asSeconds();
+                        Instrumentation::Snapshot snapshot = instrumentation->get_snapshot();
+                        std::vector<Scheduler::Utilization> utilization = assigned_fractal->get_utilization();
+
+                        // Средние по запросам и загрузкам за прошедшую секунду; занятость - доля времени работы всех вычислителей.
+                        double tasks = static_cast<double>(std::max<uint64_t>(1, snapshot.tasks - last_snapshot.tasks));
+                        double uploads = static_cast<double>(std::max<uint64_t>(1, snapshot.uploads - last_snapshot.uploads));
+                        uint64_t busy_ns = 0;
+                        for (size_t worker = 0; worker < utilization.size(); ++worker)
+                        { busy_ns += utilization[worker].busy_ns - last_utilization[worker].busy_ns; }
+                        double busy = 1e-9 * static_cast<double>(busy_ns) / (elapsed * static_cast<double>(utilization.size()));
+
+                        char text[256];
+                        std::snprintf(text, sizeof(text), "queue %lld, wait %.1f ms, compute %.1f ms/tile, %.1f Mit/s limit-equiv., upload %.2f ms, busy %.0f%%",
+                                      static_cast<long long>(assigned_fractal->get_queue_length()),
+                                      1e-6 * static_cast<double>(snapshot.queue_wait_ns - last_snapshot.queue_wait_ns) / tasks,
+                                      1e-6 * static_cast<double>(snapshot.compute_ns - last_snapshot.compute_ns) / tasks,
+                                      1e-6 * static_cast<double>(snapshot.limit_equivalent_iterations - last_snapshot.limit_equivalent_iterations) / elapsed,
+                                      1e-6 * static_cast<double>(snapshot.upload_ns - last_snapshot.upload_ns) / uploads,
+                                      100.0 * std::min(1.0, busy));
+                        pipeline_text.setString(text);
+
+                        last_snapshot = snapshot;
+                        last_utilization = std::move(utilization);
+                    }
+                    window.draw(pipeline_text);
+                }
             }
 
             window.setView(view); // Требуется для корректной обработки движения камеры мышкой.
@@ -339,62 +723,339 @@ namespace alfrac
 
     void GUI::fetch_tiles(const sf::FloatRect& rectangle)
     {
-        // Отображение точек прямоугольника в тайлы сетки (учитывается максимально возможное покрытие).
-        int X1 = static_cast<int>(floor(floor(rectangle.left) / static_cast<float>(tile_width)));
-        int Y1 = static_cast<int>(floor(floor(rectangle.top)  / static_cast<float>(tile_height)));
-        int X2 = static_cast<int>(ceil(ceil(rectangle.left + rectangle.width) / static_cast<float>(tile_width)));
-        int Y2 = static_cast<int>(ceil(ceil(rectangle.top + rectangle.height) / static_cast<float>(tile_height)));
+        int64_t level = detail_level();
+        mp_bitcnt_t precision = level_precision(level);
+
+        // Прямоугольник вида на алгебраической плоскости (ось y вида направлена вниз) и номера покрывающих его тайлов уровня.
+        auto to_fractal = [this, precision](float coordinate, const mpf_class& origin, bool flip)
+        {
+            mpf_class value(static_cast<mpf_class>(flip ? -coordinate : coordinate) * settings.fractal_scale_factor + origin, precision);
+            return value;
+        };
+        mpf_class left   = to_fractal(rectangle.left,                    settings.fractal_scale_origin.x, false);
+        mpf_class right  = to_fractal(rectangle.left + rectangle.width,  settings.fractal_scale_origin.x, false);
+        mpf_class top    = to_fractal(rectangle.top,                     settings.fractal_scale_origin.y, true);
+        mpf_class bottom = to_fractal(rectangle.top + rectangle.height,  settings.fractal_scale_origin.y, true);
 
-        size_t tiles_number = static_cast<size_t>((X2 - X1 + 1) * (Y2 - Y1 + 1));
-        if (tiles_number > settings.max_tiles_number)
+        mpz_class X1 = tile_index(left, level);
+        mpz_class X2 = tile_index(right, level);
+        mpz_class Y1 = tile_index(bottom, level);
+        mpz_class Y2 = tile_index(top, level);
+
+        mpz_class tiles_number = (X2 - X1 + 1) * (Y2 - Y1 + 1);
+        if (tiles_number > static_cast<unsigned long>(settings.max_tiles_number))
         { return; }
+        long width  = mpz_class(X2 - X1).get_si() + 1;
+        long height = mpz_class(Y2 - Y1).get_si() + 1;
+
+        // Центр области в единицах тайлов относительно тайла (X1, Y1): запросы ближе к центру обрабатываются раньше.
+        mpf_class center_x((left + right) / 2, precision);
+        mpf_class center_y((bottom + top) / 2, precision);
+        scale_2exp(center_x, level);
+        scale_2exp(center_y, level);
+        double offset_x = mpf_class(center_x - X1).get_d();
+        double offset_y = mpf_class(center_y - Y1).get_d();
 
+        // Тайлы уровня в области предзагрузки. Не готовый видимый тайл замещается ближайшим завершённым предком
+        // (увеличенным) и имеющимися тайлами следующего уровня (уменьшенными); они рисуются под ним, от грубых к точным.
+        int margin = settings.prefetch_margin;
+        std::unordered_set<TileAddress, TileAddressHasher> wanted;
+        std::vector<std::pair<TileAddress, std::shared_ptr<Tile>>> exact;    // Видимые тайлы уровня.
+        std::vector<std::pair<TileAddress, std::shared_ptr<Tile>>> fallback; // Замещающие тайлы других уровней.
         onscreen_tiles.clear();
-        onscreen_tiles.reserve(tiles_number);
-        for (int y = Y1; y <= Y2; ++y)
+        onscreen_layers.clear();
+        tiles.next_frame();
+        bool reprioritised = false; // Изменены ли приоритеты запросов, уже стоящих в очереди.
+        for (long dy = -margin; dy < height + margin; ++dy)
         {
-            for (int x = X1; x <= X2; ++x)
+            for (long dx = -margin; dx < width + margin; ++dx)
             {
-                //std::cout << x << " : " << y << std::endl;
-                auto iterator = tiles.find(sf::Vector2i(x, y));
+                TileAddress address(level, X1 + dx, Y1 + dy);
+                bool onscreen = dx >= 0 && dx < width && dy >= 0 && dy < height;
+                wanted.insert(address);
 
-                // Проверка, существует ли указанный тайл.
-                if (iterator == tiles.end())
+                // Приоритет: сначала видимые тайлы, затем предзагружаемые; среди них - ближайшие к центру.
+                double distance_x = static_cast<double>(dx) + 0.5 - offset_x;
+                double distance_y = static_cast<double>(dy) + 0.5 - offset_y;
+                float priority = static_cast<float>(std::sqrt(distance_x * distance_x + distance_y * distance_y)) + (onscreen ? 0.0f : offscreen_priority);
+
+                std::shared_ptr<Tile> existing = tiles.find(address, onscreen);
+                if (!existing)
                 {
-                    // Возможно, запрос новый тайлов запрещён при текущем масштабе.
-                    if (settings.request_on_downscale || settings.scale_power <= 0)
+                    // Отсутствующий тайл собирается из тайлов следующего уровня, если все они обсчитаны, иначе запрашивается.
+                    existing = synthesise_tile(address);
+                    if (!existing)
                     {
-                        // Если тайл не существует, создаётся новый и добавляется в таблицу тайлов и в массив отображаемых тайлов.
-
-                        // Составление запроса.
-                        Fractal::Request request;
-                        request.rectangle.bottom_left.x = static_cast<mpf_class>(  x      * static_cast<int>(tile_width))  * settings.fractal_scale_factor + settings.fractal_scale_origin.x;
-                        request.rectangle.bottom_left.y = static_cast<mpf_class>( -y      * static_cast<int>(tile_height)) * settings.fractal_scale_factor + settings.fractal_scale_origin.y;
-                        request.rectangle.top_right.x   = static_cast<mpf_class>(( x + 1) * static_cast<int>(tile_width))  * settings.fractal_scale_factor + settings.fractal_scale_origin.x;
-                        request.rectangle.top_right.y   = static_cast<mpf_class>((-y + 1) * static_cast<int>(tile_height)) * settings.fractal_scale_factor + settings.fractal_scale_origin.y;
-
-                        request.grid_x = tile_width;
-                        request.grid_y = tile_height;
-
-                        request.precision = settings.precision;
-                        request.iterations_limit = settings.iterations_limit;
-                        request.max_absolute = settings.max_absolute;
-                        request.max_absolute.set_prec(settings.precision);
-
-                        // Создание тайла, соответствующего запросу, и добавление его в таблицу и массив.
-                        std::shared_ptr<Tile> tile = std::make_shared<Tile>(assigned_fractal->request_calc(request));
-                        tiles.insert(std::pair<sf::Vector2i, std::shared_ptr<Tile>>(sf::Vector2i(x, y), tile));
-                        onscreen_tiles.push_back(tile);
-                        tile->setPosition(static_cast<float>(x * static_cast<int>(tile_width)), static_cast<float>(y * static_cast<int>(tile_height)));
+                        Fractal::Request request = make_request(address, priority);
+                        existing = request_tile(request);
                     }
+                    tiles.insert(address, existing, onscreen);
+                }
+                else if (existing->completed() && existing->get_data().iterations_limit != settings.iterations_limit)
+                {
+                    // Тайл обсчитан с прежним числом итераций: запрашивается продолжение его результата (если орбиты сохранены
+                    // и число итераций выросло; иначе - расчёт заново). До завершения отображается прежний результат.
+                    Fractal::Request request = make_request(address, priority);
+                    request.resume = std::make_shared<Fractal::Data>(existing->get_data());
+
+                    std::shared_ptr<Tile> resumed = request_tile(request);
+                    resumed->adopt_image(*existing);
+                    existing = std::move(resumed);
+                    tiles.insert(address, existing, onscreen);
+                }
+                else if (!existing->completed())
+                {
+                    // Приоритет запрошенного ранее тайла пересчитывается по текущему виду.
+                    existing->set_priority(priority);
+                    reprioritised = true;
                 }
-                else
+                if (!onscreen) { continue; }
+
+                exact.emplace_back(address, existing);
+                if (existing->completed()) { continue; }
+
+                TileAddress ancestor = address;
+                for (int up = 0; up < settings.fallback_levels; ++up)
                 {
-                    // Если тайл существует, он добавляется в массив отображаемых тайлов.
-                    onscreen_tiles.push_back(iterator->second);
+                    ancestor = ancestor.parent();
+                    std::shared_ptr<Tile> found = tiles.find(ancestor, true);
+                    if (found && found->completed())
+                    {
+                        fallback.emplace_back(ancestor, found);
+                        break;
+                    }
                 }
+                for (int child_y = 0; child_y < 2; ++child_y)
+                {
+                    for (int child_x = 0; child_x < 2; ++child_x)
+                    {
+                        TileAddress child = address.child(child_x, child_y);
+                        std::shared_ptr<Tile> found = tiles.find(child, true);
+                        if (found) { fallback.emplace_back(child, found); }
+                    }
+                }
+            }
+        }
+
+        // Порядок рисования: замещающие тайлы от грубых к точным (без повторов), затем тайлы уровня. Слой замещающего
+        // тайла - его уровень, тайлы уровня образуют последний слой.
+        std::stable_sort(fallback.begin(), fallback.end(), [](const auto& left_tile, const auto& right_tile) { return left_tile.first.level < right_tile.first.level; });
+        std::unordered_set<const Tile*> placed;
+        onscreen_tiles.reserve(fallback.size() + exact.size());
+        onscreen_layers.reserve(fallback.size() + exact.size());
+        for (const auto* list : { &fallback, &exact })
+        {
+            for (const auto& entry : *list)
+            {
+                if (!placed.insert(entry.second.get()).second) { continue; }
+                place_tile(*entry.second, entry.first);
+                onscreen_tiles.push_back(entry.second);
+                onscreen_layers.push_back(list == &exact ? INT64_MAX : entry.first.level);
             }
         }
+
+        // Незавершённые тайлы, вышедшие за область предзагрузки или принадлежащие другим уровням, удаляются, и их запросы
+        // отменяются (в том числе у незавершённых замещающих тайлов следующего уровня, на которые ссылается onscreen_tiles).
+        tiles.erase_if([&wanted](const TileAddress& address, const Tile& tile) { return !tile.completed() && wanted.count(address) == 0; });
+
+        // Вытесненные незавершённые тайлы отменяют свои запросы: отменённые задачи удаляются из очереди.
+        tiles.trim();
+        assigned_fractal->discard_cancelled();
+        if (reprioritised) { assigned_fractal->reprioritise(); }
+    }
+
+    void GUI::change_iterations_limit(int64_t new_iterations_limit)
+    {
+        settings.iterations_limit = new_iterations_limit;
+        update_reference();
+
+        // Незавершённые тайлы запрошены с прежним числом итераций: они отменяются и запрашиваются заново,
+        // завершённые продолжаются (см. fetch_tiles()).
+        onscreen_tiles.clear();
+        onscreen_layers.clear();
+        tiles.erase_if([](const TileAddress&, const Tile& tile) { return !tile.completed(); });
+        assigned_fractal->discard_cancelled();
+        fetch_tiles(getViewBounds(view));
+    }
+
+    Fractal::Request GUI::make_request(const TileAddress& address, float priority) const
+    {
+        Fractal::Request request;
+        request.precision = level_precision(address.level);
+        request.rectangle = address.rectangle(request.precision);
+
+        request.grid_x = tile_width;
+        request.grid_y = tile_height;
+
+        request.iterations_limit = settings.iterations_limit;
+        request.max_absolute = settings.max_absolute;
+        request.max_absolute.set_prec(request.precision);
+        request.reference = reference;
+
+        request.priority = priority;
+        request.priority_token = std::make_shared<std::atomic<double>>(priority);
+        request.cancelled = std::make_shared<std::atomic<bool>>(false);
+        request.subdivide = settings.subdivide;
+        request.smooth = settings.smooth;
+        if (settings.progressive && !settings.subdivide) { request.progress = std::make_shared<Fractal::Progress>(); }
+        request.keep_orbits = settings.keep_orbits && Fractal::choose_tier(request) != Fractal::Tier::Mpf;
+        return request;
+    }
+
+    std::shared_ptr<Tile> GUI::synthesise_tile(const TileAddress& address)
+    {
+        // Точки сетки тайла - каждая вторая точка сеток четырёх тайлов следующего уровня. В длинной арифметике
+        // координаты совпадают точно и собранный тайл равен обсчитанному; на остальных уровнях точности координаты
+        // каждого тайла округляются отдельно, поэтому собранный тайл - приближение (отличия возможны у границы множества).
+        std::shared_ptr<Tile> quarters[2][2];
+        for (int dy = 0; dy < 2; ++dy)
+        {
+            for (int dx = 0; dx < 2; ++dx)
+            {
+                std::shared_ptr<Tile> child = tiles.find(address.child(dx, dy), false);
+                if (!child || !child->completed()) { return nullptr; }
+
+                const Fractal::Data& child_data = child->get_data();
+                if (child_data.stride != 1 || child_data.iterations_limit != settings.iterations_limit ||
+                    child_data.grid_x != tile_width || child_data.grid_y != tile_height ||
+                    (settings.smooth && child_data.smooth.size() != child_data.iterations.size()))
+                { return nullptr; }
+                quarters[dx][dy] = std::move(child);
+            }
+        }
+
+        Fractal::Data data;
+        data.grid_x = tile_width;
+        data.grid_y = tile_height;
+        data.iterations_limit = settings.iterations_limit;
+        data.iterations = IterationTable(tile_width * tile_height, settings.iterations_limit);
+        if (settings.smooth) { data.smooth.resize(tile_width * tile_height); }
+        std::vector<int64_t> column(tile_height);
+        for (size_t x = 0; x < tile_width; ++x)
+        {
+            for (size_t y = 0; y < tile_height; ++y)
+            {
+                // Столбец четверти читается целиком (данные готовых тайлов сжаты).
+                const Fractal::Data& quarter = quarters[2 * x / tile_width][2 * y / tile_height]->get_data();
+                size_t source_column = (2 * x % tile_width) * tile_height;
+                if (y == 0 || y == tile_height / 2) { quarter.iterations.read(source_column, tile_height, column.data()); }
+
+                size_t source = source_column + 2 * y % tile_height;
+                data.iterations.set(x * tile_height + y, column[2 * y % tile_height]);
+                if (settings.smooth) { data.smooth[x * tile_height + y] = quarter.smooth[source]; }
+            }
+        }
+        return std::make_shared<Tile>(std::move(data));
+    }
+
+    std::shared_ptr<Tile> GUI::request_tile(Fractal::Request& request)
+    {
+        // Вычислитель уведомляет о готовности результата и промежуточных результатов через очередь: опрашивать
+        // тайлы не требуется. Тайл передаётся слабой ссылкой, поэтому удалённые тайлы уведомления пропускают.
+        std::shared_ptr<Tile> tile = std::make_shared<Tile>();
+        std::weak_ptr<Tile> target = tile;
+        std::shared_ptr<CompletionQueue<std::weak_ptr<Tile>>> queue = completions;
+        request.notify = [queue, target]() { queue->push(target); };
+        if (request.progress || request.resume)
+        {
+            request.progress = std::make_shared<Fractal::Progress>(request.notify);
+
+            // До завершения продолжаемого расчёта отображается прежний результат.
+            if (request.resume) { request.progress->publish(*request.resume); }
+        }
+
+        tile->start(assigned_fractal->request_calc(request), request.cancelled, request.progress, request.priority_token);
+        return tile;
+    }
+
+    void GUI::receive_tiles()
+    {
+        std::weak_ptr<Tile> target;
+        while (completions->pop(target))
+        {
+            std::shared_ptr<Tile> tile = target.lock();
+            if (tile) { tile->receive(); }
+        }
+    }
+
+    void GUI::draw_tiles(Instrumentation* instrumentation)
+    {
+        // Раскраска и загрузка в атлас ограничены бюджетом на кадр (но хотя бы один тайл за кадр): тайлы, завершённые
+        // одновременно, раскрашиваются в течение нескольких кадров. Первыми раскрашиваются тайлы отображаемого уровня
+        // (они рисуются последними), до раскраски виден прежний результат или замещающие тайлы.
+        const Palette& palette = Palette::presets()[settings.palette];
+        Instrumentation::Clock::time_point frame_started = Instrumentation::Clock::now();
+        size_t uploaded_bytes = 0;
+        size_t uploads = 0;
+        for (size_t i = onscreen_tiles.size(); i-- > 0; )
+        {
+            Tile& tile = *onscreen_tiles[i];
+            if (!tile.outdated(palette)) { continue; }
+
+            Instrumentation::Clock::time_point started = Instrumentation::Clock::now();
+            double elapsed_ms = std::chrono::duration<double, std::milli>(started - frame_started).count();
+            if (uploads > 0 && (elapsed_ms >= settings.upload_budget_ms || uploaded_bytes >= settings.upload_budget_bytes)) { break; }
+
+            tile.recolour(palette, atlas);
+            if (instrumentation) { instrumentation->add_upload(started, Instrumentation::Clock::now()); }
+            uploaded_bytes += 4 * tile_width * tile_height;
+            ++uploads;
+        }
+
+        // Тайлы одного слоя не перекрываются, поэтому внутри слоя порядок рисования не важен: вершины тайлов собираются
+        // по страницам атласа, и каждая страница рисуется одним вызовом. Слои рисуются по порядку.
+        draw_calls = 0;
+        auto flush = [this]()
+        {
+            for (size_t page = 0; page < atlas_vertices.size(); ++page)
+            {
+                if (atlas_vertices[page].getVertexCount() == 0) { continue; }
+                window.draw(atlas_vertices[page], sf::RenderStates(atlas->get_texture(page)));
+                atlas_vertices[page].clear();
+                ++draw_calls;
+            }
+        };
+
+        for (size_t i = 0; i < onscreen_tiles.size(); ++i)
+        {
+            if (i > 0 && onscreen_layers[i] != onscreen_layers[i - 1]) { flush(); }
+
+            const Tile& tile = *onscreen_tiles[i];
+            const TileAtlas::Slot* slot = tile.get_slot();
+            if (!slot) { continue; }
+
+            while (atlas_vertices.size() < atlas->pages_number()) { atlas_vertices.emplace_back(sf::Quads, 0); }
+            tile.append_vertices(atlas_vertices[slot->page]);
+        }
+        flush();
+    }
+
+    void GUI::place_tile(Tile& tile, const TileAddress& address) const
+    {
+        // Спрайт повёрнут так, что его положение - левый нижний угол тайла.
+        mp_bitcnt_t precision = level_precision(address.level);
+        mpf_rectangle rectangle = address.rectangle(precision);
+        mpf_class x((rectangle.bottom_left.x - settings.fractal_scale_origin.x) / settings.fractal_scale_factor, precision);
+        mpf_class y((settings.fractal_scale_origin.y - rectangle.bottom_left.y) / settings.fractal_scale_factor, precision);
+        mpf_class scale((rectangle.top_right.x - rectangle.bottom_left.x) / (settings.fractal_scale_factor * static_cast<unsigned long>(tile_width)), precision);
+
+        tile.setPosition(static_cast<float>(x.get_d()), static_cast<float>(y.get_d()));
+        tile.setScale(static_cast<float>(scale.get_d()), static_cast<float>(scale.get_d()));
+    }
+
+    int64_t GUI::detail_level() const
+    {
+        // Размер пикселя экрана на плоскости - scale_base^(fractal_scale_power + scale_power); размер текселя уровня - 2^-level / tile_width.
+        double log2_pixel = static_cast<double>(settings.fractal_scale_power + settings.scale_power) * std::log2(static_cast<double>(settings.scale_base));
+        return static_cast<int64_t>(std::ceil(-log2_pixel - std::log2(static_cast<double>(tile_width)) - 1.0e-9));
+    }
+
+    mp_bitcnt_t GUI::level_precision(int64_t level) const
+    {
+        // Углы тайла - двоичные дроби с level знаками после запятой; точкам сетки нужен ещё log2(tile_width) бит и запас.
+        mp_bitcnt_t bits = static_cast<mp_bitcnt_t>(std::max<int64_t>(0, level)) + static_cast<mp_bitcnt_t>(std::log2(static_cast<double>(tile_width))) + precision_guard_bits;
+        bits = (bits + mp_bits_per_limb - 1) / mp_bits_per_limb * mp_bits_per_limb;
+        return std::max(settings.precision, bits);
     }
 
     void GUI::rescale_fractal()
@@ -402,6 +1063,10 @@ namespace alfrac
         // TODO: сделвть нормальное возведение в степень (через средства mpf).
         settings.fractal_scale_power += settings.scale_power;
         settings.scale_power = 0;
+
+        // Точность координат определяется глубиной приближения: шаг сетки должен быть различим на фоне координат центра.
+        double zoom_bits = std::max(0.0, -static_cast<double>(settings.fractal_scale_power) * std::log2(static_cast<double>(settings.scale_base)));
+        settings.precision = (static_cast<mp_bitcnt_t>(std::ceil(zoom_bits)) + precision_guard_bits + mp_bits_per_limb - 1) / mp_bits_per_limb * mp_bits_per_limb;
         mpf_class new_factor(pow(settings.scale_base, static_cast<double>(settings.fractal_scale_power)));
         new_factor.set_prec(settings.precision);
 
@@ -412,17 +1077,23 @@ namespace alfrac
 
         settings.fractal_scale_origin = new_origin;
         settings.fractal_scale_factor = new_factor;
+        update_reference();
 
         view.setCenter(0.0f, 0.0f);
         view.setSize(static_cast<sf::Vector2f>(window.getSize()));
         view.setViewport(sf::FloatRect(0.0f, 0.0f, 1.0f, 1.0f));
         window.setView(view);
 
-        onscreen_tiles.clear();
-        tiles.clear();
+        // Тайлы адресуются независимо от центра и масштаба вида и сохраняются; меняется лишь их положение.
         fetch_tiles(getViewBounds(view));
     }
 
+    void GUI::update_reference()
+    {
+        // Орбита считается лениво первым обратившимся к ней вычислителем.
+        reference = std::make_shared<ReferenceOrbit>(settings.fractal_scale_origin, settings.precision, settings.iterations_limit, settings.max_absolute);
+    }
+
     // PRIVATE:
 
 }
@@ -0,0 +1,205 @@
+#include "ImageWriter.hpp"
+#include <cstring>
+#include <cstdlib>
+
+#ifdef ALFRACTAL_PNG
+#include <zlib.h>
+#endif
+
+namespace alfrac
+{
+    namespace
+    {
+        bool has_extension(const std::string& path, const std::string& extension)
+        {
+            return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+        }
+
+
+        ////////  PPMWriter  ////////
+        // Двоичный PPM (P6).
+        class PPMWriter : public ImageWriter
+        {
+        public:
+            PPMWriter(std::FILE* init_file, size_t init_width, size_t init_height)
+                : ImageWriter(init_file, init_width, init_height)
+            {
+                std::fprintf(file, "P6\n%zu %zu\n255\n", width, height);
+            }
+
+            bool write_row(const uint8_t* rgb) override
+            {
+                ++rows_written;
+                return std::fwrite(rgb, 3, width, file) == width;
+            }
+
+            bool finish() override
+            { return rows_written == height && std::fflush(file) == 0; }
+        };
+
+
+        #ifdef ALFRACTAL_PNG
+        ////////  PNGWriter  ////////
+        // PNG (8 бит на канал, без чересстрочности). Строки сжимаются потоково, данные выводятся блоками IDAT
+        // по мере заполнения буфера.
+        class PNGWriter : public ImageWriter
+        {
+        public:
+            PNGWriter(std::FILE* init_file, size_t init_width, size_t init_height)
+                : ImageWriter(init_file, init_width, init_height), row(3 * init_width + 1), output(1 << 16)
+            {
+                std::memset(&stream, 0, sizeof(stream));
+                deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+
+                const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+                std::fwrite(signature, 1, sizeof(signature), file);
+
+                uint8_t header[13] = { };
+                put_uint32(header, static_cast<uint32_t>(width));
+                put_uint32(header + 4, static_cast<uint32_t>(height));
+                header[8] = 8; // Бит на канал.
+                header[9] = 2; // RGB.
+                write_chunk("IHDR", header, sizeof(header));
+            }
+            ~PNGWriter() override
+            {
+                deflateEnd(&stream);
+            }
+
+            bool write_row(const uint8_t* rgb) override
+            {
+                // Каждая строка предваряется типом фильтра (0 - без фильтра).
+                row[0] = 0;
+                std::memcpy(row.data() + 1, rgb, 3 * width);
+                ++rows_written;
+                return compress(row.data(), row.size(), Z_NO_FLUSH);
+            }
+
+            bool finish() override
+            {
+                bool result = rows_written == height && compress(nullptr, 0, Z_FINISH);
+                write_chunk("IEND", nullptr, 0);
+                return result && std::fflush(file) == 0;
+            }
+
+        protected:
+            z_stream stream;
+            std::vector<uint8_t> row;    // Строка с байтом фильтра.
+            std::vector<uint8_t> output; // Буфер сжатых данных.
+
+            static void put_uint32(uint8_t* destination, uint32_t value)
+            {
+                destination[0] = static_cast<uint8_t>(value >> 24);
+                destination[1] = static_cast<uint8_t>(value >> 16);
+                destination[2] = static_cast<uint8_t>(value >> 8);
+                destination[3] = static_cast<uint8_t>(value);
+            }
+
+            void write_chunk(const char* type, const uint8_t* data, size_t size)
+            {
+                uint8_t length[4];
+                put_uint32(length, static_cast<uint32_t>(size));
+                std::fwrite(length, 1, 4, file);
+                std::fwrite(type, 1, 4, file);
+                if (size > 0) { std::fwrite(data, 1, size, file); }
+
+                uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+                if (size > 0) { crc = crc32(crc, data, static_cast<uInt>(size)); }
+                uint8_t checksum[4];
+                put_uint32(checksum, static_cast<uint32_t>(crc));
+                std::fwrite(checksum, 1, 4, file);
+            }
+
+            bool compress(const uint8_t* data, size_t size, int flush)
+            {
+                stream.next_in = const_cast<Bytef*>(data);
+                stream.avail_in = static_cast<uInt>(size);
+                while (true)
+                {
+                    stream.next_out = output.data();
+                    stream.avail_out = static_cast<uInt>(output.size());
+                    int status = deflate(&stream, flush);
+                    if (status == Z_STREAM_ERROR) { return false; }
+
+                    size_t produced = output.size() - stream.avail_out;
+                    if (produced > 0) { write_chunk("IDAT", output.data(), produced); }
+
+                    if (flush == Z_FINISH ? status == Z_STREAM_END : (stream.avail_in == 0 && stream.avail_out != 0))
+                    { return std::ferror(file) == 0; }
+                }
+            }
+        };
+        #endif
+
+        // Запись в открытый файл; png - формат PNG (лишь при сборке с zlib), иначе PPM.
+        std::unique_ptr<ImageWriter> create_writer(std::FILE* file, bool png, size_t width, size_t height)
+        {
+            #ifdef ALFRACTAL_PNG
+            if (png) { return std::unique_ptr<ImageWriter>(new PNGWriter(file, width, height)); }
+            #else
+            (void)png;
+            #endif
+            return std::unique_ptr<ImageWriter>(new PPMWriter(file, width, height));
+        }
+    }
+
+
+    ////////////////   ImageWriter   ///////////////
+    // Построчная запись RGB-изображения в файл.
+    // PUBLIC:
+    ImageWriter::~ImageWriter()
+    {
+        if (file) { std::fclose(file); }
+    }
+
+    std::unique_ptr<ImageWriter> ImageWriter::open(const std::string& path, size_t width, size_t height)
+    {
+        bool png = has_extension(path, ".png");
+        #ifndef ALFRACTAL_PNG
+        if (png) { return nullptr; } // Сборка без zlib: доступен лишь PPM.
+        #endif
+        if (!png && !has_extension(path, ".ppm")) { return nullptr; }
+
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file) { return nullptr; }
+        return create_writer(file, png, width, height);
+    }
+
+    bool ImageWriter::encode(const std::string& format, const uint8_t* rgb, size_t width, size_t height, std::vector<uint8_t>& output)
+    {
+        bool png = format == "png";
+        #ifndef ALFRACTAL_PNG
+        if (png) { return false; }
+        #endif
+        if (!png && format != "ppm") { return false; }
+
+        // Файл в памяти: буфер доступен после закрытия файла (разрушения записи).
+        char* buffer = nullptr;
+        size_t size = 0;
+        std::FILE* file = open_memstream(&buffer, &size);
+        if (!file) { return false; }
+
+        bool written = true;
+        {
+            std::unique_ptr<ImageWriter> writer = create_writer(file, png, width, height);
+            for (size_t row = 0; row < height && written; ++row)
+            { written = writer->write_row(rgb + 3 * width * row); }
+            written = written && writer->finish();
+        }
+        if (written) { output.assign(buffer, buffer + size); }
+        std::free(buffer);
+        return written;
+    }
+
+    size_t ImageWriter::get_width() const
+    { return width; }
+    size_t ImageWriter::get_height() const
+    { return height; }
+
+    // PROTECTED:
+    ImageWriter::ImageWriter(std::FILE* init_file, size_t init_width, size_t init_height)
+        : file{init_file}, width{init_width}, height{init_height}
+    { }
+
+    // PRIVATE:
+}
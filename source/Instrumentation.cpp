@@ -0,0 +1,125 @@
+#include "Instrumentation.hpp"
+#include <cstdio>
+
+namespace alfrac
+{
+    namespace
+    {
+        // Наибольшее число событий трассировки (около 40 МиБ); более поздние события отбрасываются.
+        const size_t max_events = 1u << 20;
+
+        uint64_t nanoseconds(Instrumentation::Clock::duration duration)
+        { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()); }
+    }
+
+
+    ////////////////  Instrumentation  ///////////////
+    // Счётчики и трассировка конвейера обсчёта.
+    // PUBLIC:
+    Instrumentation::Instrumentation() : origin{Clock::now()} { }
+    Instrumentation::~Instrumentation() { }
+
+    void Instrumentation::add_task(Clock::time_point submitted, Clock::time_point started, Clock::time_point finished, uint64_t task_iterations)
+    {
+        tasks.fetch_add(1, std::memory_order_relaxed);
+        queue_wait_ns.fetch_add(nanoseconds(started - submitted), std::memory_order_relaxed);
+        compute_ns.fetch_add(nanoseconds(finished - started), std::memory_order_relaxed);
+        limit_equivalent_iterations.fetch_add(task_iterations, std::memory_order_relaxed);
+
+        if (is_tracing())
+        {
+            _record("queue", 'A', submitted, started, 0); // Ожидания разных запросов перекрываются: асинхронные отрезки.
+            _record("compute", 'X', started, finished, static_cast<int64_t>(task_iterations));
+        }
+    }
+
+    void Instrumentation::add_upload(Clock::time_point started, Clock::time_point finished)
+    {
+        uploads.fetch_add(1, std::memory_order_relaxed);
+        upload_ns.fetch_add(nanoseconds(finished - started), std::memory_order_relaxed);
+
+        if (is_tracing()) { _record("upload", 'X', started, finished, 0); }
+    }
+
+    void Instrumentation::add_queue_length(int64_t length)
+    {
+        if (is_tracing())
+        {
+            Clock::time_point now = Clock::now();
+            _record("queue length", 'C', now, now, length);
+        }
+    }
+
+    Instrumentation::Snapshot Instrumentation::get_snapshot() const
+    {
+        Snapshot snapshot;
+        snapshot.tasks         = tasks.load(std::memory_order_relaxed);
+        snapshot.queue_wait_ns = queue_wait_ns.load(std::memory_order_relaxed);
+        snapshot.compute_ns    = compute_ns.load(std::memory_order_relaxed);
+        snapshot.limit_equivalent_iterations = limit_equivalent_iterations.load(std::memory_order_relaxed);
+        snapshot.uploads       = uploads.load(std::memory_order_relaxed);
+        snapshot.upload_ns     = upload_ns.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    void Instrumentation::set_tracing(bool enabled)
+    { tracing.store(enabled, std::memory_order_relaxed); }
+    bool Instrumentation::is_tracing() const
+    { return tracing.load(std::memory_order_relaxed); }
+
+    bool Instrumentation::export_trace(const std::string& path)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "w");
+        if (!file) { return false; }
+
+        std::lock_guard<std::mutex> lock_events(mutex_events);
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        std::fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"AlFractal\"}}");
+
+        for (const auto& thread : threads)
+        { std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}}", thread.second, thread.second); }
+
+        // Время событий - в микросекундах.
+        for (size_t index = 0; index < events.size(); ++index)
+        {
+            const Event& event = events[index];
+            double start = 1e-3 * static_cast<double>(event.start_ns);
+            if (event.phase == 'A')
+            {
+                double finish = 1e-3 * static_cast<double>(event.start_ns + event.duration_ns);
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"alfractal\",\"ph\":\"b\",\"id\":%zu,\"pid\":1,\"tid\":%u,\"ts\":%.3f}", event.name, index, event.thread, start);
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"alfractal\",\"ph\":\"e\",\"id\":%zu,\"pid\":1,\"tid\":%u,\"ts\":%.3f}", event.name, index, event.thread, finish);
+            }
+            else if (event.phase == 'C')
+            {
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"value\":%" PRId64 "}}",
+                             event.name, event.thread, start, event.value);
+            }
+            else
+            {
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"alfractal\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"limit_equivalent_iterations\":%" PRId64 "}}",
+                             event.name, event.thread, start, 1e-3 * static_cast<double>(event.duration_ns), event.value);
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+
+        bool result = std::ferror(file) == 0;
+        return std::fclose(file) == 0 && result;
+    }
+
+    // PROTECTED:
+    void Instrumentation::_record(const char* name, char phase, Clock::time_point start, Clock::time_point finish, int64_t value)
+    {
+        std::lock_guard<std::mutex> lock_events(mutex_events);
+        if (events.size() >= max_events) { return; }
+
+        // Потоки нумеруются в порядке первого события.
+        auto thread = threads.emplace(std::this_thread::get_id(), static_cast<uint32_t>(threads.size() + 1)).first;
+        events.push_back(Event{ name, phase, thread->second, _since_origin(start), nanoseconds(finish - start), value });
+    }
+
+    uint64_t Instrumentation::_since_origin(Clock::time_point time) const
+    { return time > origin ? nanoseconds(time - origin) : 0; }
+
+    // PRIVATE:
+}
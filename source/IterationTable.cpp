@@ -0,0 +1,337 @@
+#include "IterationTable.hpp"
+#include "Wire.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace alfrac
+{
+    namespace
+    {
+        template <class Value>
+        inline int64_t load(const uint8_t* bytes, size_t index)
+        {
+            Value value;
+            std::memcpy(&value, bytes + index * sizeof(Value), sizeof(Value));
+            return static_cast<int64_t>(value);
+        }
+
+        template <class Value>
+        inline void store(uint8_t* bytes, size_t index, int64_t value)
+        {
+            Value narrow = static_cast<Value>(value);
+            std::memcpy(bytes + index * sizeof(Value), &narrow, sizeof(Value));
+        }
+
+        template <class Value>
+        void load_span(const uint8_t* bytes, size_t first, size_t count, int64_t* output)
+        {
+            for (size_t i = 0; i < count; ++i)
+            { output[i] = load<Value>(bytes, first + i); }
+        }
+
+        template <class Value>
+        void store_span(uint8_t* bytes, size_t first, size_t count, const int64_t* input)
+        {
+            for (size_t i = 0; i < count; ++i)
+            { store<Value>(bytes, first + i, input[i]); }
+        }
+
+        // Чтение и запись значений ширины width байт.
+        void load_values(const uint8_t* bytes, uint32_t width, size_t first, size_t count, int64_t* output)
+        {
+            switch (width)
+            {
+                case 1:  { load_span<uint8_t>(bytes, first, count, output); break; }
+                case 2:  { load_span<uint16_t>(bytes, first, count, output); break; }
+                case 4:  { load_span<uint32_t>(bytes, first, count, output); break; }
+                default: { load_span<int64_t>(bytes, first, count, output); break; }
+            }
+        }
+
+        void store_values(uint8_t* bytes, uint32_t width, size_t first, size_t count, const int64_t* input)
+        {
+            switch (width)
+            {
+                case 1:  { store_span<uint8_t>(bytes, first, count, input); break; }
+                case 2:  { store_span<uint16_t>(bytes, first, count, input); break; }
+                case 4:  { store_span<uint32_t>(bytes, first, count, input); break; }
+                default: { store_span<int64_t>(bytes, first, count, input); break; }
+            }
+        }
+
+        // Целые переменной длины: по 7 бит в байте, старший бит - признак продолжения.
+        void put_varint(std::vector<uint8_t>& output, uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                output.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            output.push_back(static_cast<uint8_t>(value));
+        }
+
+        uint64_t get_varint(const uint8_t*& input)
+        {
+            uint64_t value = 0;
+            for (unsigned shift = 0; ; shift += 7)
+            {
+                uint8_t byte = *input++;
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) { return value; }
+            }
+        }
+
+        // Чтение с проверкой границ (для данных, полученных извне).
+        bool get_varint_checked(const uint8_t*& input, const uint8_t* end, uint64_t& value)
+        {
+            value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7)
+            {
+                if (input == end) { return false; }
+                uint8_t byte = *input++;
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) { return true; }
+            }
+            return false;
+        }
+
+        // Отображение разностей со знаком в беззнаковые числа (малые по модулю - в малые).
+        inline uint64_t zigzag(int64_t value)
+        { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+        inline int64_t unzigzag(uint64_t value)
+        { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+    }
+
+
+    //////////////// IterationTable  ///////////////
+    // Таблица чисел итераций точек сетки.
+    // PUBLIC:
+    IterationTable::IterationTable() { }
+    IterationTable::IterationTable(size_t init_size, int64_t iterations_limit)
+        : count{init_size}, value_width{width(iterations_limit)}, bytes(init_size * value_width, 0)
+    { }
+
+    size_t IterationTable::size() const
+    { return count; }
+    bool IterationTable::empty() const
+    { return count == 0; }
+    uint32_t IterationTable::width() const
+    { return value_width; }
+
+    uint32_t IterationTable::width(int64_t iterations_limit)
+    {
+        if (iterations_limit <= UINT8_MAX)  { return 1; }
+        if (iterations_limit <= UINT16_MAX) { return 2; }
+        if (iterations_limit <= UINT32_MAX) { return 4; }
+        return 8;
+    }
+
+    int64_t IterationTable::get(size_t index) const
+    {
+        if (compressed())
+        {
+            int64_t block[block_size];
+            _read_block(index / block_size, block);
+            return block[index % block_size];
+        }
+
+        int64_t value;
+        load_values(bytes.data(), value_width, index, 1, &value);
+        return value;
+    }
+
+    void IterationTable::set(size_t index, int64_t value)
+    {
+        if (compressed()) { decompress(); }
+        store_values(bytes.data(), value_width, index, 1, &value);
+    }
+
+    void IterationTable::read(size_t first, size_t read_count, int64_t* output) const
+    {
+        if (!compressed())
+        {
+            load_values(bytes.data(), value_width, first, read_count, output);
+            return;
+        }
+
+        int64_t block[block_size];
+        size_t end = first + read_count;
+        for (size_t position = first; position < end; )
+        {
+            size_t block_index = position / block_size;
+            size_t offset = position % block_size;
+            size_t taken = std::min(block_size - offset, end - position);
+            _read_block(block_index, block);
+            std::copy(block + offset, block + offset + taken, output + (position - first));
+            position += taken;
+        }
+    }
+
+    const uint8_t* IterationTable::raw() const
+    { return compressed() ? nullptr : bytes.data(); }
+    uint8_t* IterationTable::raw()
+    { return compressed() ? nullptr : bytes.data(); }
+
+    void IterationTable::compress()
+    {
+        if (compressed() || count == 0) { return; }
+
+        std::vector<uint8_t> encoded;
+        std::vector<uint32_t> offsets;
+        int64_t block[block_size];
+        for (size_t first = 0; first < count; first += block_size)
+        {
+            offsets.push_back(static_cast<uint32_t>(encoded.size()));
+            size_t block_count = std::min(block_size, count - first);
+            load_values(bytes.data(), value_width, first, block_count, block);
+
+            int64_t previous = 0;
+            for (size_t i = 0; i < block_count; )
+            {
+                size_t run = 1;
+                while (i + run < block_count && block[i + run] == block[i]) { ++run; }
+                put_varint(encoded, run);
+                put_varint(encoded, zigzag(block[i] - previous));
+                previous = block[i];
+                i += run;
+            }
+
+            // Несжимаемая таблица остаётся несжатой.
+            if (encoded.size() >= bytes.size()) { return; }
+        }
+        offsets.push_back(static_cast<uint32_t>(encoded.size()));
+
+        encoded.shrink_to_fit();
+        bytes = std::move(encoded);
+        blocks = std::move(offsets);
+    }
+
+    void IterationTable::decompress()
+    {
+        if (!compressed()) { return; }
+
+        std::vector<uint8_t> decoded(count * value_width);
+        int64_t block[block_size];
+        for (size_t block_index = 0; block_index + 1 < blocks.size(); ++block_index)
+        {
+            size_t first = block_index * block_size;
+            _read_block(block_index, block);
+            store_values(decoded.data(), value_width, first, std::min(block_size, count - first), block);
+        }
+
+        bytes = std::move(decoded);
+        blocks.clear();
+        blocks.shrink_to_fit();
+    }
+
+    bool IterationTable::compressed() const
+    { return !blocks.empty(); }
+
+    size_t IterationTable::memory_usage() const
+    { return sizeof(IterationTable) + bytes.capacity() + blocks.capacity() * sizeof(uint32_t); }
+
+    void IterationTable::save(wire::Writer& writer) const
+    {
+        writer.put_u64(count);
+        writer.put_u32(value_width);
+        writer.put_u8(compressed() ? 1 : 0);
+        if (compressed())
+        {
+            writer.put_u64(blocks.size());
+            for (uint32_t offset : blocks) { writer.put_u32(offset); }
+            writer.put_u64(bytes.size());
+            writer.put_bytes(bytes.data(), bytes.size());
+            return;
+        }
+
+        int64_t block[block_size];
+        for (size_t first = 0; first < count; first += block_size)
+        {
+            size_t block_count = std::min(block_size, count - first);
+            load_values(bytes.data(), value_width, first, block_count, block);
+            for (size_t i = 0; i < block_count; ++i)
+            {
+                for (uint32_t byte = 0; byte < value_width; ++byte) { writer.put_u8(static_cast<uint8_t>(static_cast<uint64_t>(block[i]) >> (8 * byte))); }
+            }
+        }
+    }
+
+    bool IterationTable::load(wire::Reader& reader)
+    {
+        *this = IterationTable();
+        size_t new_count = reader.get_u64();
+        uint32_t new_width = reader.get_u32();
+        bool is_compressed = reader.get_u8() != 0;
+        if (new_width != 1 && new_width != 2 && new_width != 4 && new_width != 8) { reader.fail(); }
+        if (reader.failed()) { return false; }
+
+        IterationTable result;
+        result.count = new_count;
+        result.value_width = new_width;
+        if (is_compressed)
+        {
+            size_t blocks_number = reader.get_count(sizeof(uint32_t));
+            if (blocks_number != (new_count + block_size - 1) / block_size + 1) { reader.fail(); return false; }
+            result.blocks.resize(blocks_number);
+            for (uint32_t& offset : result.blocks) { offset = reader.get_u32(); }
+            result.bytes.resize(reader.get_count(1));
+            reader.get_bytes(result.bytes.data(), result.bytes.size());
+            if (reader.failed() || result.blocks.front() != 0 || result.blocks.back() != result.bytes.size()) { reader.fail(); return false; }
+            for (size_t block = 0; block + 1 < blocks_number; ++block)
+            {
+                if (!result._check_block(block)) { reader.fail(); return false; }
+            }
+        }
+        else
+        {
+            if (new_count > reader.remaining() / new_width) { reader.fail(); return false; }
+            result.bytes.resize(new_count * new_width);
+            for (size_t index = 0; index < new_count; ++index)
+            {
+                uint64_t value = 0;
+                for (uint32_t byte = 0; byte < new_width; ++byte) { value |= static_cast<uint64_t>(reader.get_u8()) << (8 * byte); }
+                store_values(result.bytes.data(), new_width, index, 1, reinterpret_cast<const int64_t*>(&value));
+            }
+        }
+        if (reader.failed()) { return false; }
+
+        *this = std::move(result);
+        return true;
+    }
+
+    // PROTECTED:
+    void IterationTable::_read_block(size_t block, int64_t* output) const
+    {
+        const uint8_t* input = bytes.data() + blocks[block];
+        const uint8_t* end   = bytes.data() + blocks[block + 1];
+        int64_t previous = 0;
+        size_t position = 0;
+        while (input < end)
+        {
+            size_t run = static_cast<size_t>(get_varint(input));
+            previous += unzigzag(get_varint(input));
+            std::fill(output + position, output + position + run, previous);
+            position += run;
+        }
+    }
+
+    bool IterationTable::_check_block(size_t block) const
+    {
+        // Смещения должны возрастать, а длины серий - в сумме давать число точек блока.
+        if (blocks[block] > blocks[block + 1] || blocks[block + 1] > bytes.size()) { return false; }
+        const uint8_t* input = bytes.data() + blocks[block];
+        const uint8_t* end   = bytes.data() + blocks[block + 1];
+        size_t expected = std::min(block_size, count - block * block_size);
+        size_t position = 0;
+        while (input < end)
+        {
+            uint64_t run, delta;
+            if (!get_varint_checked(input, end, run) || !get_varint_checked(input, end, delta)) { return false; }
+            if (run == 0 || run > expected - position) { return false; }
+            position += static_cast<size_t>(run);
+        }
+        return position == expected;
+    }
+
+    // PRIVATE:
+}
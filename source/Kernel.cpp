@@ -0,0 +1,413 @@
+#include "Kernel.hpp"
+#include "Perturbation.hpp"
+#include "Vectorized.hpp"
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace alfrac
+{
+    namespace kernel
+    {
+        namespace
+        {
+            ////////  MpfRegisters  ////////
+            // Набор рабочих регистров длинной арифметики.
+            // Регистры принадлежат потоку-вычислителю и переиспользуются между запросами, так что во внутреннем
+            // цикле не происходит выделения памяти: память перераспределяется лишь при смене точности.
+            struct MpfRegisters
+            {
+                mpf_t left, bottom, step_x, step_y; // Параметры сетки.
+                mpf_t constant_x, constant_y;       // Параметр текущей точки.
+                mpf_t var_x, var_y;                 // Текущее значение орбиты.
+                mpf_t saved_x, saved_y;             // Запомненное значение орбиты (для поиска цикла).
+                mpf_t sqr_x, sqr_y, product;        // Промежуточные значения.
+                mp_bitcnt_t precision = 0;
+
+                MpfRegisters()
+                {
+                    for (mpf_ptr value : all())
+                    { mpf_init(value); }
+                }
+                ~MpfRegisters()
+                {
+                    for (mpf_ptr value : all())
+                    { mpf_clear(value); }
+                }
+
+                void set_prec(mp_bitcnt_t new_precision)
+                {
+                    if (new_precision == precision) { return; }
+                    precision = new_precision;
+                    for (mpf_ptr value : all())
+                    { mpf_set_prec(value, precision); }
+                }
+
+                std::array<mpf_ptr, 13> all()
+                { return { left, bottom, step_x, step_y, constant_x, constant_y, var_x, var_y, saved_x, saved_y, sqr_x, sqr_y, product }; }
+            };
+            thread_local MpfRegisters mpf_registers;
+        }
+
+
+        ////////////////   Vectorized    ///////////////
+        Vectorized::Vectorized(const Fractal::Request& request)
+            : iterations_limit{request.iterations_limit}, constant_x(request.grid_y), constant_y(request.grid_y)
+        {
+            const mpf_rectangle& rectangle = request.rectangle;
+
+            left   = rectangle.bottom_left.x.get_d();
+            bottom = rectangle.bottom_left.y.get_d();
+            step_x = mpf_class((rectangle.top_right.x - rectangle.bottom_left.x) / static_cast<unsigned long>(request.grid_x)).get_d();
+            step_y = mpf_class((rectangle.top_right.y - rectangle.bottom_left.y) / static_cast<unsigned long>(request.grid_y)).get_d();
+
+            double max_absolute = request.max_absolute.get_d();
+            sqr_max_absolute = max_absolute * max_absolute;
+            log_sqr_max_absolute = std::log(sqr_max_absolute);
+            sqr_period_tolerance = std::ldexp(1.0, -2 * (std::numeric_limits<double>::digits - period_guard_bits));
+
+            indices.resize(request.grid_y);
+            values.resize(request.grid_y);
+            escape.resize(request.grid_y);
+            var_x.resize(request.grid_y);
+            var_y.resize(request.grid_y);
+            saved_x.resize(request.grid_y);
+            saved_y.resize(request.grid_y);
+            alive.resize(request.grid_y);
+        }
+
+        void Vectorized::column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states, float* smooth)
+        {
+            // Точки кардиоиды и круга периода 2 не итерируются; остальные уплотняются для векторного ядра.
+            // Продолжаемые точки проверку уже прошли.
+            bool resumed = states && states->input;
+            double column_x = left + step_x * static_cast<double>(x);
+            size_t remaining = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                double point_y = bottom + step_y * static_cast<double>(ys[i]);
+                if (!resumed && is_interior(column_x, point_y))
+                {
+                    iterations[i] = iterations_limit;
+                    if (smooth) { smooth[i] = static_cast<float>(iterations_limit); }
+                    if (states && states->alive) { states->alive[i] = false; }
+                    continue;
+                }
+                constant_x[remaining] = column_x;
+                constant_y[remaining] = point_y;
+                indices[remaining] = i;
+                if (states)
+                {
+                    const Value* state = resumed ? states->input + i * state_size : nullptr;
+                    var_x[remaining]   = state ? state[0] : 0.0;
+                    var_y[remaining]   = state ? state[1] : 0.0;
+                    saved_x[remaining] = state ? state[2] : 0.0;
+                    saved_y[remaining] = state ? state[3] : 0.0;
+                }
+                ++remaining;
+            }
+
+            vectorized::State state{ var_x.data(), var_y.data(), saved_x.data(), saved_y.data(), alive.data() };
+            vectorized::escape_time(vectorized::detect(), constant_x.data(), constant_y.data(), remaining, resumed ? states->first_step : 0,
+                                    iterations_limit, sqr_max_absolute, sqr_period_tolerance, states ? &state : nullptr, values.data(),
+                                    smooth ? escape.data() : nullptr);
+            for (size_t i = 0; i < remaining; ++i)
+            { iterations[indices[i]] = values[i]; }
+            if (smooth)
+            {
+                for (size_t i = 0; i < remaining; ++i)
+                {
+                    smooth[indices[i]] = values[i] < iterations_limit ? smooth_iterations(values[i], escape[i], log_sqr_max_absolute)
+                                                                       : static_cast<float>(iterations_limit);
+                }
+            }
+            if (!states) { return; }
+
+            for (size_t i = 0; i < remaining; ++i)
+            {
+                size_t point = indices[i];
+                if (states->alive) { states->alive[point] = alive[i]; }
+                if (alive[i] && states->output)
+                {
+                    Value* output = states->output + point * state_size;
+                    output[0] = var_x[i];
+                    output[1] = var_y[i];
+                    output[2] = saved_x[i];
+                    output[3] = saved_y[i];
+                }
+            }
+        }
+
+
+        ////////////////  Perturbation   ///////////////
+        Perturbation::Perturbation(const Fractal::Request& request)
+            : iterations_limit{request.iterations_limit},
+              orbit_x(request.reference->get_orbit_x()), orbit_y(request.reference->get_orbit_y()), last{orbit_x.size() - 1}
+        {
+            const ReferenceOrbit& reference = *request.reference;
+
+            // Отклонение левого нижнего угла от опорной точки и шаг сетки.
+            const mpf_rectangle& rectangle = request.rectangle;
+            mp_bitcnt_t precision = std::max(reference.get_precision(), rectangle.bottom_left.x.get_prec());
+            offset_x = mpf_class(rectangle.bottom_left.x - reference.get_center().x, precision).get_d();
+            offset_y = mpf_class(rectangle.bottom_left.y - reference.get_center().y, precision).get_d();
+            center_x = reference.get_center().x.get_d();
+            center_y = reference.get_center().y.get_d();
+            step_x = mpf_class((rectangle.top_right.x - rectangle.bottom_left.x) / static_cast<unsigned long>(request.grid_x)).get_d();
+            step_y = mpf_class((rectangle.top_right.y - rectangle.bottom_left.y) / static_cast<unsigned long>(request.grid_y)).get_d();
+
+            double max_absolute = request.max_absolute.get_d();
+            sqr_max_absolute = max_absolute * max_absolute;
+            log_sqr_max_absolute = std::log(sqr_max_absolute);
+
+            // Отклонения различают точки на масштабе шага сетки, поэтому порог поиска цикла определяется точностью,
+            // требуемой сеткой. Разность орбит вычисляется в double, поэтому порог не меньше разрешения double
+            // на масштабе слагаемых разности (см. column()). Сравнение ведётся покомпонентно: квадрат порога
+            // глубже 2^-540 не представим в double.
+            int bits = static_cast<int>(Fractal::required_precision(request));
+            period_tolerance = std::ldexp(1.0, -(bits - period_guard_bits));
+            period_relative_tolerance = std::ldexp(1.0, -(std::numeric_limits<double>::digits - period_guard_bits));
+        }
+
+        void Perturbation::column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states, float* smooth)
+        {
+            double delta_constant_x = offset_x + step_x * static_cast<double>(x);
+            bool resumed = states && states->input;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                // Отклонение параметра от опорной точки.
+                double delta_constant_y = offset_y + step_y * static_cast<double>(ys[i]);
+                if (!resumed && is_interior(center_x + delta_constant_x, center_y + delta_constant_y))
+                {
+                    iterations[i] = iterations_limit;
+                    if (smooth) { smooth[i] = static_cast<float>(iterations_limit); }
+                    if (states && states->alive) { states->alive[i] = false; }
+                    continue;
+                }
+
+                // Отклонение орбиты точки от опорной орбиты и текущий индекс в опорной орбите.
+                double delta_x = 0.0;
+                double delta_y = 0.0;
+                size_t index = 0;
+
+                // Запомненное значение орбиты в том же представлении (индекс опорной орбиты и отклонение).
+                double saved_delta_x = 0.0;
+                double saved_delta_y = 0.0;
+                size_t saved_index = 0;
+
+                if (resumed)
+                {
+                    const Value* state = states->input + i * state_size;
+                    delta_x       = state[0];
+                    delta_y       = state[1];
+                    index         = static_cast<size_t>(state[2]);
+                    saved_delta_x = state[3];
+                    saved_delta_y = state[4];
+                    saved_index   = static_cast<size_t>(state[5]);
+                }
+
+                bool alive = true;
+                int64_t step = resumed ? states->first_step : 0;
+                for (; step < iterations_limit; ++step)
+                {
+                    // Опорная орбита закончилась: отклонение переносится на её начало (Z_0 = 0).
+                    if (index == last)
+                    {
+                        delta_x += orbit_x[index];
+                        delta_y += orbit_y[index];
+                        index = 0;
+                    }
+
+                    // d_{n+1} = 2 Z_n d_n + d_n^2 + dc.
+                    double reference_x = orbit_x[index];
+                    double reference_y = orbit_y[index];
+                    double new_delta_x = 2.0 * (reference_x * delta_x - reference_y * delta_y) + (delta_x * delta_x - delta_y * delta_y) + delta_constant_x;
+                    double new_delta_y = 2.0 * (reference_x * delta_y + reference_y * delta_x) + 2.0 * delta_x * delta_y + delta_constant_y;
+                    delta_x = new_delta_x;
+                    delta_y = new_delta_y;
+                    ++index;
+
+                    // Полное значение z_{n+1} = Z_{n+1} + d_{n+1}.
+                    double var_x = orbit_x[index] + delta_x;
+                    double var_y = orbit_y[index] + delta_y;
+                    double sqr_absolute = var_x * var_x + var_y * var_y;
+                    if (sqr_absolute > sqr_max_absolute)
+                    {
+                        if (smooth) { smooth[i] = smooth_iterations(step, sqr_absolute, log_sqr_max_absolute); }
+                        alive = false;
+                        break;
+                    }
+
+                    // Обнаружение сбоя (glitch): точка оказалась ближе к нулю, чем к опорной орбите,
+                    // и отклонение теряет точность. Опора переносится на начало орбиты.
+                    if (sqr_absolute < delta_x * delta_x + delta_y * delta_y)
+                    {
+                        delta_x = var_x;
+                        delta_y = var_y;
+                        index = 0;
+                    }
+
+                    // Разность с запомненным значением. Когда опорная орбита сошлась к циклу, значения опорной
+                    // орбиты одной фазы совпадают в double, и разность определяется отклонениями без потери точности
+                    // (её разрешение - точность double на масштабе отклонения). Иначе разрешение разности - точность
+                    // double на масштабе значения орбиты.
+                    double difference_x = (orbit_x[index] - orbit_x[saved_index]) + (delta_x - saved_delta_x);
+                    double difference_y = (orbit_y[index] - orbit_y[saved_index]) + (delta_y - saved_delta_y);
+                    bool same_phase = orbit_x[index] == orbit_x[saved_index] && orbit_y[index] == orbit_y[saved_index];
+                    double scale = same_phase ? std::max(std::fabs(delta_x), std::fabs(delta_y)) : std::max(std::fabs(var_x), std::fabs(var_y));
+                    double tolerance = std::max(period_tolerance, period_relative_tolerance * scale);
+                    if (std::fabs(difference_x) <= tolerance && std::fabs(difference_y) <= tolerance) { step = iterations_limit; alive = false; break; }
+                    if (is_save_step(step))
+                    {
+                        saved_delta_x = delta_x;
+                        saved_delta_y = delta_y;
+                        saved_index = index;
+                    }
+                }
+                iterations[i] = step;
+                if (smooth && step == iterations_limit) { smooth[i] = static_cast<float>(iterations_limit); }
+
+                if (states && states->alive) { states->alive[i] = alive; }
+                if (alive && states && states->output)
+                {
+                    Value* state = states->output + i * state_size;
+                    state[0] = delta_x;
+                    state[1] = delta_y;
+                    state[2] = static_cast<double>(index);
+                    state[3] = saved_delta_x;
+                    state[4] = saved_delta_y;
+                    state[5] = static_cast<double>(saved_index);
+                }
+            }
+        }
+
+
+        ////////////////       Mpf       ///////////////
+        Mpf::Mpf(const Fractal::Request& request, mp_bitcnt_t init_precision)
+            : iterations_limit{request.iterations_limit}, precision{init_precision}
+        {
+            MpfRegisters& registers = mpf_registers;
+            registers.set_prec(precision);
+
+            // Левый нижний угол и шаг сетки.
+            const mpf_rectangle& rectangle = request.rectangle;
+            mpf_set(registers.left, rectangle.bottom_left.x.get_mpf_t());
+            mpf_set(registers.bottom, rectangle.bottom_left.y.get_mpf_t());
+            mpf_sub(registers.step_x, rectangle.top_right.x.get_mpf_t(), rectangle.bottom_left.x.get_mpf_t());
+            mpf_div_ui(registers.step_x, registers.step_x, static_cast<unsigned long>(request.grid_x));
+            mpf_sub(registers.step_y, rectangle.top_right.y.get_mpf_t(), rectangle.bottom_left.y.get_mpf_t());
+            mpf_div_ui(registers.step_y, registers.step_y, static_cast<unsigned long>(request.grid_y));
+
+            // Проверка выхода за пределы круга ведётся в double: значения вблизи границы круга представимы в нём
+            // с избытком, а лишние биты длинной арифметики на результат сравнения не влияют.
+            double max_absolute = request.max_absolute.get_d();
+            sqr_max_absolute = max_absolute * max_absolute;
+            log_sqr_max_absolute = std::log(sqr_max_absolute);
+            period_exponent = -static_cast<int64_t>(precision) + period_guard_bits;
+        }
+
+        void Mpf::column(size_t x, const size_t* ys, size_t count, int64_t* iterations, States<Value>* states, float* smooth)
+        {
+            MpfRegisters& registers = mpf_registers;
+            bool resumed = states && states->input;
+
+            mpf_mul_ui(registers.constant_x, registers.step_x, static_cast<unsigned long>(x));
+            mpf_add(registers.constant_x, registers.constant_x, registers.left);
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                mpf_mul_ui(registers.constant_y, registers.step_y, static_cast<unsigned long>(ys[i]));
+                mpf_add(registers.constant_y, registers.constant_y, registers.bottom);
+                if (!resumed && is_interior(mpf_get_d(registers.constant_x), mpf_get_d(registers.constant_y)))
+                {
+                    iterations[i] = iterations_limit;
+                    if (smooth) { smooth[i] = static_cast<float>(iterations_limit); }
+                    if (states && states->alive) { states->alive[i] = false; }
+                    continue;
+                }
+
+                if (resumed)
+                {
+                    const Value* state = states->input + i * state_size;
+                    mpf_set(registers.var_x, state[0].get_mpf_t());
+                    mpf_set(registers.var_y, state[1].get_mpf_t());
+                    mpf_set(registers.saved_x, state[2].get_mpf_t());
+                    mpf_set(registers.saved_y, state[3].get_mpf_t());
+                }
+                else
+                {
+                    mpf_set_ui(registers.var_x, 0);
+                    mpf_set_ui(registers.var_y, 0);
+                    mpf_set_ui(registers.saved_x, 0);
+                    mpf_set_ui(registers.saved_y, 0);
+                }
+
+                bool alive = true;
+                int64_t step = resumed ? states->first_step : 0;
+                for (; step < iterations_limit; ++step)
+                {
+                    // z = z^2 + c без создания временных объектов.
+                    mpf_mul(registers.sqr_x, registers.var_x, registers.var_x);
+                    mpf_mul(registers.sqr_y, registers.var_y, registers.var_y);
+                    mpf_mul(registers.product, registers.var_x, registers.var_y);
+                    mpf_sub(registers.var_x, registers.sqr_x, registers.sqr_y);
+                    mpf_add(registers.var_x, registers.var_x, registers.constant_x);
+                    mpf_mul_2exp(registers.var_y, registers.product, 1);
+                    mpf_add(registers.var_y, registers.var_y, registers.constant_y);
+
+                    double var_x = mpf_get_d(registers.var_x);
+                    double var_y = mpf_get_d(registers.var_y);
+
+                    #ifdef DEBUG_STEPS_OUTPUT
+                    std::cout << step << ": " << var_x << " " << var_y << '\n';
+                    #endif
+
+                    double sqr_absolute = var_x * var_x + var_y * var_y;
+                    if (sqr_absolute > sqr_max_absolute)
+                    {
+                        if (smooth) { smooth[i] = smooth_iterations(step, sqr_absolute, log_sqr_max_absolute); }
+                        alive = false;
+                        break;
+                    }
+
+                    // Разность с запомненным значением оценивается по порядку (sqr_x и sqr_y свободны до следующего шага).
+                    mpf_sub(registers.sqr_x, registers.var_x, registers.saved_x);
+                    mpf_sub(registers.sqr_y, registers.var_y, registers.saved_y);
+                    if (_is_small(registers.sqr_x) && _is_small(registers.sqr_y)) { step = iterations_limit; alive = false; break; }
+                    if (is_save_step(step))
+                    {
+                        mpf_set(registers.saved_x, registers.var_x);
+                        mpf_set(registers.saved_y, registers.var_y);
+                    }
+                }
+                iterations[i] = step;
+                if (smooth && step == iterations_limit) { smooth[i] = static_cast<float>(iterations_limit); }
+
+                if (states && states->alive) { states->alive[i] = alive; }
+                if (alive && states && states->output)
+                {
+                    // Значения состояния получают точность ядра (буфер мог быть создан с точностью по умолчанию).
+                    Value* state = states->output + i * state_size;
+                    mpf_srcptr sources[state_size] = { registers.var_x, registers.var_y, registers.saved_x, registers.saved_y };
+                    for (size_t index = 0; index < state_size; ++index)
+                    {
+                        if (state[index].get_prec() != precision) { state[index].set_prec(precision); }
+                        mpf_set(state[index].get_mpf_t(), sources[index]);
+                    }
+                }
+            }
+        }
+
+        // PROTECTED:
+        bool Mpf::_is_small(mpf_srcptr value) const
+        {
+            if (mpf_sgn(value) == 0) { return true; }
+
+            long exponent = 0;
+            mpf_get_d_2exp(&exponent, value);
+            return exponent <= period_exponent;
+        }
+    }
+}
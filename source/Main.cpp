@@ -1,24 +1,81 @@
 ﻿#include <iostream>
 #include <vector>
+#include <string>
 #include <cinttypes>
 #include <gmpxx.h>
 #include "GUI.hpp"
+#include "TileStore.hpp"
+#include "Distributed.hpp"
+#include "Instrumentation.hpp"
+#include "Arguments.hpp"
+
+namespace
+{
+    const char* usage =
+        "Использование: AlFractal [-j N] [--tile-cache МиБ] [--upload-budget МС] [--upload-bytes КиБ] [--tile-store ДИРЕКТОРИЯ]\n"
+        "                         [--remote АДРЕСА] [--trace ФАЙЛ]\n";
+}
 
 int main(int argc, char* argv[])
 {
-    std::shared_ptr<alfrac::Fractal> fractal = std::make_shared<alfrac::Fractal>();
-    std::thread thread_fractal1(&alfrac::Fractal::loop, fractal.get());
-    std::thread thread_fractal2(&alfrac::Fractal::loop, fractal.get());
-    std::thread thread_fractal3(&alfrac::Fractal::loop, fractal.get());
-    std::thread thread_fractal4(&alfrac::Fractal::loop, fractal.get());
+    // Число потоков-вычислителей (-j N; по умолчанию - по числу аппаратных потоков).
+    size_t workers_number = 0;
+    std::string store_directory; // Директория хранилища тайлов на диске (--tile-store DIR; по умолчанию не используется).
+    std::string remote_addresses; // Адреса вычислителей AlFractalWorker через запятую (--remote; по умолчанию обсчёт местный).
+    std::string trace_path;      // Файл трассировки обсчёта в формате Chrome trace event (--trace FILE; по умолчанию не записывается).
+    alfrac::GUI::Settings settings;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool valid = true;
+        size_t amount = 0; // Бюджет в МиБ или КиБ.
+        if ((argument == "-j" || argument == "--workers") && i + 1 < argc)
+        { valid = alfrac::arguments::parse(argv[++i], workers_number, 0, alfrac::arguments::max_workers); }
+        else if (argument == "--tile-cache" && i + 1 < argc)
+        {
+            valid = alfrac::arguments::parse(argv[++i], amount, 0, std::numeric_limits<size_t>::max() >> 20);
+            if (valid) { settings.tile_cache_budget = amount << 20; }
+        }
+        else if (argument == "--upload-budget" && i + 1 < argc)
+        { valid = alfrac::arguments::parse(argv[++i], settings.upload_budget_ms, 0.0, 1000.0); }
+        else if (argument == "--upload-bytes" && i + 1 < argc)
+        {
+            valid = alfrac::arguments::parse(argv[++i], amount, 0, std::numeric_limits<size_t>::max() >> 10);
+            if (valid) { settings.upload_budget_bytes = amount << 10; }
+        }
+        else if (argument == "--tile-store" && i + 1 < argc)
+        { store_directory = argv[++i]; }
+        else if (argument == "--remote" && i + 1 < argc)
+        { remote_addresses = argv[++i]; }
+        else if (argument == "--trace" && i + 1 < argc)
+        { trace_path = argv[++i]; }
+
+        if (!valid)
+        {
+            std::cerr << "Некорректное значение ключа " << argument << "." << std::endl << usage;
+            return 1;
+        }
+    }
+
+    std::shared_ptr<alfrac::Fractal> fractal = std::make_shared<alfrac::Fractal>(workers_number);
+    if (!store_directory.empty())
+    { fractal->set_store(std::make_shared<alfrac::TileStore>(store_directory)); }
+    if (!remote_addresses.empty())
+    { fractal->set_remote(std::make_shared<alfrac::Coordinator>(remote_addresses)); }
+
+    // Счётчики собираются всегда (выводятся в оверлее), трассировка - лишь по запросу.
+    std::shared_ptr<alfrac::Instrumentation> instrumentation = std::make_shared<alfrac::Instrumentation>();
+    instrumentation->set_tracing(!trace_path.empty());
+    fractal->set_instrumentation(instrumentation);
 
-    alfrac::GUI gui(fractal);
+    alfrac::GUI gui(fractal, settings);
     gui.loop();
 
     fractal->terminate_loops();
-    thread_fractal1.join();
-    thread_fractal2.join();
-    thread_fractal3.join();
-    thread_fractal4.join();
+    if (!trace_path.empty() && !instrumentation->export_trace(trace_path))
+    {
+        std::cerr << "Не удалось записать трассировку в " << trace_path << "." << std::endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,232 @@
+#include "Palette.hpp"
+#include "Vectorized.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ALFRACTAL_X86
+#include <immintrin.h>
+#endif
+
+namespace alfrac
+{
+    namespace
+    {
+        const uint32_t lut_mask = Palette::lut_size - 1;
+
+        std::atomic<uint64_t> next_id{1}; // Номер следующей созданной палитры.
+
+        // Номер цвета точки в таблице. Порядок операций во всех реализациях одинаков, поэтому цвета совпадают.
+        inline uint32_t lut_index(float value, float inverse_period)
+        {
+            float turns = value * inverse_period;
+            float fraction = turns - std::floor(turns);
+            return static_cast<uint32_t>(static_cast<int32_t>(fraction * static_cast<float>(Palette::lut_size))) & lut_mask;
+        }
+
+        // Числа итераций читаются в типе хранения таблицы (см. IterationTable).
+        template <class Value>
+        void colour_scalar(const Value* iterations, const float* smooth, size_t count, int64_t iterations_limit,
+                           float inverse_period, const uint32_t* lut, uint32_t inside, uint8_t* rgba)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                int64_t point_iterations = static_cast<int64_t>(iterations[i]);
+                float value = smooth ? smooth[i] : static_cast<float>(point_iterations);
+                uint32_t colour = point_iterations >= iterations_limit ? inside : lut[lut_index(value, inverse_period)];
+                std::memcpy(rgba + 4 * i, &colour, sizeof(colour));
+            }
+        }
+
+        #ifdef ALFRACTAL_X86
+        // Загрузка 8 чисел итераций в 32-битные элементы.
+        __attribute__((target("avx2")))
+        inline __m256i load_counts(const uint8_t* iterations)
+        { return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(iterations))); }
+
+        __attribute__((target("avx2")))
+        inline __m256i load_counts(const uint16_t* iterations)
+        { return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(iterations))); }
+
+        __attribute__((target("avx2")))
+        inline __m256i load_counts(const uint32_t* iterations)
+        { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(iterations)); }
+
+        __attribute__((target("avx2")))
+        inline __m256i load_counts(const int64_t* iterations)
+        {
+            const __m256i low_halves = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+            __m256i first  = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(iterations)), low_halves);
+            __m256i second = _mm256_permutevar8x32_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(iterations + 4)), low_halves);
+            return _mm256_permute2x128_si256(first, second, 0x20);
+        }
+
+        // 8 точек за шаг: числа итераций расширяются или сжимаются до 32 бит (требуется iterations_limit <= INT32_MAX),
+        // цвета выбираются из таблицы одной командой gather.
+        template <class Value>
+        __attribute__((target("avx2")))
+        void colour_avx2(const Value* iterations, const float* smooth, size_t count, int64_t iterations_limit,
+                         float inverse_period, const uint32_t* lut, uint32_t inside, uint8_t* rgba)
+        {
+            const __m256i limit = _mm256_set1_epi32(static_cast<int32_t>(iterations_limit));
+            const __m256 inverse = _mm256_set1_ps(inverse_period);
+            const __m256 size = _mm256_set1_ps(static_cast<float>(Palette::lut_size));
+            const __m256i mask = _mm256_set1_epi32(static_cast<int32_t>(lut_mask));
+            const __m256i inside_colour = _mm256_set1_epi32(static_cast<int32_t>(inside));
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i counts = load_counts(iterations + i);
+                __m256 values = smooth ? _mm256_loadu_ps(smooth + i) : _mm256_cvtepi32_ps(counts);
+                __m256 turns = _mm256_mul_ps(values, inverse);
+                __m256 fraction = _mm256_sub_ps(turns, _mm256_floor_ps(turns));
+                __m256i index = _mm256_and_si256(_mm256_cvttps_epi32(_mm256_mul_ps(fraction, size)), mask);
+
+                __m256i colours = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), index, 4);
+                __m256i escaped = _mm256_cmpgt_epi32(limit, counts);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + 4 * i), _mm256_blendv_epi8(inside_colour, colours, escaped));
+            }
+            colour_scalar(iterations + i, smooth ? smooth + i : nullptr, count - i, iterations_limit, inverse_period, lut, inside, rgba + 4 * i);
+        }
+        #endif
+
+        template <class Value>
+        void colour_values(const Value* iterations, const float* smooth, size_t count, int64_t iterations_limit,
+                           float inverse_period, const uint32_t* lut, uint32_t inside, uint8_t* rgba)
+        {
+            #ifdef ALFRACTAL_X86
+            if (vectorized::detect() >= vectorized::InstructionSet::AVX2 && iterations_limit <= INT32_MAX)
+            {
+                colour_avx2(iterations, smooth, count, iterations_limit, inverse_period, lut, inside, rgba);
+                return;
+            }
+            #endif
+            colour_scalar(iterations, smooth, count, iterations_limit, inverse_period, lut, inside, rgba);
+        }
+    }
+
+
+    ////////////////     Palette     ///////////////
+    // Раскраска результатов обсчёта.
+    // PUBLIC:
+    Palette::Palette() : Palette("blue", { Colour{ 0, 0, 0, 255 }, Colour{ 0, 0, 255, 255 } }) { }
+
+    Palette::Palette(const std::string& init_name, const std::vector<Colour>& stops, double init_period, Colour init_inside)
+        : name{init_name}, period{init_period}, inside{_pack(init_inside)}, lut(lut_size), id{next_id.fetch_add(1)}
+    {
+        // Линейная интерполяция между соседними опорными цветами (с отбрасыванием дробной части, как в прежнем градиенте).
+        size_t segments = stops.size() > 1 ? stops.size() - 1 : 1;
+        for (size_t index = 0; index < lut_size; ++index)
+        {
+            double position = static_cast<double>(index) / static_cast<double>(lut_size) * static_cast<double>(segments);
+            size_t segment = std::min(static_cast<size_t>(position), segments - 1);
+            double weight = position - static_cast<double>(segment);
+            const Colour& start = stops[std::min(segment, stops.size() - 1)];
+            const Colour& end   = stops[std::min(segment + 1, stops.size() - 1)];
+
+            auto blend = [weight](uint8_t from, uint8_t to)
+            { return static_cast<uint8_t>(static_cast<double>(from) * (1.0 - weight) + static_cast<double>(to) * weight); };
+            lut[index] = _pack(Colour{ blend(start.r, end.r), blend(start.g, end.g), blend(start.b, end.b), blend(start.a, end.a) });
+        }
+    }
+
+    void Palette::colour(const Fractal::Data& data, uint8_t* rgba) const
+    {
+        const float* smooth = data.smooth.size() == data.iterations.size() ? data.smooth.data() : nullptr;
+        if (data.stride <= 1)
+        {
+            colour(data.iterations, smooth, 0, data.iterations.size(), data.iterations_limit, rgba);
+            return;
+        }
+
+        // Промежуточный результат: раскрашиваются столбцы, содержащие вычисленные точки, остальные точки копируют цвет.
+        const size_t stride = data.stride;
+        const size_t column_bytes = 4 * data.grid_y;
+        for (size_t x = 0; x < data.grid_x; ++x)
+        {
+            uint8_t* column = rgba + x * column_bytes;
+            if (x % stride != 0)
+            {
+                std::memcpy(column, rgba + (x - x % stride) * column_bytes, column_bytes);
+                continue;
+            }
+
+            size_t offset = x * data.grid_y;
+            colour(data.iterations, smooth ? smooth + offset : nullptr, offset, data.grid_y, data.iterations_limit, column);
+            for (size_t y = 0; y < data.grid_y; ++y)
+            {
+                if (y % stride != 0) { std::memcpy(column + 4 * y, column + 4 * (y - y % stride), 4); }
+            }
+        }
+    }
+
+    void Palette::colour(const IterationTable& iterations, const float* smooth, size_t first, size_t count, int64_t iterations_limit, uint8_t* rgba) const
+    {
+        double effective_period = period > 0.0 ? period : static_cast<double>(std::max<int64_t>(1, iterations_limit));
+        float inverse_period = static_cast<float>(1.0 / effective_period);
+
+        // Сжатая таблица распаковывается по блокам.
+        const uint8_t* raw = iterations.raw();
+        if (!raw)
+        {
+            int64_t values[IterationTable::block_size];
+            for (size_t done = 0; done < count; done += IterationTable::block_size)
+            {
+                size_t taken = std::min(IterationTable::block_size, count - done);
+                iterations.read(first + done, taken, values);
+                colour_values(values, smooth ? smooth + done : nullptr, taken, iterations_limit, inverse_period, lut.data(), inside, rgba + 4 * done);
+            }
+            return;
+        }
+
+        switch (iterations.width())
+        {
+            case 1:  { colour_values(reinterpret_cast<const uint8_t*>(raw) + first,  smooth, count, iterations_limit, inverse_period, lut.data(), inside, rgba); break; }
+            case 2:  { colour_values(reinterpret_cast<const uint16_t*>(raw) + first, smooth, count, iterations_limit, inverse_period, lut.data(), inside, rgba); break; }
+            case 4:  { colour_values(reinterpret_cast<const uint32_t*>(raw) + first, smooth, count, iterations_limit, inverse_period, lut.data(), inside, rgba); break; }
+            default: { colour_values(reinterpret_cast<const int64_t*>(raw) + first,  smooth, count, iterations_limit, inverse_period, lut.data(), inside, rgba); break; }
+        }
+    }
+
+    const std::string& Palette::get_name() const
+    { return name; }
+    uint64_t Palette::get_id() const
+    { return id; }
+
+    const std::vector<Palette>& Palette::presets()
+    {
+        static const std::vector<Palette> palettes =
+        {
+            Palette(),
+            Palette("fire",  { Colour{ 0, 0, 0, 255 }, Colour{ 128, 0, 0, 255 }, Colour{ 255, 96, 0, 255 }, Colour{ 255, 220, 64, 255 },
+                               Colour{ 255, 255, 255, 255 }, Colour{ 0, 0, 0, 255 } }, 64.0),
+            Palette("ocean", { Colour{ 0, 7, 100, 255 }, Colour{ 32, 107, 203, 255 }, Colour{ 237, 255, 255, 255 }, Colour{ 255, 170, 0, 255 },
+                               Colour{ 0, 2, 0, 255 }, Colour{ 0, 7, 100, 255 } }, 128.0),
+            Palette("grey",  { Colour{ 0, 0, 0, 255 }, Colour{ 255, 255, 255, 255 }, Colour{ 0, 0, 0, 255 } }, 32.0)
+        };
+        return palettes;
+    }
+
+    const Palette* Palette::find(const std::string& name)
+    {
+        for (const Palette& palette : presets())
+        {
+            if (palette.get_name() == name) { return &palette; }
+        }
+        return nullptr;
+    }
+
+    // PROTECTED:
+    uint32_t Palette::_pack(Colour colour)
+    {
+        uint32_t packed;
+        uint8_t bytes[4] = { colour.r, colour.g, colour.b, colour.a };
+        std::memcpy(&packed, bytes, sizeof(packed));
+        return packed;
+    }
+
+    // PRIVATE:
+}
@@ -0,0 +1,66 @@
+#include "Perturbation.hpp"
+
+namespace alfrac
+{
+    ////////////////  ReferenceOrbit  ///////////////
+    // Опорная орбита для расчёта методом возмущений.
+    // PUBLIC:
+    ReferenceOrbit::ReferenceOrbit(const mpf_vector_2d& init_center, mp_bitcnt_t init_precision, int64_t init_iterations_limit, const mpf_class& init_max_absolute)
+        : center{init_center}, precision{init_precision}, iterations_limit{init_iterations_limit}, max_absolute{init_max_absolute}
+    {
+        center.set_prec(precision);
+    }
+    ReferenceOrbit::~ReferenceOrbit() { }
+
+    const mpf_vector_2d& ReferenceOrbit::get_center() const
+    { return center; }
+    mp_bitcnt_t ReferenceOrbit::get_precision() const
+    { return precision; }
+    int64_t ReferenceOrbit::get_iterations_limit() const
+    { return iterations_limit; }
+    const mpf_class& ReferenceOrbit::get_max_absolute() const
+    { return max_absolute; }
+
+    const std::vector<double>& ReferenceOrbit::get_orbit_x()
+    {
+        std::call_once(once_calculated, &ReferenceOrbit::_calculate, this);
+        return orbit_x;
+    }
+    const std::vector<double>& ReferenceOrbit::get_orbit_y()
+    {
+        std::call_once(once_calculated, &ReferenceOrbit::_calculate, this);
+        return orbit_y;
+    }
+    size_t ReferenceOrbit::length()
+    {
+        std::call_once(once_calculated, &ReferenceOrbit::_calculate, this);
+        return orbit_x.size();
+    }
+
+    // PROTECTED:
+    void ReferenceOrbit::_calculate()
+    {
+        alg_mpf constant({ mpf_class(center.x, precision), mpf_class(center.y, precision) });
+        alg_mpf var({ mpf_class(0.0, precision), mpf_class(0.0, precision) });
+
+        mpf_class sqr_max_absolute(max_absolute * max_absolute, precision);
+
+        orbit_x.reserve(static_cast<size_t>(iterations_limit) + 1);
+        orbit_y.reserve(static_cast<size_t>(iterations_limit) + 1);
+        orbit_x.push_back(0.0);
+        orbit_y.push_back(0.0);
+
+        for (int64_t step = 0; step < iterations_limit; ++step)
+        {
+            var.multiply_add(var, constant);
+
+            mpf_class sqr_absolute = var.components[0] * var.components[0] + var.components[1] * var.components[1];
+            if (cmp(sqr_absolute, sqr_max_absolute) > 0) { break; }
+
+            orbit_x.push_back(var.components[0].get_d());
+            orbit_y.push_back(var.components[1].get_d());
+        }
+    }
+
+    // PRIVATE:
+}
@@ -0,0 +1,120 @@
+#include "Renderer.hpp"
+#include "Perturbation.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace alfrac
+{
+    namespace
+    {
+        // Запас бит точности координат сверх требуемого шагом сетки (как в GUI).
+        const mp_bitcnt_t precision_guard_bits = 64;
+    }
+
+
+    ////////////////    Renderer     ///////////////
+    // Обсчёт изображения произвольного размера без графического интерфейса.
+    // PUBLIC:
+    Renderer::Renderer(std::shared_ptr<Fractal> init_fractal) : fractal{init_fractal} { }
+
+    bool Renderer::render(const View& view, const RowCallback& callback)
+    {
+        if (view.image_width == 0 || view.image_height == 0 || view.tile_size == 0) { return false; }
+
+        View resolved = view;
+        if (resolved.precision == 0) { resolved.precision = coordinate_precision(view); }
+        if (!resolved.reference)
+        { resolved.reference = std::make_shared<ReferenceOrbit>(view.center, resolved.precision, view.iterations_limit, view.max_absolute); }
+
+        // Границы изображения и шаг сетки (одинаковый по обеим осям).
+        mp_bitcnt_t precision = resolved.precision;
+        mpf_class step(view.width / static_cast<unsigned long>(view.image_width), precision);
+        mpf_class half_width(view.width / 2u, precision);
+        mpf_class half_height(step * static_cast<unsigned long>(view.image_height) / 2u, precision);
+        mpf_rectangle frame(mpf_class(view.center.x - half_width, precision), mpf_class(view.center.y - half_height, precision),
+                            mpf_class(view.center.x + half_width, precision), mpf_class(view.center.y + half_height, precision));
+
+        std::vector<uint8_t> row(3 * view.image_width);
+        Band current = _request_band(resolved, frame, step, 0);
+        while (current.rows > 0)
+        {
+            // Следующая полоса запрашивается до сборки текущей.
+            size_t next_row = current.first_row + current.rows;
+            Band next = next_row < view.image_height ? _request_band(resolved, frame, step, next_row) : Band{ next_row, 0, { } };
+
+            std::vector<Fractal::Data> tiles;
+            tiles.reserve(current.tiles.size());
+            for (std::future<Fractal::Data>& tile : current.tiles)
+            { tiles.push_back(tile.get()); }
+
+            // Тайлы раскрашиваются целиком; строка r полосы соответствует точкам сетки с индексом rows - 1 - r по вертикали
+            // (ось y направлена вверх).
+            std::vector<std::vector<uint8_t>> colours(tiles.size());
+            for (size_t index = 0; index < tiles.size(); ++index)
+            {
+                colours[index].resize(4 * tiles[index].iterations.size());
+                view.palette.colour(tiles[index], colours[index].data());
+            }
+            for (size_t band_row = 0; band_row < current.rows; ++band_row)
+            {
+                size_t column = 0;
+                for (size_t index = 0; index < tiles.size(); ++index)
+                {
+                    const Fractal::Data& tile = tiles[index];
+                    for (size_t x = 0; x < tile.grid_x; ++x, ++column)
+                    { std::memcpy(&row[3 * column], &colours[index][4 * (x * tile.grid_y + (tile.grid_y - 1 - band_row))], 3); }
+                }
+                if (!callback(row.data(), current.first_row + band_row)) { return false; }
+            }
+
+            current = std::move(next);
+        }
+        return true;
+    }
+
+    mp_bitcnt_t Renderer::coordinate_precision(const View& view)
+    {
+        // Шаг сетки должен быть различим на фоне координат центра.
+        long width_exponent = 0;
+        mpf_get_d_2exp(&width_exponent, view.width.get_mpf_t());
+        double magnitude = std::max({ 1.0, std::fabs(view.center.x.get_d()), std::fabs(view.center.y.get_d()) });
+        double step_bits = static_cast<double>(-width_exponent) + std::log2(static_cast<double>(std::max<size_t>(view.image_width, 1))) + std::log2(magnitude);
+        mp_bitcnt_t bits = static_cast<mp_bitcnt_t>(std::max(0.0, std::ceil(step_bits))) + precision_guard_bits;
+        return (bits + mp_bits_per_limb - 1) / mp_bits_per_limb * mp_bits_per_limb;
+    }
+
+    // PROTECTED:
+    Renderer::Band Renderer::_request_band(const View& view, const mpf_rectangle& frame, const mpf_class& step, size_t first_row)
+    {
+        Band band;
+        band.first_row = first_row;
+        band.rows = std::min(view.tile_size, view.image_height - first_row);
+
+        // Нижняя точка сетки полосы соответствует её последней строке.
+        mpf_class bottom(frame.top_right.y - step * static_cast<unsigned long>(first_row + band.rows - 1), view.precision);
+        mpf_class top(bottom + step * static_cast<unsigned long>(band.rows), view.precision);
+
+        for (size_t first_column = 0; first_column < view.image_width; first_column += view.tile_size)
+        {
+            size_t columns = std::min(view.tile_size, view.image_width - first_column);
+
+            Fractal::Request request;
+            request.rectangle = mpf_rectangle(mpf_class(frame.bottom_left.x + step * static_cast<unsigned long>(first_column), view.precision), bottom,
+                                              mpf_class(frame.bottom_left.x + step * static_cast<unsigned long>(first_column + columns), view.precision), top);
+            request.grid_x = columns;
+            request.grid_y = band.rows;
+            request.precision = view.precision;
+            request.iterations_limit = view.iterations_limit;
+            request.max_absolute = mpf_class(view.max_absolute, view.precision);
+            request.reference = view.reference;
+            request.smooth = view.smooth;
+            request.priority = static_cast<double>(first_row); // Верхние полосы - раньше.
+
+            band.tiles.push_back(fractal->request_calc(request));
+        }
+        return band;
+    }
+
+    // PRIVATE:
+}
@@ -0,0 +1,171 @@
+#include "Scheduler.hpp"
+#include <algorithm>
+
+namespace alfrac
+{
+    ////////////////    Scheduler    ///////////////
+    // Пул потоков-вычислителей с перехватом работы (work stealing).
+    // PUBLIC:
+    Scheduler::Scheduler(size_t init_workers_number)
+    {
+        size_t workers_number = init_workers_number;
+        if (workers_number == 0)
+        { workers_number = std::max<size_t>(1, std::thread::hardware_concurrency()); }
+
+        workers.reserve(workers_number);
+        for (size_t index = 0; index < workers_number; ++index)
+        { workers.push_back(std::make_unique<Worker>()); }
+
+        // Потоки запускаются после создания всех очередей, так как перехват обращается к чужим очередям.
+        threads.reserve(workers_number);
+        for (size_t index = 0; index < workers_number; ++index)
+        { threads.emplace_back(&Scheduler::loop, this, index); }
+    }
+    Scheduler::~Scheduler()
+    {
+        terminate();
+    }
+
+    void Scheduler::submit(Scheduler::Task task, double priority, Scheduler::CancelToken cancelled, Scheduler::PriorityToken priority_token)
+    {
+        // Задачи распределяются по очередям по кругу; неравномерность выравнивается перехватом.
+        Worker& worker = *workers[next_worker.fetch_add(1) % workers.size()];
+        if (priority_token) { priority = priority_token->load(std::memory_order_relaxed); }
+        {
+            std::lock_guard<std::mutex> lock_tasks(worker.mutex_tasks);
+            worker.tasks.push_back(Entry{ priority, next_sequence.fetch_add(1), std::move(task), std::move(cancelled), std::move(priority_token) });
+            std::push_heap(worker.tasks.begin(), worker.tasks.end(), EntryCompare());
+        }
+        {
+            std::lock_guard<std::mutex> lock_sleep(mutex_sleep);
+            pending.fetch_add(1);
+        }
+        condition_tasks.notify_one();
+    }
+
+    void Scheduler::purge()
+    {
+        for (std::unique_ptr<Worker>& worker : workers)
+        {
+            std::lock_guard<std::mutex> lock_tasks(worker->mutex_tasks);
+            auto end = std::remove_if(worker->tasks.begin(), worker->tasks.end(), [](const Entry& entry) { return entry.is_cancelled(); });
+            pending.fetch_sub(static_cast<int64_t>(worker->tasks.end() - end));
+            worker->tasks.erase(end, worker->tasks.end());
+            std::make_heap(worker->tasks.begin(), worker->tasks.end(), EntryCompare());
+        }
+    }
+
+    void Scheduler::reprioritise()
+    {
+        for (std::unique_ptr<Worker>& worker : workers)
+        {
+            std::lock_guard<std::mutex> lock_tasks(worker->mutex_tasks);
+            for (Entry& entry : worker->tasks)
+            {
+                if (entry.priority_token) { entry.priority = entry.priority_token->load(std::memory_order_relaxed); }
+            }
+            std::make_heap(worker->tasks.begin(), worker->tasks.end(), EntryCompare());
+        }
+    }
+
+    void Scheduler::terminate()
+    {
+        {
+            std::lock_guard<std::mutex> lock_sleep(mutex_sleep);
+            in_loop.store(false);
+        }
+        condition_tasks.notify_all();
+
+        for (std::thread& thread : threads)
+        {
+            if (thread.joinable()) { thread.join(); }
+        }
+    }
+
+    size_t Scheduler::get_workers_number() const
+    { return workers.size(); }
+
+    int64_t Scheduler::get_queue_length() const
+    { return std::max<int64_t>(0, pending.load()); }
+
+    std::vector<Scheduler::Utilization> Scheduler::get_utilization() const
+    {
+        std::vector<Utilization> utilization;
+        utilization.reserve(workers.size());
+        for (const std::unique_ptr<Worker>& worker : workers)
+        { utilization.push_back(Utilization{ worker->busy_ns.load(std::memory_order_relaxed), worker->idle_ns.load(std::memory_order_relaxed) }); }
+        return utilization;
+    }
+
+    // PROTECTED:
+    void Scheduler::loop(size_t index)
+    {
+        using Clock = std::chrono::steady_clock;
+        auto nanoseconds = [](Clock::duration duration) { return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()); };
+
+        Worker& worker = *workers[index];
+        Clock::time_point mark = Clock::now(); // Конец последней задачи.
+        Scheduler::Task task;
+        while (in_loop.load())
+        {
+            if (_pop(index, task))
+            {
+                Clock::time_point started = Clock::now();
+                task();
+                task = nullptr;
+
+                Clock::time_point finished = Clock::now();
+                worker.idle_ns.fetch_add(nanoseconds(started - mark), std::memory_order_relaxed);
+                worker.busy_ns.fetch_add(nanoseconds(finished - started), std::memory_order_relaxed);
+                mark = finished;
+                continue;
+            }
+
+            // Простой, когда все очереди пусты.
+            std::unique_lock<std::mutex> lock_sleep(mutex_sleep);
+            condition_tasks.wait(lock_sleep, [this]() { return pending.load() > 0 || !in_loop.load(); });
+        }
+    }
+
+    bool Scheduler::_pop(size_t index, Scheduler::Task& task)
+    {
+        // Сначала своя очередь, затем перехват из чужих, начиная с соседней.
+        for (size_t offset = 0; offset < workers.size(); ++offset)
+        {
+            if (_pop_from(*workers[(index + offset) % workers.size()], task))
+            { return true; }
+        }
+        return false;
+    }
+
+    bool Scheduler::_pop_from(Worker& worker, Scheduler::Task& task)
+    {
+        std::lock_guard<std::mutex> lock_tasks(worker.mutex_tasks);
+        while (!worker.tasks.empty())
+        {
+            std::pop_heap(worker.tasks.begin(), worker.tasks.end(), EntryCompare());
+            Entry entry = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            pending.fetch_sub(1);
+
+            // Отменённые задачи отбрасываются без выполнения.
+            if (!entry.is_cancelled())
+            {
+                task = std::move(entry.task);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool Scheduler::Entry::is_cancelled() const
+    { return cancelled && cancelled->load(std::memory_order_relaxed); }
+
+    bool Scheduler::EntryCompare::operator()(const Entry& left, const Entry& right) const
+    {
+        if (left.priority != right.priority) { return left.priority > right.priority; }
+        return left.sequence > right.sequence;
+    }
+
+    // PRIVATE:
+}
@@ -0,0 +1,289 @@
+#include "Sequence.hpp"
+#include "Perturbation.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace alfrac
+{
+    namespace
+    {
+        // Допуск при определении ключевого кадра (глубины, кратные приближению между ключевыми кадрами, относятся к более глубокому).
+        const double depth_tolerance = 1e-9;
+
+        // Двоичный логарифм модуля числа (без переполнения при значениях вне диапазона double).
+        double log2_abs(const mpf_class& value)
+        {
+            if (sgn(value) == 0) { return -std::numeric_limits<double>::infinity(); }
+
+            signed long int exponent;
+            double mantissa = mpf_get_d_2exp(&exponent, value.get_mpf_t());
+            return std::log2(std::fabs(mantissa)) + static_cast<double>(exponent);
+        }
+
+        // Одномерный фильтр пересэмплирования: точка i выхода - взвешенная сумма taps соседних точек входа начиная с first[i].
+        // Каждая точка выхода усредняет ceil(scale) билинейных выборок по своему отрезку входа (усреднение по площади при уменьшении).
+        struct Filter
+        {
+            size_t taps;
+            std::vector<size_t> first;
+            std::vector<float> weights;
+        };
+
+        Filter make_filter(size_t output_size, size_t input_size, double scale)
+        {
+            size_t samples = std::max<size_t>(1, static_cast<size_t>(std::ceil(scale - depth_tolerance)));
+            double last = static_cast<double>(input_size - 1);
+
+            Filter filter;
+            filter.taps = std::min(samples + 2, input_size);
+            filter.first.resize(output_size);
+            filter.weights.assign(output_size * filter.taps, 0.0f);
+            for (size_t i = 0; i < output_size; ++i)
+            {
+                // Точка i выхода соответствует точке input_size / 2 + (i - output_size / 2) * scale входа (центры совпадают).
+                double center = 0.5 * static_cast<double>(input_size) + (static_cast<double>(i) - 0.5 * static_cast<double>(output_size)) * scale;
+                double lowest = std::min(std::max(center + (0.5 / samples - 0.5) * scale, 0.0), last);
+                size_t first = std::min(static_cast<size_t>(lowest), input_size - filter.taps);
+                filter.first[i] = first;
+
+                float* weights = &filter.weights[i * filter.taps];
+                for (size_t sample = 0; sample < samples; ++sample)
+                {
+                    double position = std::min(std::max(center + ((sample + 0.5) / samples - 0.5) * scale, 0.0), last);
+                    size_t index = static_cast<size_t>(position);
+                    double fraction = position - static_cast<double>(index);
+                    weights[index - first] += static_cast<float>((1.0 - fraction) / samples);
+                    if (fraction > 0.0) { weights[index + 1 - first] += static_cast<float>(fraction / samples); }
+                }
+            }
+            return filter;
+        }
+    }
+
+
+    ////////////////    Sequence     ///////////////
+    // Обсчёт последовательности кадров приближения к точке (для видео).
+    // PUBLIC:
+    Sequence::Sequence(std::shared_ptr<Fractal> init_fractal) : fractal{init_fractal}, renderer(init_fractal) { }
+
+    bool Sequence::render(const Path& path, const FrameCallback& callback)
+    {
+        if (path.frames == 0 || path.image_width == 0 || path.image_height == 0 || path.keyframe_zoom < 2) { return false; }
+        if (sgn(path.end_width) <= 0 || path.end_width > path.start_width) { return false; }
+
+        size_t keyframes = keyframes_number(path);
+        double zoom_bits = std::log2(static_cast<double>(path.keyframe_zoom));
+        double total_bits = log2_abs(path.start_width) - log2_abs(path.end_width);
+
+        // Одна опорная орбита на всю последовательность: в центре, с точностью самого глубокого ключевого кадра.
+        std::shared_ptr<ReferenceOrbit> reference = std::make_shared<ReferenceOrbit>(path.center,
+            Renderer::coordinate_precision(_keyframe_view(path, keyframes - 1)), path.iterations_limit, path.max_absolute);
+
+        // Очередь кадров на запись.
+        std::mutex mutex_queue;
+        std::condition_variable queue_changed;
+        std::deque<std::pair<size_t, std::vector<uint8_t>>> queue;
+        std::vector<std::vector<uint8_t>> spare; // Буферы уже записанных кадров.
+        bool producing = true;
+        std::atomic<bool> failed(false);
+
+        std::thread encoder([&]()
+        {
+            while (true)
+            {
+                std::pair<size_t, std::vector<uint8_t>> item;
+                {
+                    std::unique_lock<std::mutex> lock_queue(mutex_queue);
+                    queue_changed.wait(lock_queue, [&]() { return !queue.empty() || !producing; });
+                    if (queue.empty()) { return; }
+                    item = std::move(queue.front());
+                    queue.pop_front();
+                }
+                queue_changed.notify_all();
+
+                if (!failed && !callback(item.second.data(), item.first)) { failed = true; }
+
+                std::lock_guard<std::mutex> lock_queue(mutex_queue);
+                spare.push_back(std::move(item.second));
+            }
+        });
+
+        // Следующий ключевой кадр обсчитывается, пока кадры текущего пересэмплируются и записываются.
+        std::function<bool()> is_cancelled = [&failed]() { return failed.load(); };
+        auto request_keyframe = [this, &path, &reference, &is_cancelled](size_t index)
+        {
+            Renderer::View view = _keyframe_view(path, index);
+            view.reference = reference;
+            return std::async(std::launch::async, [this, view, is_cancelled]() { return _render_keyframe(view, is_cancelled); });
+        };
+
+        // Завершение записи: очередь закрывается, поток записи присоединяется.
+        auto stop_encoder = [&]()
+        {
+            {
+                std::lock_guard<std::mutex> lock_queue(mutex_queue);
+                producing = false;
+            }
+            queue_changed.notify_all();
+            encoder.join();
+        };
+
+        // Если обсчёт ключевого кадра завершился исключением, поток записи останавливается до раскрутки стека
+        // (разрушение присоединяемого std::thread завершает процесс), а обсчёт следующего кадра отменяется.
+        // Объявлен после next, чтобы сработать раньше ожидания его future.
+        struct EncoderGuard
+        {
+            std::thread& encoder;
+            std::atomic<bool>& failed;
+            const std::function<void()> stop;
+            ~EncoderGuard()
+            {
+                if (!encoder.joinable()) { return; }
+                failed = true;
+                stop();
+            }
+        };
+
+        size_t current_index = 0;
+        std::future<Keyframe> next;
+        EncoderGuard encoder_guard{ encoder, failed, stop_encoder };
+        next = request_keyframe(0);
+        Keyframe current = next.get();
+        if (keyframes > 1) { next = request_keyframe(1); }
+
+        size_t frame_size = 3 * path.image_width * path.image_height;
+        for (size_t frame = 0; frame < path.frames && !failed; ++frame)
+        {
+            double depth = path.frames > 1 ? total_bits * static_cast<double>(frame) / static_cast<double>(path.frames - 1) : 0.0;
+            size_t index = std::min(keyframes - 1, static_cast<size_t>(depth / zoom_bits + depth_tolerance));
+            while (current_index < index)
+            {
+                current = next.get();
+                ++current_index;
+                if (current_index + 1 < keyframes) { next = request_keyframe(current_index + 1); }
+            }
+            if (!current.complete) { failed = true; break; }
+
+            std::vector<uint8_t> buffer;
+            {
+                std::unique_lock<std::mutex> lock_queue(mutex_queue);
+                queue_changed.wait(lock_queue, [&]() { return queue.size() < std::max<size_t>(path.queue_size, 1); });
+                if (!spare.empty())
+                {
+                    buffer = std::move(spare.back());
+                    spare.pop_back();
+                }
+            }
+            buffer.resize(frame_size);
+
+            // Шаг сетки кадра в шагах сетки ключевого кадра: от 1 (кадр вглубь на keyframe_zoom) до keyframe_zoom (кадр совпадает с ключевым).
+            double scale = std::exp2(static_cast<double>(current_index) * zoom_bits - depth) * static_cast<double>(path.keyframe_zoom);
+            _resample(path, current, scale, buffer.data());
+
+            {
+                std::lock_guard<std::mutex> lock_queue(mutex_queue);
+                queue.emplace_back(frame, std::move(buffer));
+            }
+            queue_changed.notify_all();
+        }
+
+        stop_encoder();
+
+        if (next.valid()) { next.wait(); } // Прерванный обсчёт ключевого кадра.
+        return !failed;
+    }
+
+    size_t Sequence::keyframes_number(const Path& path)
+    {
+        if (path.keyframe_zoom < 2 || sgn(path.end_width) <= 0 || path.end_width > path.start_width) { return 1; }
+
+        double total_bits = log2_abs(path.start_width) - log2_abs(path.end_width);
+        return static_cast<size_t>(total_bits / std::log2(static_cast<double>(path.keyframe_zoom)) + depth_tolerance) + 1;
+    }
+
+    // PROTECTED:
+    Renderer::View Sequence::_keyframe_view(const Path& path, size_t index)
+    {
+        mpf_class zoom(path.keyframe_zoom, path.start_width.get_prec());
+        mpf_pow_ui(zoom.get_mpf_t(), zoom.get_mpf_t(), index);
+
+        Renderer::View view;
+        view.center = path.center;
+        view.width = mpf_class(path.start_width / zoom, path.start_width.get_prec());
+        view.image_width  = path.image_width * path.keyframe_zoom;
+        view.image_height = path.image_height * path.keyframe_zoom;
+        view.iterations_limit = path.iterations_limit;
+        view.max_absolute = path.max_absolute;
+        view.tile_size = path.tile_size;
+        view.smooth = path.smooth;
+        view.palette = path.palette;
+        return view;
+    }
+
+    Sequence::Keyframe Sequence::_render_keyframe(const Renderer::View& view, const std::function<bool()>& is_cancelled)
+    {
+        Keyframe keyframe;
+        keyframe.width  = view.image_width;
+        keyframe.height = view.image_height;
+        keyframe.rgb.resize(3 * keyframe.width * keyframe.height);
+
+        size_t row_size = 3 * keyframe.width;
+        keyframe.complete = renderer.render(view, [&keyframe, row_size, &is_cancelled](const uint8_t* rgb, size_t row)
+        {
+            std::copy(rgb, rgb + row_size, keyframe.rgb.begin() + row_size * row);
+            return !is_cancelled();
+        });
+        return keyframe;
+    }
+
+    void Sequence::_resample(const Path& path, const Keyframe& keyframe, double scale, uint8_t* frame)
+    {
+        Filter columns = make_filter(path.image_width, keyframe.width, scale);
+        Filter rows = make_filter(path.image_height, keyframe.height, scale);
+
+        // Используемые столбцы ключевого кадра.
+        size_t column_begin = columns.first.front();
+        size_t column_end = columns.first.back() + columns.taps;
+        std::vector<float> blended(3 * (column_end - column_begin));
+
+        for (size_t y = 0; y < path.image_height; ++y)
+        {
+            // Сначала смешиваются строки ключевого кадра, затем столбцы.
+            std::fill(blended.begin(), blended.end(), 0.0f);
+            for (size_t tap = 0; tap < rows.taps; ++tap)
+            {
+                float weight = rows.weights[y * rows.taps + tap];
+                if (weight == 0.0f) { continue; }
+
+                const uint8_t* source = &keyframe.rgb[3 * (keyframe.width * (rows.first[y] + tap) + column_begin)];
+                for (size_t i = 0; i < blended.size(); ++i)
+                { blended[i] += weight * static_cast<float>(source[i]); }
+            }
+
+            uint8_t* destination = frame + 3 * path.image_width * y;
+            for (size_t x = 0; x < path.image_width; ++x)
+            {
+                float rgb[3] = { 0.0f, 0.0f, 0.0f };
+                const float* weights = &columns.weights[x * columns.taps];
+                const float* source = &blended[3 * (columns.first[x] - column_begin)];
+                for (size_t tap = 0; tap < columns.taps; ++tap)
+                {
+                    rgb[0] += weights[tap] * source[3 * tap];
+                    rgb[1] += weights[tap] * source[3 * tap + 1];
+                    rgb[2] += weights[tap] * source[3 * tap + 2];
+                }
+                for (size_t channel = 0; channel < 3; ++channel)
+                { destination[3 * x + channel] = static_cast<uint8_t>(std::min(255.0f, rgb[channel] + 0.5f)); }
+            }
+        }
+    }
+
+    // PRIVATE:
+}
@@ -0,0 +1,113 @@
+#include "Socket.hpp"
+#include <cstring>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace alfrac
+{
+    ////////////////       net       ///////////////
+    // Сокеты для обмена между процессами.
+    namespace net
+    {
+        bool write_all(int socket, const void* buffer, size_t size)
+        {
+            const char* position = static_cast<const char*>(buffer);
+            while (size > 0)
+            {
+                ssize_t written = ::send(socket, position, size, MSG_NOSIGNAL);
+                if (written <= 0) { return false; }
+                position += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        bool read_all(int socket, void* buffer, size_t size)
+        {
+            char* position = static_cast<char*>(buffer);
+            while (size > 0)
+            {
+                ssize_t received = ::recv(socket, position, size, 0);
+                if (received <= 0) { return false; }
+                position += received;
+                size -= static_cast<size_t>(received);
+            }
+            return true;
+        }
+
+        int open_socket(const std::string& address, bool listening)
+        {
+            const std::string unix_prefix = "unix:";
+            if (address.compare(0, unix_prefix.size(), unix_prefix) == 0)
+            {
+                std::string path = address.substr(unix_prefix.size());
+                sockaddr_un socket_address;
+                std::memset(&socket_address, 0, sizeof(socket_address));
+                if (path.empty() || path.size() >= sizeof(socket_address.sun_path)) { return -1; }
+                socket_address.sun_family = AF_UNIX;
+                std::memcpy(socket_address.sun_path, path.c_str(), path.size());
+
+                int descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                if (descriptor < 0) { return -1; }
+                if (listening) { ::unlink(path.c_str()); }
+                bool opened = listening ? ::bind(descriptor, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) == 0 && ::listen(descriptor, 16) == 0
+                                        : ::connect(descriptor, reinterpret_cast<sockaddr*>(&socket_address), sizeof(socket_address)) == 0;
+                if (!opened)
+                {
+                    ::close(descriptor);
+                    return -1;
+                }
+                return descriptor;
+            }
+
+            size_t colon = address.rfind(':');
+            if (colon == std::string::npos) { return -1; }
+            std::string host = address.substr(0, colon);
+            std::string port = address.substr(colon + 1);
+
+            addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = listening ? AI_PASSIVE : 0;
+            addrinfo* found = nullptr;
+            if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &found) != 0) { return -1; }
+
+            int descriptor = -1;
+            for (addrinfo* candidate = found; candidate && descriptor < 0; candidate = candidate->ai_next)
+            {
+                descriptor = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+                if (descriptor < 0) { continue; }
+
+                int enabled = 1;
+                bool opened;
+                if (listening)
+                {
+                    ::setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+                    opened = ::bind(descriptor, candidate->ai_addr, candidate->ai_addrlen) == 0 && ::listen(descriptor, 16) == 0;
+                }
+                else
+                { opened = ::connect(descriptor, candidate->ai_addr, candidate->ai_addrlen) == 0; }
+
+                if (!opened)
+                {
+                    ::close(descriptor);
+                    descriptor = -1;
+                }
+            }
+            ::freeaddrinfo(found);
+            return descriptor;
+        }
+
+        void tune_socket(int socket)
+        {
+            int enabled = 1;
+            ::setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+            ::setsockopt(socket, SOL_SOCKET, SO_KEEPALIVE, &enabled, sizeof(enabled));
+        }
+    }
+}
@@ -0,0 +1,480 @@
+#include "TileServer.hpp"
+#include "Perturbation.hpp"
+#include "Palette.hpp"
+#include "ImageWriter.hpp"
+#include "Socket.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <sstream>
+#include <unistd.h>
+#include <sys/socket.h>
+
+namespace alfrac
+{
+    namespace
+    {
+        const mp_bitcnt_t precision_guard_bits = 64;    // Запас точности координат (как у тайлов интерфейса).
+        const size_t      max_header_size      = 16384; // Наибольший размер заголовка запроса HTTP.
+        const size_t      max_body_size        = 65536; // Наибольшее пропускаемое содержимое запроса.
+        const size_t      references_kept      = 16;    // Опорных орбит в кэше.
+
+        // Неотрицательное десятичное число (лишь цифры, без знака и пробелов).
+        bool parse_integer(const std::string& text, int64_t& value)
+        {
+            if (text.empty() || text.size() > 18) { return false; }
+            value = 0;
+            for (char symbol : text)
+            {
+                if (!std::isdigit(static_cast<unsigned char>(symbol))) { return false; }
+                value = 10 * value + (symbol - '0');
+            }
+            return true;
+        }
+
+        bool parse_integer(const std::string& text, mpz_class& value)
+        {
+            if (text.empty() || !std::all_of(text.begin(), text.end(), [](char symbol) { return std::isdigit(static_cast<unsigned char>(symbol)); }))
+            { return false; }
+            return value.set_str(text, 10) == 0;
+        }
+
+        std::vector<std::string> split(const std::string& text, char separator)
+        {
+            std::vector<std::string> result;
+            size_t first = 0;
+            while (true)
+            {
+                size_t found = text.find(separator, first);
+                result.push_back(text.substr(first, found == std::string::npos ? std::string::npos : found - first));
+                if (found == std::string::npos) { return result; }
+                first = found + 1;
+            }
+        }
+
+        std::string to_lower(std::string text)
+        {
+            for (char& symbol : text) { symbol = static_cast<char>(std::tolower(static_cast<unsigned char>(symbol))); }
+            return text;
+        }
+
+        const char* reason_phrase(int status)
+        {
+            switch (status)
+            {
+                case 200: return "OK";
+                case 400: return "Bad Request";
+                case 404: return "Not Found";
+                case 405: return "Method Not Allowed";
+                default:  return "Internal Server Error";
+            }
+        }
+
+        size_t data_memory_usage(const Fractal::Data& data)
+        {
+            size_t orbits_usage = data.orbits ? data.orbits->memory_usage() : 0;
+            return sizeof(Fractal::Data) + data.iterations.memory_usage() + data.smooth.capacity() * sizeof(float) + orbits_usage;
+        }
+    }
+
+
+    ////////////////   TileServer    ///////////////
+    // Сервер тайлов.
+    // PUBLIC:
+    bool TileServer::Key::operator==(const Key& right) const
+    {
+        return level == right.level && x == right.x && y == right.y && tile_size == right.tile_size &&
+               iterations_limit == right.iterations_limit && smooth == right.smooth;
+    }
+
+    std::size_t TileServer::KeyHasher::operator()(const Key& key) const
+    {
+        std::size_t hash = std::hash<int64_t>()(key.level);
+        for (std::size_t part : { std::hash<long>()(mpz_get_si(key.x.get_mpz_t())), std::hash<long>()(mpz_get_si(key.y.get_mpz_t())),
+                                  std::hash<size_t>()(key.tile_size), std::hash<int64_t>()(key.iterations_limit), std::hash<bool>()(key.smooth) })
+        { hash ^= part + 0x9e3779b9 + (hash << 6) + (hash >> 2); }
+        return hash;
+    }
+
+    TileServer::TileServer(std::shared_ptr<Fractal> init_fractal) : TileServer(std::move(init_fractal), Settings()) { }
+    TileServer::TileServer(std::shared_ptr<Fractal> init_fractal, const Settings& init_settings)
+        : fractal{std::move(init_fractal)}, settings(init_settings)
+    { }
+    TileServer::~TileServer()
+    {
+        {
+            std::lock_guard<std::mutex> lock_connections(mutex_connections);
+            for (const std::shared_ptr<Connection>& connection : connections) { ::shutdown(connection->socket, SHUT_RDWR); }
+        }
+        for (std::thread& thread : threads) { thread.join(); }
+    }
+
+    bool TileServer::serve(const std::string& address)
+    {
+        int listener = net::open_socket(address, true);
+        if (listener < 0) { return false; }
+
+        while (true)
+        {
+            int socket = ::accept(listener, nullptr, nullptr);
+            if (socket < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED) { continue; }
+                break;
+            }
+            net::tune_socket(socket);
+
+            std::shared_ptr<Connection> connection = std::make_shared<Connection>();
+            connection->socket = socket;
+            std::lock_guard<std::mutex> lock_connections(mutex_connections);
+
+            // Потоки закрытых соединений присоединяются, чтобы не накапливались.
+            for (size_t index = connections.size(); index-- > 0;)
+            {
+                if (!connections[index]->closed.load()) { continue; }
+                threads[index].join();
+                threads.erase(threads.begin() + static_cast<std::ptrdiff_t>(index));
+                connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(index));
+            }
+            connections.push_back(connection);
+            threads.emplace_back(&TileServer::_serve_connection, this, connection);
+        }
+        ::close(listener);
+        return true;
+    }
+
+    std::shared_ptr<const Fractal::Data> TileServer::get_tile(const Key& key)
+    {
+        std::promise<std::shared_ptr<const Fractal::Data>> promise;
+        {
+            std::unique_lock<std::mutex> lock_cache(mutex_cache);
+            ++statistics.requests;
+
+            auto cached = index.find(key);
+            if (cached != index.end())
+            {
+                ++statistics.hits;
+                entries.splice(entries.begin(), entries, cached->second);
+                return cached->second->data;
+            }
+
+            // Тот же тайл уже обсчитывается: ожидается его результат.
+            auto computing = in_flight.find(key);
+            if (computing != in_flight.end())
+            {
+                ++statistics.coalesced;
+                std::shared_future<std::shared_ptr<const Fractal::Data>> future = computing->second;
+                lock_cache.unlock();
+                return future.get();
+            }
+
+            ++statistics.computed;
+            in_flight.emplace(key, promise.get_future().share());
+        }
+
+        std::shared_ptr<const Fractal::Data> result;
+        try
+        {
+            Fractal::Data data = fractal->request_calc(make_request(key)).get();
+            data.iterations.compress();
+            result = std::make_shared<const Fractal::Data>(std::move(data));
+        }
+        catch (...)
+        {
+            {
+                std::lock_guard<std::mutex> lock_cache(mutex_cache);
+                in_flight.erase(key);
+            }
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock_cache(mutex_cache);
+            in_flight.erase(key);
+
+            size_t bytes = data_memory_usage(*result);
+            entries.push_front(Entry{ key, result, bytes });
+            index[key] = entries.begin();
+            ++statistics.tiles;
+            statistics.bytes += bytes;
+            _trim();
+        }
+        promise.set_value(result);
+        return result;
+    }
+
+    Fractal::Request TileServer::make_request(const Key& key)
+    {
+        Fractal::Request request;
+
+        // Углы тайла - двоичные дроби с level знаками после запятой; точкам сетки нужен ещё log2(tile_size) бит и запас.
+        mp_bitcnt_t bits = static_cast<mp_bitcnt_t>(key.level) + 2 + static_cast<mp_bitcnt_t>(std::ceil(std::log2(static_cast<double>(key.tile_size)))) + precision_guard_bits;
+        request.precision = (bits + mp_bits_per_limb - 1) / mp_bits_per_limb * mp_bits_per_limb;
+
+        // Сторона тайла - 2^(2 - level); номер y отсчитывается от верхнего края.
+        mpf_class left(key.x, request.precision);
+        mpf_class top(key.y, request.precision);
+        mpf_class right(key.x + 1, request.precision);
+        mpf_class bottom(key.y + 1, request.precision);
+        for (mpf_class* value : { &left, &top, &right, &bottom })
+        {
+            if (key.level >= 2) { mpf_div_2exp(value->get_mpf_t(), value->get_mpf_t(), static_cast<mp_bitcnt_t>(key.level - 2)); }
+            else                { mpf_mul_2exp(value->get_mpf_t(), value->get_mpf_t(), static_cast<mp_bitcnt_t>(2 - key.level)); }
+        }
+        request.rectangle = mpf_rectangle(mpf_class(left - 2, request.precision), mpf_class(2 - bottom, request.precision),
+                                          mpf_class(right - 2, request.precision), mpf_class(2 - top, request.precision));
+
+        request.grid_x = key.tile_size;
+        request.grid_y = key.tile_size;
+        request.iterations_limit = key.iterations_limit;
+        request.max_absolute = mpf_class(settings.max_absolute, request.precision);
+        request.smooth = key.smooth;
+        request.priority = static_cast<double>(key.level); // Грубые уровни - раньше.
+
+        // Глубокие тайлы считаются методом возмущений относительно общей орбиты.
+        if (Fractal::choose_tier(request) == Fractal::Tier::Mpf) { request.reference = _reference(key, request.precision); }
+        return request;
+    }
+
+    bool TileServer::is_valid(const Key& key) const
+    {
+        if (key.level < 0 || key.level > settings.max_level || key.tile_size < 1 || key.tile_size > settings.max_tile_size ||
+            key.iterations_limit < 1 || key.iterations_limit > settings.max_iterations)
+        { return false; }
+
+        mpz_class tiles_number;
+        mpz_ui_pow_ui(tiles_number.get_mpz_t(), 2, static_cast<unsigned long>(key.level));
+        return key.x >= 0 && key.x < tiles_number && key.y >= 0 && key.y < tiles_number;
+    }
+
+    TileServer::Statistics TileServer::get_statistics() const
+    {
+        std::lock_guard<std::mutex> lock_cache(mutex_cache);
+        return statistics;
+    }
+
+    // PROTECTED:
+    TileServer::Connection::~Connection()
+    {
+        if (socket >= 0) { ::close(socket); }
+    }
+
+    void TileServer::_serve_connection(std::shared_ptr<Connection> connection)
+    {
+        std::string buffer;
+        bool keep_alive = true;
+        while (keep_alive)
+        {
+            // Заголовок запроса (содержимое запросов GET не используется и пропускается).
+            size_t header_end;
+            while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos)
+            {
+                char chunk[4096];
+                ssize_t received = buffer.size() < max_header_size ? ::recv(connection->socket, chunk, sizeof(chunk), 0) : -1;
+                if (received <= 0)
+                {
+                    connection->closed.store(true);
+                    return;
+                }
+                buffer.append(chunk, static_cast<size_t>(received));
+            }
+            std::vector<std::string> lines = split(buffer.substr(0, header_end), '\n');
+            buffer.erase(0, header_end + 4);
+
+            std::istringstream request_line(lines[0]);
+            std::string method, target, version;
+            request_line >> method >> target >> version;
+            keep_alive = version == "HTTP/1.1";
+
+            int64_t body_size = 0;
+            for (size_t index = 1; index < lines.size(); ++index)
+            {
+                size_t colon = lines[index].find(':');
+                if (colon == std::string::npos) { continue; }
+                std::string name = to_lower(lines[index].substr(0, colon));
+                std::string value = lines[index].substr(colon + 1);
+                value.erase(0, value.find_first_not_of(" \t"));
+                value.erase(value.find_last_not_of(" \t\r") + 1);
+                if (name == "connection") { keep_alive = to_lower(value) == "keep-alive" || (keep_alive && to_lower(value) != "close"); }
+                else if (name == "content-length" && (!parse_integer(value, body_size) || static_cast<size_t>(body_size) > max_body_size))
+                { keep_alive = false; }
+            }
+            if (keep_alive)
+            {
+                while (buffer.size() < static_cast<size_t>(body_size))
+                {
+                    char chunk[4096];
+                    ssize_t received = ::recv(connection->socket, chunk, sizeof(chunk), 0);
+                    if (received <= 0) { break; }
+                    buffer.append(chunk, static_cast<size_t>(received));
+                }
+                buffer.erase(0, std::min(buffer.size(), static_cast<size_t>(body_size)));
+            }
+
+            Response response;
+            if (method == "GET" || method == "HEAD") { response = _respond(target); }
+            else
+            {
+                response.status = 405;
+                std::string message = "Поддерживаются лишь GET и HEAD.\n";
+                response.body.assign(message.begin(), message.end());
+            }
+
+            std::ostringstream header;
+            header << "HTTP/1.1 " << response.status << ' ' << reason_phrase(response.status) << "\r\n"
+                   << "Content-Type: " << response.content_type << "\r\n"
+                   << "Content-Length: " << response.body.size() << "\r\n"
+                   << "Access-Control-Allow-Origin: *\r\n"
+                   << "Cache-Control: " << (response.immutable ? "public, max-age=31536000, immutable" : "no-store") << "\r\n";
+            if (!keep_alive) { header << "Connection: close\r\n"; }
+            header << "\r\n";
+            std::string header_text = header.str();
+            if (!net::write_all(connection->socket, header_text.data(), header_text.size()) ||
+                (method != "HEAD" && !net::write_all(connection->socket, response.body.data(), response.body.size())))
+            { break; }
+        }
+        ::shutdown(connection->socket, SHUT_RDWR);
+        connection->closed.store(true);
+    }
+
+    TileServer::Response TileServer::_respond(const std::string& target)
+    {
+        Response response;
+        auto fail = [&response](int status, const std::string& message)
+        {
+            response.status = status;
+            response.body.assign(message.begin(), message.end());
+            response.body.push_back('\n');
+            return response;
+        };
+
+        size_t question = target.find('?');
+        std::string path = target.substr(0, question);
+        std::string query = question == std::string::npos ? std::string() : target.substr(question + 1);
+
+        if (path == "/stats")
+        {
+            Statistics current = get_statistics();
+            std::ostringstream json;
+            json << "{\"requests\": " << current.requests << ", \"hits\": " << current.hits << ", \"coalesced\": " << current.coalesced
+                 << ", \"computed\": " << current.computed << ", \"evictions\": " << current.evictions << ", \"tiles\": " << current.tiles
+                 << ", \"bytes\": " << current.bytes << ", \"budget\": " << settings.cache_budget << ", \"queue\": " << fractal->get_queue_length() << "}\n";
+            std::string text = json.str();
+            response.content_type = "application/json";
+            response.body.assign(text.begin(), text.end());
+            return response;
+        }
+
+        // /tile/LEVEL/X/Y.FORMAT
+        std::vector<std::string> parts = split(path, '/');
+        if (parts.size() != 5 || !parts[0].empty() || parts[1] != "tile") { return fail(404, "Неизвестный ресурс: " + path); }
+        size_t dot = parts[4].rfind('.');
+        std::string format = dot == std::string::npos ? std::string() : parts[4].substr(dot + 1);
+
+        Key key;
+        if (!parse_integer(parts[2], key.level) || !parse_integer(parts[3], key.x) || dot == std::string::npos || !parse_integer(parts[4].substr(0, dot), key.y))
+        { return fail(404, "Неверный адрес тайла: " + path); }
+
+        const Palette* palette = &Palette::presets().front();
+        for (const std::string& parameter : split(query, '&'))
+        {
+            if (parameter.empty()) { continue; }
+            size_t equals = parameter.find('=');
+            std::string name = parameter.substr(0, equals);
+            std::string value = equals == std::string::npos ? std::string() : parameter.substr(equals + 1);
+
+            int64_t number = 0;
+            bool parsed = true;
+            if (name == "iterations")   { parsed = parse_integer(value, key.iterations_limit); }
+            else if (name == "size")    { parsed = parse_integer(value, number); key.tile_size = static_cast<size_t>(number); }
+            else if (name == "smooth")  { parsed = value == "0" || value == "1"; key.smooth = value == "1"; }
+            else if (name == "palette") { parsed = (palette = Palette::find(value)) != nullptr; }
+            if (!parsed) { return fail(400, "Неверное значение параметра " + name + ": " + value); }
+        }
+        if (!is_valid(key))
+        {
+            return fail(400, "Адрес или параметры тайла вне допустимых пределов (уровень до " + std::to_string(settings.max_level) + ", размер до " +
+                             std::to_string(settings.max_tile_size) + ", итераций до " + std::to_string(settings.max_iterations) + ").");
+        }
+
+        std::shared_ptr<const Fractal::Data> data;
+        try
+        { data = get_tile(key); }
+        catch (const std::exception& exception)
+        { return fail(500, std::string("Ошибка обсчёта: ") + exception.what()); }
+
+        // Строка r изображения соответствует точкам сетки с индексом size - 1 - r по вертикали (ось y направлена вверх).
+        std::vector<uint8_t> rgba(4 * data->iterations.size());
+        palette->colour(*data, rgba.data());
+        std::vector<uint8_t> rgb(3 * data->grid_x * data->grid_y);
+        for (size_t row = 0; row < data->grid_y; ++row)
+        {
+            for (size_t column = 0; column < data->grid_x; ++column)
+            {
+                const uint8_t* source = &rgba[4 * (column * data->grid_y + (data->grid_y - 1 - row))];
+                std::copy(source, source + 3, &rgb[3 * (row * data->grid_x + column)]);
+            }
+        }
+
+        if (!ImageWriter::encode(format, rgb.data(), data->grid_x, data->grid_y, response.body))
+        { return fail(400, "Неподдерживаемый формат: " + format); }
+        response.content_type = format == "png" ? "image/png" : "image/x-portable-pixmap";
+        response.immutable = true;
+        return response;
+    }
+
+    std::shared_ptr<ReferenceOrbit> TileServer::_reference(const Key& key, mp_bitcnt_t precision)
+    {
+        // Предок на reference_levels уровней выше (не выше нулевого уровня).
+        Key ancestor;
+        ancestor.level = std::max<int64_t>(0, key.level - settings.reference_levels);
+        mp_bitcnt_t shift = static_cast<mp_bitcnt_t>(key.level - ancestor.level);
+        mpz_fdiv_q_2exp(ancestor.x.get_mpz_t(), key.x.get_mpz_t(), shift);
+        mpz_fdiv_q_2exp(ancestor.y.get_mpz_t(), key.y.get_mpz_t(), shift);
+        ancestor.tile_size = 0;
+        ancestor.iterations_limit = key.iterations_limit;
+
+        std::lock_guard<std::mutex> lock_references(mutex_references);
+        for (size_t index = 0; index < references.size(); ++index)
+        {
+            if (references[index].first == ancestor && references[index].second->get_precision() == precision)
+            {
+                // Найденная орбита переносится в конец (последняя использованная).
+                std::pair<Key, std::shared_ptr<ReferenceOrbit>> found = references[index];
+                references.erase(references.begin() + static_cast<std::ptrdiff_t>(index));
+                references.push_back(found);
+                return found.second;
+            }
+        }
+
+        // Центр предка: -2 + (x + 1/2) * 2^(2 - level), 2 - (y + 1/2) * 2^(2 - level).
+        mpf_class center_x(2 * ancestor.x + 1, precision);
+        mpf_class center_y(2 * ancestor.y + 1, precision);
+        for (mpf_class* value : { &center_x, &center_y })
+        {
+            if (ancestor.level >= 1) { mpf_div_2exp(value->get_mpf_t(), value->get_mpf_t(), static_cast<mp_bitcnt_t>(ancestor.level - 1)); }
+            else                     { mpf_mul_2exp(value->get_mpf_t(), value->get_mpf_t(), 1); }
+        }
+        mpf_vector_2d center(mpf_class(center_x - 2, precision), mpf_class(2 - center_y, precision));
+
+        if (references.size() >= references_kept) { references.erase(references.begin()); }
+        references.emplace_back(ancestor, std::make_shared<ReferenceOrbit>(center, precision, key.iterations_limit, mpf_class(settings.max_absolute, precision)));
+        return references.back().second;
+    }
+
+    void TileServer::_trim()
+    {
+        while (statistics.bytes > settings.cache_budget && !entries.empty())
+        {
+            const Entry& oldest = entries.back();
+            statistics.bytes -= oldest.bytes;
+            --statistics.tiles;
+            ++statistics.evictions;
+            index.erase(oldest.key);
+            entries.pop_back();
+        }
+    }
+
+    // PRIVATE:
+}
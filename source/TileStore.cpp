@@ -0,0 +1,189 @@
+#include "TileStore.hpp"
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace alfrac
+{
+    namespace
+    {
+        const char     store_magic[4] = { 'A', 'F', 'T', 'S' };
+        const uint32_t store_version  = 1;
+
+        // Точная запись числа длинной арифметики (шестнадцатеричная мантисса и порядок).
+        std::string exact_string(const mpf_class& value)
+        {
+            mp_exp_t exponent = 0;
+            char* digits = mpf_get_str(nullptr, &exponent, 16, 0, value.get_mpf_t());
+            std::string result = std::string(digits) + "@" + std::to_string(exponent);
+
+            void (*free_function)(void*, size_t) = nullptr;
+            mp_get_memory_functions(nullptr, nullptr, &free_function);
+            free_function(digits, std::strlen(digits) + 1);
+            return result;
+        }
+
+        // 64-битный хэш FNV-1a.
+        uint64_t fnv1a(const std::string& text)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for (unsigned char symbol : text)
+            {
+                hash ^= symbol;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        bool write_all(int descriptor, const void* buffer, size_t size)
+        {
+            const char* position = static_cast<const char*>(buffer);
+            while (size > 0)
+            {
+                ssize_t written = ::write(descriptor, position, size);
+                if (written <= 0) { return false; }
+                position += written;
+                size -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+    }
+
+
+    ////////////////    TileStore    ///////////////
+    // Хранилище обсчитанных регионов фрактала на диске.
+    // PUBLIC:
+    TileStore::TileStore(const std::string& init_directory) : directory{init_directory}
+    {
+        ::mkdir(directory.c_str(), 0755);
+    }
+    TileStore::~TileStore() { }
+
+    bool TileStore::load(const Fractal::Request& request, Fractal::Data& result)
+    {
+        std::string request_key = key(request);
+
+        int descriptor = ::open(_path(request_key).c_str(), O_RDONLY);
+        if (descriptor < 0) { return false; }
+
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header))
+        {
+            ::close(descriptor);
+            return false;
+        }
+        size_t file_size = static_cast<size_t>(status.st_size);
+
+        void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if (mapping == MAP_FAILED) { return false; }
+
+        // Проверка заголовка и ключа: файл с тем же хэшем, но иным ключом, считается отсутствующим.
+        const char* bytes = static_cast<const char*>(mapping);
+        Header header;
+        std::memcpy(&header, bytes, sizeof(Header));
+
+        size_t points = request.grid_x * request.grid_y;
+        size_t smooth_size = request.smooth ? points * sizeof(float) : 0;
+        bool valid = std::memcmp(header.magic, store_magic, sizeof(store_magic)) == 0 && header.version == store_version &&
+                     header.key_size == request_key.size() && header.value_size == IterationTable::width(request.iterations_limit) &&
+                     header.grid_x == request.grid_x && header.grid_y == request.grid_y && header.iterations_limit == request.iterations_limit &&
+                     file_size == sizeof(Header) + header.key_size + points * header.value_size + smooth_size &&
+                     std::memcmp(bytes + sizeof(Header), request_key.data(), request_key.size()) == 0;
+
+        if (valid)
+        {
+            // Формат значений в файле совпадает с несжатой таблицей Fractal::Data::iterations.
+            result = Fractal::Data(request);
+            const char* values = bytes + sizeof(Header) + header.key_size;
+            std::memcpy(result.iterations.raw(), values, points * header.value_size);
+            if (request.smooth) { std::memcpy(result.smooth.data(), values + points * header.value_size, smooth_size); }
+        }
+
+        ::munmap(mapping, file_size);
+        return valid;
+    }
+
+    bool TileStore::save(const Fractal::Request& request, const Fractal::Data& result)
+    {
+        // Сохраняются лишь полностью заполненные таблицы.
+        if (result.stride != 1 || result.iterations.size() != request.grid_x * request.grid_y) { return false; }
+        if (request.smooth && result.smooth.size() != result.iterations.size()) { return false; }
+
+        std::string request_key = key(request);
+
+        Header header;
+        std::memcpy(header.magic, store_magic, sizeof(store_magic));
+        header.version = store_version;
+        header.key_size = static_cast<uint32_t>(request_key.size());
+        header.value_size = IterationTable::width(request.iterations_limit);
+        header.grid_x = request.grid_x;
+        header.grid_y = request.grid_y;
+        header.iterations_limit = request.iterations_limit;
+
+        // Значения записываются в несжатом виде (файл читается через mmap).
+        IterationTable unpacked;
+        const IterationTable* iterations = &result.iterations;
+        if (iterations->compressed() || iterations->width() != header.value_size)
+        {
+            unpacked = IterationTable(iterations->size(), request.iterations_limit);
+            std::vector<int64_t> column(request.grid_y);
+            for (size_t first = 0; first < iterations->size(); first += request.grid_y)
+            {
+                iterations->read(first, request.grid_y, column.data());
+                for (size_t y = 0; y < request.grid_y; ++y) { unpacked.set(first + y, column[y]); }
+            }
+            iterations = &unpacked;
+        }
+
+        // Запись во временный файл и переименование: читатели не видят частично записанных файлов.
+        std::string path = _path(request_key);
+        std::string temporary = path + ".tmp" + std::to_string(::getpid()) + "." + std::to_string(next_temporary.fetch_add(1));
+
+        int descriptor = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (descriptor < 0) { return false; }
+
+        bool written = write_all(descriptor, &header, sizeof(Header)) &&
+                       write_all(descriptor, request_key.data(), request_key.size()) &&
+                       write_all(descriptor, iterations->raw(), iterations->size() * header.value_size) &&
+                       write_all(descriptor, result.smooth.data(), request.smooth ? result.smooth.size() * sizeof(float) : 0);
+        written = (::close(descriptor) == 0) && written;
+
+        if (!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::string TileStore::key(const Fractal::Request& request)
+    {
+        const mpf_rectangle& rectangle = request.rectangle;
+        return std::string(Fractal::formula()) +
+               "|" + std::to_string(request.grid_x) + "x" + std::to_string(request.grid_y) +
+               "|" + std::to_string(request.precision) +
+               "|" + std::to_string(request.iterations_limit) +
+               "|" + exact_string(request.max_absolute) +
+               "|" + exact_string(rectangle.bottom_left.x) + "," + exact_string(rectangle.bottom_left.y) +
+               "|" + exact_string(rectangle.top_right.x) + "," + exact_string(rectangle.top_right.y) +
+               "|" + (request.subdivide ? "subdivide" : "full") +
+               (request.smooth ? "|smooth" : "");
+    }
+
+    const std::string& TileStore::get_directory() const
+    { return directory; }
+
+    // PROTECTED:
+    std::string TileStore::_path(const std::string& request_key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.tile", static_cast<unsigned long long>(fnv1a(request_key)));
+        return directory + "/" + name;
+    }
+
+    // PRIVATE:
+}
@@ -0,0 +1,383 @@
+#include "Vectorized.hpp"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ALFRACTAL_X86
+#include <immintrin.h>
+#endif
+
+namespace alfrac
+{
+    namespace vectorized
+    {
+        namespace
+        {
+            // Группа точек, дополненная до ширины вектора повторением последней точки.
+            template <size_t lanes>
+            struct Group
+            {
+                alignas(64) double constant_x[lanes];
+                alignas(64) double constant_y[lanes];
+                alignas(64) double iterations[lanes];
+                alignas(64) double escape[lanes];  // Квадрат модуля орбиты на последнем шаге, когда точка была в круге.
+
+                alignas(64) double var_x[lanes];   // Состояние орбит (нули при итерировании с начала).
+                alignas(64) double var_y[lanes];
+                alignas(64) double saved_x[lanes];
+                alignas(64) double saved_y[lanes];
+
+                Group(const double* init_x, const double* init_y, size_t count, const State* state, size_t offset)
+                {
+                    for (size_t lane = 0; lane < lanes; ++lane)
+                    {
+                        size_t source = std::min(lane, count - 1);
+                        constant_x[lane] = init_x[source];
+                        constant_y[lane] = init_y[source];
+                        var_x[lane]   = state ? state->var_x[offset + source]   : 0.0;
+                        var_y[lane]   = state ? state->var_y[offset + source]   : 0.0;
+                        saved_x[lane] = state ? state->saved_x[offset + source] : 0.0;
+                        saved_y[lane] = state ? state->saved_y[offset + source] : 0.0;
+                    }
+                }
+
+                void store(int64_t* output, double* escape_output, size_t count) const
+                {
+                    for (size_t lane = 0; lane < count; ++lane)
+                    { output[lane] = static_cast<int64_t>(iterations[lane]); }
+                    if (!escape_output) { return; }
+                    for (size_t lane = 0; lane < count; ++lane)
+                    { escape_output[lane] = escape[lane]; }
+                }
+
+                // Запись состояния орбит; alive - биты точек, не покинувших круг и не признанных периодическими.
+                void store_state(State* state, size_t offset, size_t count, unsigned alive) const
+                {
+                    for (size_t lane = 0; lane < count; ++lane)
+                    {
+                        state->var_x[offset + lane]   = var_x[lane];
+                        state->var_y[offset + lane]   = var_y[lane];
+                        state->saved_x[offset + lane] = saved_x[lane];
+                        state->saved_y[offset + lane] = saved_y[lane];
+                        state->alive[offset + lane]   = static_cast<uint8_t>((alive >> lane) & 1u);
+                    }
+                }
+            };
+
+            // Шаги, на которых запоминается значение орбиты для поиска цикла по Бренту: 0, 1, 3, 7, 15, ...
+            // Цикл длины p обнаруживается, как только промежуток между запоминаниями превысит p.
+            inline bool is_save_step(int64_t step)
+            { return ((step + 1) & step) == 0; }
+
+            // Порядок операций во всех реализациях одинаков и не использует FMA, поэтому результаты совпадают побитово.
+            void escape_time_scalar(const double* constant_x, const double* constant_y, size_t count, int64_t first_step,
+                                    int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, State* state, int64_t* iterations, double* escape)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    double var_x   = state ? state->var_x[i]   : 0.0;
+                    double var_y   = state ? state->var_y[i]   : 0.0;
+                    double saved_x = state ? state->saved_x[i] : 0.0;
+                    double saved_y = state ? state->saved_y[i] : 0.0;
+                    bool alive = true;
+
+                    int64_t step = first_step;
+                    for (; step < iterations_limit; ++step)
+                    {
+                        double sqr_x = var_x * var_x;
+                        double sqr_y = var_y * var_y;
+                        double product = var_x * var_y;
+                        var_x = (sqr_x - sqr_y) + constant_x[i];
+                        var_y = (product + product) + constant_y[i];
+
+                        double sqr_absolute = var_x * var_x + var_y * var_y;
+                        if (sqr_absolute > sqr_max_absolute)
+                        {
+                            if (escape) { escape[i] = sqr_absolute; }
+                            alive = false;
+                            break;
+                        }
+
+                        double delta_x = var_x - saved_x;
+                        double delta_y = var_y - saved_y;
+                        if (delta_x * delta_x + delta_y * delta_y <= sqr_period_tolerance) { step = iterations_limit; alive = false; break; }
+                        if (is_save_step(step)) { saved_x = var_x; saved_y = var_y; }
+                    }
+                    iterations[i] = step;
+
+                    if (state)
+                    {
+                        state->var_x[i]   = var_x;
+                        state->var_y[i]   = var_y;
+                        state->saved_x[i] = saved_x;
+                        state->saved_y[i] = saved_y;
+                        state->alive[i]   = alive;
+                    }
+                }
+            }
+
+            #ifdef ALFRACTAL_X86
+            void escape_time_sse2(const double* constant_x, const double* constant_y, size_t count, int64_t first_step,
+                                  int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, State* state, int64_t* iterations, double* escape)
+            {
+                const size_t lanes = 2;
+                const __m128d bailout = _mm_set1_pd(sqr_max_absolute);
+                const __m128d tolerance = _mm_set1_pd(sqr_period_tolerance);
+                const __m128d limit = _mm_set1_pd(static_cast<double>(iterations_limit));
+                const __m128d one = _mm_set1_pd(1.0);
+
+                for (size_t offset = 0; offset < count; offset += lanes)
+                {
+                    size_t group_count = std::min(lanes, count - offset);
+                    Group<lanes> group(constant_x + offset, constant_y + offset, group_count, state, offset);
+
+                    __m128d c_x = _mm_load_pd(group.constant_x);
+                    __m128d c_y = _mm_load_pd(group.constant_y);
+                    __m128d var_x = _mm_load_pd(group.var_x);
+                    __m128d var_y = _mm_load_pd(group.var_y);
+                    __m128d saved_x = _mm_load_pd(group.saved_x);
+                    __m128d saved_y = _mm_load_pd(group.saved_y);
+                    __m128d counter = _mm_set1_pd(static_cast<double>(first_step));
+                    __m128d active = _mm_castsi128_pd(_mm_set1_epi32(-1));
+                    __m128d periodic = _mm_setzero_pd();
+                    __m128d last = _mm_setzero_pd();
+
+                    for (int64_t step = first_step; step < iterations_limit; ++step)
+                    {
+                        __m128d sqr_x = _mm_mul_pd(var_x, var_x);
+                        __m128d sqr_y = _mm_mul_pd(var_y, var_y);
+                        __m128d product = _mm_mul_pd(var_x, var_y);
+                        var_x = _mm_add_pd(_mm_sub_pd(sqr_x, sqr_y), c_x);
+                        var_y = _mm_add_pd(_mm_add_pd(product, product), c_y);
+
+                        __m128d sqr_absolute = _mm_add_pd(_mm_mul_pd(var_x, var_x), _mm_mul_pd(var_y, var_y));
+                        last = _mm_or_pd(_mm_and_pd(active, sqr_absolute), _mm_andnot_pd(active, last));
+                        active = _mm_andnot_pd(_mm_cmpgt_pd(sqr_absolute, bailout), active);
+
+                        __m128d delta_x = _mm_sub_pd(var_x, saved_x);
+                        __m128d delta_y = _mm_sub_pd(var_y, saved_y);
+                        __m128d sqr_delta = _mm_add_pd(_mm_mul_pd(delta_x, delta_x), _mm_mul_pd(delta_y, delta_y));
+                        __m128d cycled = _mm_and_pd(_mm_cmple_pd(sqr_delta, tolerance), active);
+                        periodic = _mm_or_pd(periodic, cycled);
+                        active = _mm_andnot_pd(cycled, active);
+                        if (is_save_step(step)) { saved_x = var_x; saved_y = var_y; }
+
+                        if (_mm_movemask_pd(active) == 0) { break; }
+                        counter = _mm_add_pd(counter, _mm_and_pd(active, one));
+                    }
+
+                    counter = _mm_or_pd(_mm_and_pd(periodic, limit), _mm_andnot_pd(periodic, counter));
+                    _mm_store_pd(group.iterations, counter);
+                    _mm_store_pd(group.escape, last);
+                    group.store(iterations + offset, escape ? escape + offset : nullptr, group_count);
+                    if (state)
+                    {
+                        _mm_store_pd(group.var_x, var_x);
+                        _mm_store_pd(group.var_y, var_y);
+                        _mm_store_pd(group.saved_x, saved_x);
+                        _mm_store_pd(group.saved_y, saved_y);
+                        group.store_state(state, offset, group_count, static_cast<unsigned>(_mm_movemask_pd(active)));
+                    }
+                }
+            }
+
+            __attribute__((target("avx2")))
+            void escape_time_avx2(const double* constant_x, const double* constant_y, size_t count, int64_t first_step,
+                                  int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, State* state, int64_t* iterations, double* escape)
+            {
+                const size_t lanes = 4;
+                const __m256d bailout = _mm256_set1_pd(sqr_max_absolute);
+                const __m256d tolerance = _mm256_set1_pd(sqr_period_tolerance);
+                const __m256d limit = _mm256_set1_pd(static_cast<double>(iterations_limit));
+                const __m256d one = _mm256_set1_pd(1.0);
+
+                for (size_t offset = 0; offset < count; offset += lanes)
+                {
+                    size_t group_count = std::min(lanes, count - offset);
+                    Group<lanes> group(constant_x + offset, constant_y + offset, group_count, state, offset);
+
+                    __m256d c_x = _mm256_load_pd(group.constant_x);
+                    __m256d c_y = _mm256_load_pd(group.constant_y);
+                    __m256d var_x = _mm256_load_pd(group.var_x);
+                    __m256d var_y = _mm256_load_pd(group.var_y);
+                    __m256d saved_x = _mm256_load_pd(group.saved_x);
+                    __m256d saved_y = _mm256_load_pd(group.saved_y);
+                    __m256d counter = _mm256_set1_pd(static_cast<double>(first_step));
+                    __m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+                    __m256d periodic = _mm256_setzero_pd();
+                    __m256d last = _mm256_setzero_pd();
+
+                    for (int64_t step = first_step; step < iterations_limit; ++step)
+                    {
+                        __m256d sqr_x = _mm256_mul_pd(var_x, var_x);
+                        __m256d sqr_y = _mm256_mul_pd(var_y, var_y);
+                        __m256d product = _mm256_mul_pd(var_x, var_y);
+                        var_x = _mm256_add_pd(_mm256_sub_pd(sqr_x, sqr_y), c_x);
+                        var_y = _mm256_add_pd(_mm256_add_pd(product, product), c_y);
+
+                        __m256d sqr_absolute = _mm256_add_pd(_mm256_mul_pd(var_x, var_x), _mm256_mul_pd(var_y, var_y));
+                        last = _mm256_blendv_pd(last, sqr_absolute, active);
+                        active = _mm256_andnot_pd(_mm256_cmp_pd(sqr_absolute, bailout, _CMP_GT_OQ), active);
+
+                        __m256d delta_x = _mm256_sub_pd(var_x, saved_x);
+                        __m256d delta_y = _mm256_sub_pd(var_y, saved_y);
+                        __m256d sqr_delta = _mm256_add_pd(_mm256_mul_pd(delta_x, delta_x), _mm256_mul_pd(delta_y, delta_y));
+                        __m256d cycled = _mm256_and_pd(_mm256_cmp_pd(sqr_delta, tolerance, _CMP_LE_OQ), active);
+                        periodic = _mm256_or_pd(periodic, cycled);
+                        active = _mm256_andnot_pd(cycled, active);
+                        if (is_save_step(step)) { saved_x = var_x; saved_y = var_y; }
+
+                        if (_mm256_movemask_pd(active) == 0) { break; }
+                        counter = _mm256_add_pd(counter, _mm256_and_pd(active, one));
+                    }
+
+                    counter = _mm256_blendv_pd(counter, limit, periodic);
+                    _mm256_store_pd(group.iterations, counter);
+                    _mm256_store_pd(group.escape, last);
+                    group.store(iterations + offset, escape ? escape + offset : nullptr, group_count);
+                    if (state)
+                    {
+                        _mm256_store_pd(group.var_x, var_x);
+                        _mm256_store_pd(group.var_y, var_y);
+                        _mm256_store_pd(group.saved_x, saved_x);
+                        _mm256_store_pd(group.saved_y, saved_y);
+                        group.store_state(state, offset, group_count, static_cast<unsigned>(_mm256_movemask_pd(active)));
+                    }
+                }
+            }
+
+            __attribute__((target("avx512f")))
+            void escape_time_avx512(const double* constant_x, const double* constant_y, size_t count, int64_t first_step,
+                                    int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, State* state, int64_t* iterations, double* escape)
+            {
+                const size_t lanes = 8;
+                const __m512d bailout = _mm512_set1_pd(sqr_max_absolute);
+                const __m512d tolerance = _mm512_set1_pd(sqr_period_tolerance);
+                const __m512d limit = _mm512_set1_pd(static_cast<double>(iterations_limit));
+                const __m512d one = _mm512_set1_pd(1.0);
+
+                for (size_t offset = 0; offset < count; offset += lanes)
+                {
+                    size_t group_count = std::min(lanes, count - offset);
+                    Group<lanes> group(constant_x + offset, constant_y + offset, group_count, state, offset);
+
+                    __m512d c_x = _mm512_load_pd(group.constant_x);
+                    __m512d c_y = _mm512_load_pd(group.constant_y);
+                    __m512d var_x = _mm512_load_pd(group.var_x);
+                    __m512d var_y = _mm512_load_pd(group.var_y);
+                    __m512d saved_x = _mm512_load_pd(group.saved_x);
+                    __m512d saved_y = _mm512_load_pd(group.saved_y);
+                    __m512d counter = _mm512_set1_pd(static_cast<double>(first_step));
+                    __mmask8 active = 0xFF;
+                    __mmask8 periodic = 0;
+                    __m512d last = _mm512_setzero_pd();
+
+                    for (int64_t step = first_step; step < iterations_limit; ++step)
+                    {
+                        __m512d sqr_x = _mm512_mul_pd(var_x, var_x);
+                        __m512d sqr_y = _mm512_mul_pd(var_y, var_y);
+                        __m512d product = _mm512_mul_pd(var_x, var_y);
+                        var_x = _mm512_add_pd(_mm512_sub_pd(sqr_x, sqr_y), c_x);
+                        var_y = _mm512_add_pd(_mm512_add_pd(product, product), c_y);
+
+                        __m512d sqr_absolute = _mm512_add_pd(_mm512_mul_pd(var_x, var_x), _mm512_mul_pd(var_y, var_y));
+                        last = _mm512_mask_mov_pd(last, active, sqr_absolute);
+                        active = _mm512_mask_cmp_pd_mask(active, sqr_absolute, bailout, _CMP_LE_OQ);
+
+                        __m512d delta_x = _mm512_sub_pd(var_x, saved_x);
+                        __m512d delta_y = _mm512_sub_pd(var_y, saved_y);
+                        __m512d sqr_delta = _mm512_add_pd(_mm512_mul_pd(delta_x, delta_x), _mm512_mul_pd(delta_y, delta_y));
+                        __mmask8 cycled = _mm512_mask_cmp_pd_mask(active, sqr_delta, tolerance, _CMP_LE_OQ);
+                        periodic = periodic | cycled;
+                        active = active & static_cast<__mmask8>(~cycled);
+                        if (is_save_step(step)) { saved_x = var_x; saved_y = var_y; }
+
+                        if (active == 0) { break; }
+                        counter = _mm512_mask_add_pd(counter, active, counter, one);
+                    }
+
+                    counter = _mm512_mask_mov_pd(counter, periodic, limit);
+                    _mm512_store_pd(group.iterations, counter);
+                    _mm512_store_pd(group.escape, last);
+                    group.store(iterations + offset, escape ? escape + offset : nullptr, group_count);
+                    if (state)
+                    {
+                        _mm512_store_pd(group.var_x, var_x);
+                        _mm512_store_pd(group.var_y, var_y);
+                        _mm512_store_pd(group.saved_x, saved_x);
+                        _mm512_store_pd(group.saved_y, saved_y);
+                        group.store_state(state, offset, group_count, static_cast<unsigned>(active));
+                    }
+                }
+            }
+            #endif
+        }
+
+        InstructionSet detect()
+        {
+            #ifdef ALFRACTAL_X86
+            static const InstructionSet detected = []()
+            {
+                __builtin_cpu_init();
+                if (__builtin_cpu_supports("avx512f")) { return InstructionSet::AVX512; }
+                if (__builtin_cpu_supports("avx2"))    { return InstructionSet::AVX2; }
+                if (__builtin_cpu_supports("sse2"))    { return InstructionSet::SSE2; }
+                return InstructionSet::Scalar;
+            }();
+            return detected;
+            #else
+            return InstructionSet::Scalar;
+            #endif
+        }
+
+        const char* name(InstructionSet isa)
+        {
+            switch (isa)
+            {
+                case InstructionSet::SSE2:   { return "sse2"; }
+                case InstructionSet::AVX2:   { return "avx2"; }
+                case InstructionSet::AVX512: { return "avx512"; }
+                default:                     { return "scalar"; }
+            }
+        }
+
+        size_t width(InstructionSet isa)
+        {
+            switch (isa)
+            {
+                case InstructionSet::SSE2:   { return 2; }
+                case InstructionSet::AVX2:   { return 4; }
+                case InstructionSet::AVX512: { return 8; }
+                default:                     { return 1; }
+            }
+        }
+
+        void escape_time(const double* constant_x, const double* constant_y, size_t count,
+                         int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, int64_t* iterations)
+        {
+            escape_time(detect(), constant_x, constant_y, count, iterations_limit, sqr_max_absolute, sqr_period_tolerance, iterations);
+        }
+
+        void escape_time(InstructionSet isa, const double* constant_x, const double* constant_y, size_t count,
+                         int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, int64_t* iterations)
+        {
+            escape_time(isa, constant_x, constant_y, count, 0, iterations_limit, sqr_max_absolute, sqr_period_tolerance, nullptr, iterations);
+        }
+
+        void escape_time(InstructionSet isa, const double* constant_x, const double* constant_y, size_t count, int64_t first_step,
+                         int64_t iterations_limit, double sqr_max_absolute, double sqr_period_tolerance, State* state, int64_t* iterations,
+                         double* escape)
+        {
+            if (count == 0) { return; }
+
+            switch (isa)
+            {
+                #ifdef ALFRACTAL_X86
+                case InstructionSet::AVX512: { escape_time_avx512(constant_x, constant_y, count, first_step, iterations_limit, sqr_max_absolute, sqr_period_tolerance, state, iterations, escape); break; }
+                case InstructionSet::AVX2:   { escape_time_avx2(constant_x, constant_y, count, first_step, iterations_limit, sqr_max_absolute, sqr_period_tolerance, state, iterations, escape); break; }
+                case InstructionSet::SSE2:   { escape_time_sse2(constant_x, constant_y, count, first_step, iterations_limit, sqr_max_absolute, sqr_period_tolerance, state, iterations, escape); break; }
+                #endif
+                default:                     { escape_time_scalar(constant_x, constant_y, count, first_step, iterations_limit, sqr_max_absolute, sqr_period_tolerance, state, iterations, escape); break; }
+            }
+        }
+    }
+}
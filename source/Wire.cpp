@@ -0,0 +1,355 @@
+#include "Wire.hpp"
+#include "Perturbation.hpp"
+#include <cstring>
+#include <cstdlib>
+
+namespace alfrac
+{
+    namespace wire
+    {
+        namespace
+        {
+            // Ограничения на числа длинной арифметики из полученных данных (защита от повреждённых данных).
+            const mp_bitcnt_t max_precision = mp_bitcnt_t(1) << 24;
+            const int64_t max_exponent = int64_t(1) << 40;
+
+            const uint8_t flag_present = 1;
+
+            // Присвоение с точностью значения (обычное присвоение mpf_class округляет до точности приёмника).
+            void assign_exact(mpf_class& target, const mpf_class& value)
+            {
+                target.set_prec(value.get_prec());
+                target = value;
+            }
+        }
+
+
+        ////////////////     Writer      ///////////////
+        // Запись в буфер.
+        // PUBLIC:
+        void Writer::put_u8(uint8_t value)
+        { bytes.push_back(value); }
+        void Writer::put_u32(uint32_t value)
+        {
+            for (int byte = 0; byte < 4; ++byte) { bytes.push_back(static_cast<uint8_t>(value >> (8 * byte))); }
+        }
+        void Writer::put_u64(uint64_t value)
+        {
+            for (int byte = 0; byte < 8; ++byte) { bytes.push_back(static_cast<uint8_t>(value >> (8 * byte))); }
+        }
+        void Writer::put_i64(int64_t value)
+        { put_u64(static_cast<uint64_t>(value)); }
+        void Writer::put_f32(float value)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put_u32(bits);
+        }
+        void Writer::put_f64(double value)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put_u64(bits);
+        }
+        void Writer::put_bytes(const void* data, size_t size)
+        {
+            const uint8_t* begin = static_cast<const uint8_t*>(data);
+            bytes.insert(bytes.end(), begin, begin + size);
+        }
+        void Writer::put_string(const std::string& value)
+        {
+            put_u64(value.size());
+            put_bytes(value.data(), value.size());
+        }
+
+        void Writer::put_mpf(const mpf_class& value)
+        {
+            // Значение - мантисса (целое из limbs числа), умноженная на 2^exponent: запись не зависит от размера limb.
+            mpf_srcptr number = value.get_mpf_t();
+            size_t limbs = static_cast<size_t>(std::abs(number->_mp_size));
+            mpz_class mantissa;
+            mpz_import(mantissa.get_mpz_t(), limbs, -1, sizeof(mp_limb_t), 0, 0, number->_mp_d);
+            int64_t exponent = (static_cast<int64_t>(number->_mp_exp) - static_cast<int64_t>(limbs)) * GMP_NUMB_BITS;
+
+            std::vector<uint8_t> magnitude((mpz_sizeinbase(mantissa.get_mpz_t(), 2) + 7) / 8);
+            size_t written = 0;
+            if (limbs > 0) { mpz_export(magnitude.data(), &written, -1, 1, -1, 0, mantissa.get_mpz_t()); }
+
+            put_u64(value.get_prec());
+            put_u8(number->_mp_size < 0 ? 1 : 0);
+            put_i64(exponent);
+            put_u64(written);
+            put_bytes(magnitude.data(), written);
+        }
+
+        const std::vector<uint8_t>& Writer::get_bytes() const
+        { return bytes; }
+        std::vector<uint8_t>& Writer::get_bytes()
+        { return bytes; }
+
+        // PROTECTED:
+
+        // PRIVATE:
+
+
+
+        ////////////////     Reader      ///////////////
+        // Чтение из буфера.
+        // PUBLIC:
+        Reader::Reader(const uint8_t* init_position, size_t size) : position{init_position}, end{init_position + size} { }
+
+        uint8_t Reader::get_u8()
+        {
+            const uint8_t* data = _take(1);
+            return data ? data[0] : 0;
+        }
+        uint32_t Reader::get_u32()
+        {
+            const uint8_t* data = _take(4);
+            uint32_t value = 0;
+            for (int byte = 0; data && byte < 4; ++byte) { value |= static_cast<uint32_t>(data[byte]) << (8 * byte); }
+            return value;
+        }
+        uint64_t Reader::get_u64()
+        {
+            const uint8_t* data = _take(8);
+            uint64_t value = 0;
+            for (int byte = 0; data && byte < 8; ++byte) { value |= static_cast<uint64_t>(data[byte]) << (8 * byte); }
+            return value;
+        }
+        int64_t Reader::get_i64()
+        { return static_cast<int64_t>(get_u64()); }
+        float Reader::get_f32()
+        {
+            uint32_t bits = get_u32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        double Reader::get_f64()
+        {
+            uint64_t bits = get_u64();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        bool Reader::get_bytes(void* data, size_t size)
+        {
+            const uint8_t* source = _take(size);
+            if (source && size > 0) { std::memcpy(data, source, size); }
+            return source != nullptr;
+        }
+        std::string Reader::get_string()
+        {
+            std::string value(get_count(1), '\0');
+            get_bytes(&value[0], value.size());
+            return value;
+        }
+
+        mpf_class Reader::get_mpf()
+        {
+            mp_bitcnt_t precision = get_u64();
+            bool negative = get_u8() != 0;
+            int64_t exponent = get_i64();
+            std::vector<uint8_t> magnitude(get_count(1));
+            get_bytes(magnitude.data(), magnitude.size());
+            if (precision > max_precision || magnitude.size() * 8 > max_precision || exponent > max_exponent || exponent < -max_exponent) { fail(); }
+            if (failed()) { return mpf_class(0.0); }
+
+            // Точность не меньше длины мантиссы: значение восстанавливается без округления.
+            mpz_class mantissa;
+            mpz_import(mantissa.get_mpz_t(), magnitude.size(), -1, 1, -1, 0, magnitude.data());
+            mpf_class value(0, std::max<mp_bitcnt_t>(precision, 8 * magnitude.size()));
+            mpf_set_z(value.get_mpf_t(), mantissa.get_mpz_t());
+            if (exponent >= 0) { mpf_mul_2exp(value.get_mpf_t(), value.get_mpf_t(), static_cast<mp_bitcnt_t>(exponent)); }
+            else               { mpf_div_2exp(value.get_mpf_t(), value.get_mpf_t(), static_cast<mp_bitcnt_t>(-exponent)); }
+            if (negative) { mpf_neg(value.get_mpf_t(), value.get_mpf_t()); }
+            return value;
+        }
+
+        size_t Reader::get_count(size_t element_size)
+        {
+            uint64_t count = get_u64();
+            if (count > remaining() / std::max<size_t>(1, element_size)) { fail(); }
+            return failed() ? 0 : static_cast<size_t>(count);
+        }
+
+        void Reader::fail()
+        {
+            is_failed = true;
+            position = end;
+        }
+        bool Reader::failed() const
+        { return is_failed; }
+        size_t Reader::remaining() const
+        { return static_cast<size_t>(end - position); }
+
+        // PROTECTED:
+        const uint8_t* Reader::_take(size_t size)
+        {
+            if (is_failed || size > remaining())
+            {
+                fail();
+                return nullptr;
+            }
+            const uint8_t* data = position;
+            position += size;
+            return data;
+        }
+
+        // PRIVATE:
+
+
+
+        ////////////////    Functions    ///////////////
+        void write_request(Writer& writer, const Fractal::Request& request)
+        {
+            writer.put_mpf(request.rectangle.bottom_left.x);
+            writer.put_mpf(request.rectangle.bottom_left.y);
+            writer.put_mpf(request.rectangle.top_right.x);
+            writer.put_mpf(request.rectangle.top_right.y);
+            writer.put_u64(request.grid_x);
+            writer.put_u64(request.grid_y);
+            writer.put_u64(request.precision);
+            writer.put_i64(request.iterations_limit);
+            writer.put_mpf(request.max_absolute);
+
+            writer.put_u8(request.reference ? flag_present : 0);
+            if (request.reference)
+            {
+                writer.put_mpf(request.reference->get_center().x);
+                writer.put_mpf(request.reference->get_center().y);
+                writer.put_u64(request.reference->get_precision());
+                writer.put_i64(request.reference->get_iterations_limit());
+                writer.put_mpf(request.reference->get_max_absolute());
+            }
+
+            writer.put_u8(request.subdivide ? 1 : 0);
+            writer.put_u8(request.smooth ? 1 : 0);
+            writer.put_u8(request.keep_orbits ? 1 : 0);
+            writer.put_u8(request.resume ? flag_present : 0);
+            if (request.resume) { write_data(writer, *request.resume); }
+            writer.put_f64(request.priority);
+        }
+
+        bool read_request(Reader& reader, Fractal::Request& request, const ReferenceFactory& make_reference)
+        {
+            assign_exact(request.rectangle.bottom_left.x, reader.get_mpf());
+            assign_exact(request.rectangle.bottom_left.y, reader.get_mpf());
+            assign_exact(request.rectangle.top_right.x, reader.get_mpf());
+            assign_exact(request.rectangle.top_right.y, reader.get_mpf());
+            request.grid_x = reader.get_u64();
+            request.grid_y = reader.get_u64();
+            request.precision = reader.get_u64();
+            request.iterations_limit = reader.get_i64();
+            assign_exact(request.max_absolute, reader.get_mpf());
+            if (request.grid_x == 0 || request.grid_y == 0 || request.grid_x > (size_t(1) << 16) || request.grid_y > (size_t(1) << 16) ||
+                request.precision > max_precision || request.iterations_limit < 1)
+            { reader.fail(); }
+
+            request.reference.reset();
+            if (reader.get_u8() == flag_present)
+            {
+                mpf_class center_x = reader.get_mpf();
+                mpf_class center_y = reader.get_mpf();
+                mpf_vector_2d center(center_x, center_y);
+                mp_bitcnt_t precision = reader.get_u64();
+                int64_t iterations_limit = reader.get_i64();
+                mpf_class max_absolute = reader.get_mpf();
+                if (precision > max_precision || iterations_limit < 1) { reader.fail(); }
+                if (reader.failed()) { return false; }
+
+                request.reference = make_reference ? make_reference(center, precision, iterations_limit, max_absolute)
+                                                   : std::make_shared<ReferenceOrbit>(center, precision, iterations_limit, max_absolute);
+            }
+
+            request.subdivide = reader.get_u8() != 0;
+            request.smooth = reader.get_u8() != 0;
+            request.keep_orbits = reader.get_u8() != 0;
+            request.resume.reset();
+            if (reader.get_u8() == flag_present)
+            {
+                std::shared_ptr<Fractal::Data> resume = std::make_shared<Fractal::Data>();
+                if (!read_data(reader, *resume)) { return false; }
+                request.resume = std::move(resume);
+            }
+            request.priority = reader.get_f64();
+
+            request.progress.reset();
+            request.cancelled.reset();
+            request.notify = nullptr;
+            return !reader.failed();
+        }
+
+        void write_data(Writer& writer, const Fractal::Data& data)
+        {
+            writer.put_u64(data.grid_x);
+            writer.put_u64(data.grid_y);
+            writer.put_i64(data.iterations_limit);
+            writer.put_u64(data.stride);
+            data.iterations.save(writer);
+
+            writer.put_u64(data.smooth.size());
+            for (float value : data.smooth) { writer.put_f32(value); }
+
+            writer.put_u8(data.orbits ? flag_present : 0);
+            if (data.orbits)
+            {
+                const Fractal::Orbits& orbits = *data.orbits;
+                writer.put_u8(static_cast<uint8_t>(orbits.tier));
+                writer.put_u64(orbits.precision);
+                writer.put_mpf(orbits.reference_center.x);
+                writer.put_mpf(orbits.reference_center.y);
+                writer.put_u64(orbits.state_size);
+                writer.put_u64(orbits.slots.size());
+                for (uint32_t slot : orbits.slots) { writer.put_u32(slot); }
+                writer.put_u64(orbits.values.size());
+                for (double value : orbits.values) { writer.put_f64(value); }
+                writer.put_u64(orbits.mpf_values.size());
+                for (const mpf_class& value : orbits.mpf_values) { writer.put_mpf(value); }
+            }
+        }
+
+        bool read_data(Reader& reader, Fractal::Data& data)
+        {
+            data.grid_x = reader.get_u64();
+            data.grid_y = reader.get_u64();
+            data.iterations_limit = reader.get_i64();
+            data.stride = reader.get_u64();
+            if (!data.iterations.load(reader)) { return false; }
+            if (data.grid_x > (size_t(1) << 16) || data.grid_y > (size_t(1) << 16) || data.iterations.size() != data.grid_x * data.grid_y ||
+                data.stride == 0)
+            { reader.fail(); }
+
+            data.smooth.resize(reader.get_count(sizeof(float)));
+            for (float& value : data.smooth) { value = reader.get_f32(); }
+            if (!data.smooth.empty() && data.smooth.size() != data.iterations.size()) { reader.fail(); }
+
+            data.orbits.reset();
+            if (reader.get_u8() == flag_present)
+            {
+                std::shared_ptr<Fractal::Orbits> orbits = std::make_shared<Fractal::Orbits>();
+                uint8_t tier = reader.get_u8();
+                if (tier > static_cast<uint8_t>(Fractal::Tier::Mpf)) { reader.fail(); }
+                orbits->tier = static_cast<Fractal::Tier>(tier);
+                orbits->precision = reader.get_u64();
+                assign_exact(orbits->reference_center.x, reader.get_mpf());
+                assign_exact(orbits->reference_center.y, reader.get_mpf());
+                orbits->state_size = reader.get_u64();
+                orbits->slots.resize(reader.get_count(sizeof(uint32_t)));
+                for (uint32_t& slot : orbits->slots) { slot = reader.get_u32(); }
+                orbits->values.resize(reader.get_count(sizeof(double)));
+                for (double& value : orbits->values) { value = reader.get_f64(); }
+                orbits->mpf_values.resize(reader.get_count(1));
+                for (mpf_class& value : orbits->mpf_values) { assign_exact(value, reader.get_mpf()); }
+
+                // Состояния должны соответствовать ядру своего уровня и сетке: продолжение расчёта
+                // обращается к ним по номерам без проверок.
+                if (reader.failed() || !orbits->is_consistent(data.grid_x * data.grid_y, Fractal::state_size(orbits->tier)))
+                { reader.fail(); }
+                data.orbits = std::move(orbits);
+            }
+            return !reader.failed();
+        }
+    }
+}
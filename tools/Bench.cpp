@@ -0,0 +1,270 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <chrono>
+#include <thread>
+#include <cinttypes>
+#include <cstdio>
+#include <cmath>
+#include <gmpxx.h>
+#include "Algebra.hpp"
+#include "DoubleDouble.hpp"
+#include "Fractal.hpp"
+#include "Perturbation.hpp"
+#include "Vectorized.hpp"
+#include "Arguments.hpp"
+
+// Замеры производительности на фиксированных сценах; результат выводится в формате JSON для сравнения сборок.
+// Пример: AlFractalBench --min-time 1 -o before.json
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const char* usage = "Использование: AlFractalBench [--min-time СЕКУНДЫ] [--filter ПОДСТРОКА] [-j N] [-o ФАЙЛ|-]\n";
+
+    // Точка сцен: вне множества вблизи перешейка между кардиоидой и кругом периода 2, орбита уходит примерно за 1000 итераций.
+    const char* scene_x = "-0.75";
+    const char* scene_y = "0.003";
+
+    // Сцена обсчёта: сетка grid x grid с шагом, при котором требуется precision бит.
+    struct Scene
+    {
+        const char* name;
+        mp_bitcnt_t precision;
+        size_t grid;
+        int64_t iterations_limit;
+        bool perturbation; // Задавать ли опорную орбиту (метод возмущений применим лишь при шаге сетки не меньше 2^-960).
+    };
+
+    const Scene scenes[] =
+    {
+        { "double-53-256",           53,   64, 256,  false },
+        { "double-53-2048",          53,   64, 2048, false },
+        { "double_double-106-256",   106,  64, 256,  false },
+        { "double_double-106-2048",  106,  64, 2048, false },
+        { "mpf-128-256",             128,  32, 256,  false },
+        { "mpf-128-2048",            128,  32, 2048, false },
+        { "mpf-1024-256",            1024, 16, 256,  false },
+        { "mpf-1024-2048",           1024, 16, 2048, false },
+        { "mpf-4096-256",            4096, 8,  256,  false },
+        { "mpf-4096-2048",           4096, 8,  2048, false },
+        { "perturbation-512-256",    512,  64, 256,  true  },
+        { "perturbation-512-2048",   512,  64, 2048, true  },
+    };
+
+    // Запас, вычитаемый Fractal::required_precision() (см. Fractal.cpp), и двоичный логарифм max_absolute.
+    const long precision_guard_bits = 12;
+    const long log2_max_absolute = 2;
+
+    const char* tier_name(alfrac::Fractal::Tier tier)
+    {
+        switch (tier)
+        {
+            case alfrac::Fractal::Tier::Double:       return "Double";
+            case alfrac::Fractal::Tier::DoubleDouble: return "DoubleDouble";
+            case alfrac::Fractal::Tier::Perturbation: return "Perturbation";
+            case alfrac::Fractal::Tier::Mpf:          return "Mpf";
+        }
+        return "Unknown";
+    }
+
+    double seconds_since(Clock::time_point start)
+    { return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+    // Запрос сцены: шаг сетки 2^(log2_max_absolute + guard - precision), так что required_precision() равна precision.
+    alfrac::Fractal::Request make_request(const Scene& scene)
+    {
+        mp_bitcnt_t coordinate_precision = scene.precision + 64;
+        mpf_class step(1, coordinate_precision);
+        mpf_div_2exp(step.get_mpf_t(), step.get_mpf_t(), scene.precision - precision_guard_bits - log2_max_absolute);
+        mpf_class half(step * static_cast<unsigned long>(scene.grid) / 2u, coordinate_precision);
+        mpf_class center_x(scene_x, coordinate_precision);
+        mpf_class center_y(scene_y, coordinate_precision);
+
+        alfrac::Fractal::Request request;
+        request.rectangle = alfrac::mpf_rectangle(mpf_class(center_x - half, coordinate_precision), mpf_class(center_y - half, coordinate_precision),
+                                                  mpf_class(center_x + half, coordinate_precision), mpf_class(center_y + half, coordinate_precision));
+        request.grid_x = scene.grid;
+        request.grid_y = scene.grid;
+        request.precision = coordinate_precision;
+        request.iterations_limit = scene.iterations_limit;
+        request.max_absolute = mpf_class(4.0, coordinate_precision);
+        if (scene.perturbation)
+        {
+            request.reference = std::make_shared<alfrac::ReferenceOrbit>(alfrac::mpf_vector_2d(center_x, center_y), coordinate_precision,
+                                                                         scene.iterations_limit, request.max_absolute);
+            request.reference->length(); // Орбита считается до замера.
+        }
+        return request;
+    }
+
+    // Умножение на элемент единичного модуля: значение не растёт и не убывает, цепочка зависимостей не сокращается компилятором.
+    template <class Element>
+    double multiply_loop(Element& value, const Element& rotation, double min_time, uint64_t& operations)
+    {
+        Clock::time_point start = Clock::now();
+        operations = 0;
+        double elapsed = 0.0;
+        while (elapsed < min_time)
+        {
+            for (size_t i = 0; i < 1024; ++i) { value *= rotation; }
+            operations += 1024;
+            elapsed = seconds_since(start);
+        }
+        return elapsed;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    double min_time = 0.5; // Наименьшая длительность замера в секундах.
+    std::string filter;    // Подстрока имени: выполняются лишь совпадающие замеры.
+    size_t workers_number = 0;
+    std::string output = "-";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = true;
+        if (argument == "--min-time" && has_value)                      { valid = alfrac::arguments::parse(argv[++i], min_time, 1e-3, 3600.0); }
+        else if (argument == "--filter" && has_value)                   { filter = argv[++i]; }
+        else if ((argument == "-j" || argument == "--workers") && has_value) { valid = alfrac::arguments::parse(argv[++i], workers_number, 0, alfrac::arguments::max_workers); }
+        else if ((argument == "-o" || argument == "--output") && has_value)  { output = argv[++i]; }
+        else
+        {
+            std::cerr << "Неизвестный ключ: " << argument << std::endl << usage;
+            return 1;
+        }
+        if (!valid)
+        {
+            std::cerr << "Некорректное значение ключа " << argument << "." << std::endl << usage;
+            return 1;
+        }
+    }
+
+    std::FILE* file = output == "-" ? stdout : std::fopen(output.c_str(), "w");
+    if (!file)
+    {
+        std::cerr << "Не удалось открыть " << output << "." << std::endl;
+        return 1;
+    }
+    auto selected = [&filter](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+
+    std::fprintf(file, "{\n  \"version\": 2,\n");
+    std::fprintf(file, "  \"environment\": { \"compiler\": \"%s\", \"gmp\": \"%s\", \"isa\": \"%s\", \"hardware_threads\": %u, \"min_time\": %g },\n",
+                 __VERSION__, gmp_version, alfrac::vectorized::name(alfrac::vectorized::detect()), std::thread::hardware_concurrency(), min_time);
+
+    // Обсчёт сцен в текущем потоке.
+    alfrac::Fractal fractal(1);
+    std::fprintf(file, "  \"fractal\": [");
+    bool first = true;
+    for (const Scene& scene : scenes)
+    {
+        if (!selected(std::string("fractal/") + scene.name)) { continue; }
+        std::cerr << "fractal/" << scene.name << std::endl;
+
+        alfrac::Fractal::Request request = make_request(scene);
+        uint64_t runs = 0;
+        uint64_t iterations = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        while (elapsed < min_time || runs == 0)
+        {
+            alfrac::Fractal::Data data = fractal.calculate(request);
+            for (size_t index = 0; index < data.iterations.size(); ++index) { iterations += static_cast<uint64_t>(data.iterations.get(index)); }
+            ++runs;
+            elapsed = seconds_since(start);
+        }
+        double pixels = static_cast<double>(runs * scene.grid * scene.grid);
+
+        // Итерации точек, признанных внутренними досрочно, засчитываются по пределу: это не число выполненных итераций,
+        // а равноценное ему без досрочного выхода.
+        std::fprintf(file, "%s\n    { \"name\": \"%s\", \"tier\": \"%s\", \"precision\": %lu, \"grid\": %zu, \"iterations_limit\": %" PRId64
+                           ", \"runs\": %" PRIu64 ", \"seconds\": %.6g, \"pixels_per_second\": %.6g, \"limit_equivalent_iterations_per_second\": %.6g }",
+                     first ? "" : ",", scene.name, tier_name(alfrac::Fractal::choose_tier(request)), static_cast<unsigned long>(alfrac::Fractal::required_precision(request)),
+                     scene.grid, scene.iterations_limit, runs, elapsed, pixels / elapsed, static_cast<double>(iterations) / elapsed);
+        first = false;
+    }
+    std::fprintf(file, "\n  ],\n");
+
+    // Умножение элементов алгебры.
+    std::fprintf(file, "  \"algebra\": [");
+    first = true;
+    const double angle = 0.1;
+    auto report_algebra = [&](const char* name, unsigned long precision, uint64_t operations, double elapsed, double check)
+    {
+        std::fprintf(file, "%s\n    { \"name\": \"%s\", \"precision\": %lu, \"operations\": %" PRIu64 ", \"seconds\": %.6g, \"ns_per_operation\": %.6g, \"check\": %.6g }",
+                     first ? "" : ",", name, precision, operations, elapsed, 1e9 * elapsed / static_cast<double>(operations), check);
+        first = false;
+    };
+    if (selected("algebra/double"))
+    {
+        std::cerr << "algebra/double" << std::endl;
+        alfrac::alg_double value(std::array<double, 2>{ 1.0, 0.0 });
+        alfrac::alg_double rotation(std::array<double, 2>{ std::cos(angle), std::sin(angle) });
+        uint64_t operations;
+        double elapsed = multiply_loop(value, rotation, min_time, operations);
+        report_algebra("double", 53, operations, elapsed, value.components[0]);
+    }
+    if (selected("algebra/double_double"))
+    {
+        std::cerr << "algebra/double_double" << std::endl;
+        alfrac::alg_dd value(std::array<algebra::DoubleDouble, 2>{ algebra::DoubleDouble(1.0), algebra::DoubleDouble(0.0) });
+        alfrac::alg_dd rotation(std::array<algebra::DoubleDouble, 2>{ algebra::DoubleDouble(std::cos(angle)), algebra::DoubleDouble(std::sin(angle)) });
+        uint64_t operations;
+        double elapsed = multiply_loop(value, rotation, min_time, operations);
+        report_algebra("double_double", 106, operations, elapsed, static_cast<double>(value.components[0]));
+    }
+    for (unsigned long precision : { 128ul, 1024ul, 4096ul })
+    {
+        std::string name = "mpf-" + std::to_string(precision);
+        if (!selected("algebra/" + name)) { continue; }
+        std::cerr << "algebra/" << name << std::endl;
+
+        alfrac::alg_mpf value(std::array<mpf_class, 2>{ mpf_class(1.0, precision), mpf_class(0.0, precision) });
+        alfrac::alg_mpf rotation(std::array<mpf_class, 2>{ mpf_class(std::cos(angle), precision), mpf_class(std::sin(angle), precision) });
+        uint64_t operations;
+        double elapsed = multiply_loop(value, rotation, min_time, operations);
+        report_algebra(name.c_str(), precision, operations, elapsed, value.components[0].get_d());
+    }
+    std::fprintf(file, "\n  ],\n");
+
+    // Пропускная способность очереди запросов: много мелких запросов через request_calc().
+    std::fprintf(file, "  \"scheduler\": [");
+    if (selected("scheduler/request_calc"))
+    {
+        std::cerr << "scheduler/request_calc" << std::endl;
+        alfrac::Fractal scheduled(workers_number);
+        Scene tiny = { "request_calc", 53, 8, 64, false };
+        alfrac::Fractal::Request request = make_request(tiny);
+
+        uint64_t requests = 0;
+        Clock::time_point start = Clock::now();
+        double elapsed = 0.0;
+        std::vector<std::future<alfrac::Fractal::Data>> futures(256);
+        while (elapsed < min_time || requests == 0)
+        {
+            for (size_t i = 0; i < futures.size(); ++i)
+            {
+                request.priority = static_cast<double>(i);
+                futures[i] = scheduled.request_calc(request);
+            }
+            for (std::future<alfrac::Fractal::Data>& future : futures) { future.get(); }
+            requests += futures.size();
+            elapsed = seconds_since(start);
+        }
+        scheduled.terminate_loops();
+
+        std::fprintf(file, "\n    { \"name\": \"request_calc\", \"workers\": %zu, \"grid\": %zu, \"iterations_limit\": %" PRId64 ", \"requests\": %" PRIu64
+                           ", \"seconds\": %.6g, \"requests_per_second\": %.6g }",
+                     scheduled.get_workers_number(), tiny.grid, tiny.iterations_limit, requests, elapsed, static_cast<double>(requests) / elapsed);
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+
+    fractal.terminate_loops();
+    if (file != stdout) { std::fclose(file); }
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cinttypes>
+#include <algorithm>
+#include <gmpxx.h>
+#include "Fractal.hpp"
+#include "Distributed.hpp"
+#include "Renderer.hpp"
+#include "ImageWriter.hpp"
+#include "Instrumentation.hpp"
+#include "Arguments.hpp"
+
+namespace
+{
+    const char* usage =
+        "Использование: AlFractalRender [--center X Y] [--zoom Z] [--size ШИРИНА ВЫСОТА] [--iterations N] [--precision БИТ] [--tile N]\n"
+        "                               [-j N] [--remote АДРЕСА] [-o ФАЙЛ] [--trace ФАЙЛ] [--smooth] [--palette ИМЯ]\n";
+}
+
+// Обсчёт изображения без графического интерфейса и дисплея.
+// Пример: AlFractalRender --center -0.75 0.1 --zoom 1e6 --size 16384 16384 --iterations 4096 --smooth --palette ocean -o zoom.png
+int main(int argc, char* argv[])
+{
+    std::string center_x = "-0.5";
+    std::string center_y = "0.0";
+    std::string zoom = "1";          // Приближение: ширина изображения равна 4 / zoom.
+    size_t workers_number = 0;
+    std::string remote_addresses; // Адреса вычислителей AlFractalWorker через запятую (--remote; по умолчанию обсчёт местный).
+    std::string output = "render.png";
+    std::string trace_path; // Файл трассировки обсчёта (Chrome trace event).
+    alfrac::Renderer::View view;
+    view.image_width  = 1920;
+    view.image_height = 1080;
+    view.iterations_limit = 256;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = true;
+        if (argument == "--center" && i + 2 < argc)                     { center_x = argv[++i]; center_y = argv[++i]; }
+        else if (argument == "--zoom" && has_value)                     { zoom = argv[++i]; }
+        else if (argument == "--size" && i + 2 < argc)                  { valid = alfrac::arguments::parse(argv[++i], view.image_width, 1) && alfrac::arguments::parse(argv[++i], view.image_height, 1); }
+        else if (argument == "--iterations" && has_value)               { valid = alfrac::arguments::parse(argv[++i], view.iterations_limit, 1); }
+        else if (argument == "--precision" && has_value)                { valid = alfrac::arguments::parse(argv[++i], view.precision); }
+        else if (argument == "--tile" && has_value)                     { valid = alfrac::arguments::parse(argv[++i], view.tile_size, 1); }
+        else if ((argument == "-j" || argument == "--workers") && has_value) { valid = alfrac::arguments::parse(argv[++i], workers_number, 0, alfrac::arguments::max_workers); }
+        else if (argument == "--remote" && has_value)                   { remote_addresses = argv[++i]; }
+        else if ((argument == "-o" || argument == "--output") && has_value)  { output = argv[++i]; }
+        else if (argument == "--trace" && has_value)                    { trace_path = argv[++i]; }
+        else if (argument == "--smooth")                                { view.smooth = true; }
+        else if (argument == "--palette" && has_value)
+        {
+            const alfrac::Palette* palette = alfrac::Palette::find(argv[++i]);
+            if (!palette)
+            {
+                std::cerr << "Неизвестная палитра: " << argv[i] << std::endl;
+                return 1;
+            }
+            view.palette = *palette;
+        }
+        else
+        {
+            std::cerr << "Неизвестный ключ: " << argument << std::endl << usage;
+            return 1;
+        }
+        if (!valid)
+        {
+            std::cerr << "Некорректное значение ключа " << argument << "." << std::endl << usage;
+            return 1;
+        }
+    }
+
+    // Координаты задаются строками, чтобы не терять точность глубоких приближений.
+    mp_bitcnt_t parse_precision = std::max<mp_bitcnt_t>(view.precision, 64 + 4 * static_cast<mp_bitcnt_t>(std::max(center_x.size(), center_y.size()) + zoom.size()));
+    mpf_class zoom_value(zoom, parse_precision);
+    view.center = alfrac::mpf_vector_2d(mpf_class(center_x, parse_precision), mpf_class(center_y, parse_precision));
+    view.width = mpf_class(4.0 / zoom_value, parse_precision);
+
+    std::unique_ptr<alfrac::ImageWriter> writer = alfrac::ImageWriter::open(output, view.image_width, view.image_height);
+    if (!writer)
+    {
+        std::cerr << "Не удалось открыть " << output << " (поддерживаются .ppm и .png)." << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<alfrac::Fractal> fractal = std::make_shared<alfrac::Fractal>(workers_number);
+    if (!remote_addresses.empty())
+    { fractal->set_remote(std::make_shared<alfrac::Coordinator>(remote_addresses)); }
+    std::shared_ptr<alfrac::Instrumentation> instrumentation;
+    if (!trace_path.empty())
+    {
+        instrumentation = std::make_shared<alfrac::Instrumentation>();
+        instrumentation->set_tracing(true);
+        fractal->set_instrumentation(instrumentation);
+    }
+    alfrac::Renderer renderer(fractal);
+    std::cerr << "Точность координат: " << (view.precision ? view.precision : alfrac::Renderer::coordinate_precision(view)) << " бит." << std::endl;
+
+    bool rendered = renderer.render(view, [&writer, &view](const uint8_t* rgb, size_t row)
+    {
+        if ((row + 1) % view.tile_size == 0 || row + 1 == view.image_height)
+        { std::cerr << "\rСтрок: " << row + 1 << " / " << view.image_height << std::flush; }
+        return writer->write_row(rgb);
+    });
+    std::cerr << std::endl;
+
+    fractal->terminate_loops();
+    if (!rendered || !writer->finish())
+    {
+        std::cerr << "Ошибка записи " << output << "." << std::endl;
+        return 1;
+    }
+    if (instrumentation)
+    {
+        alfrac::Instrumentation::Snapshot snapshot = instrumentation->get_snapshot();
+        std::cerr << "Запросов: " << snapshot.tasks << ", ожидание в очереди: " << 1e-9 * static_cast<double>(snapshot.queue_wait_ns)
+                  << " с, обсчёт: " << 1e-9 * static_cast<double>(snapshot.compute_ns) << " с, итераций (по пределу): " << snapshot.limit_equivalent_iterations << "." << std::endl;
+        if (!instrumentation->export_trace(trace_path))
+        {
+            std::cerr << "Не удалось записать трассировку в " << trace_path << "." << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cinttypes>
+#include "Fractal.hpp"
+#include "TileStore.hpp"
+#include "Distributed.hpp"
+#include "TileServer.hpp"
+#include "Arguments.hpp"
+
+namespace
+{
+    const char* usage =
+        "Использование: AlFractalServer --listen АДРЕС [-j N] [--cache МиБ] [--max-iterations N] [--tile-store ДИРЕКТОРИЯ] [--remote АДРЕСА]\n";
+}
+
+// Сервер тайлов для многих клиентов (браузерных интерфейсов и других программ) с общим кэшем.
+// Пример: AlFractalServer --listen 127.0.0.1:8080 --cache 2048 --tile-store ~/.alfractal/tiles
+//         (тайлы: http://127.0.0.1:8080/tile/{z}/{x}/{y}.png?iterations=1024&smooth=1&palette=ocean)
+int main(int argc, char* argv[])
+{
+    std::string address;
+    size_t workers_number = 0;
+    std::string store_directory;  // Директория хранилища тайлов на диске (по умолчанию не используется).
+    std::string remote_addresses; // Адреса вычислителей AlFractalWorker через запятую (по умолчанию обсчёт местный).
+    alfrac::TileServer::Settings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = true;
+        if (argument == "--listen" && has_value)                             { address = argv[++i]; }
+        else if ((argument == "-j" || argument == "--workers") && has_value) { valid = alfrac::arguments::parse(argv[++i], workers_number, 0, alfrac::arguments::max_workers); }
+        else if (argument == "--cache" && has_value)
+        {
+            size_t megabytes = 0;
+            valid = alfrac::arguments::parse(argv[++i], megabytes, 0, std::numeric_limits<size_t>::max() >> 20);
+            if (valid) { settings.cache_budget = megabytes << 20; }
+        }
+        else if (argument == "--max-iterations" && has_value)                { valid = alfrac::arguments::parse(argv[++i], settings.max_iterations, 1); }
+        else if (argument == "--tile-store" && has_value)                    { store_directory = argv[++i]; }
+        else if (argument == "--remote" && has_value)                        { remote_addresses = argv[++i]; }
+        else
+        {
+            std::cerr << "Неизвестный ключ: " << argument << std::endl << usage;
+            return 1;
+        }
+        if (!valid)
+        {
+            std::cerr << "Некорректное значение ключа " << argument << "." << std::endl << usage;
+            return 1;
+        }
+    }
+    if (address.empty())
+    {
+        std::cerr << "Не задан адрес (--listen УЗЕЛ:ПОРТ или --listen unix:ПУТЬ)." << std::endl << usage;
+        return 1;
+    }
+
+    std::shared_ptr<alfrac::Fractal> fractal = std::make_shared<alfrac::Fractal>(workers_number);
+    if (!store_directory.empty())
+    { fractal->set_store(std::make_shared<alfrac::TileStore>(store_directory)); }
+    if (!remote_addresses.empty())
+    { fractal->set_remote(std::make_shared<alfrac::Coordinator>(remote_addresses)); }
+
+    alfrac::TileServer server(fractal, settings);
+    if (!server.serve(address))
+    {
+        std::cerr << "Не удалось ожидать подключений по адресу " << address << "." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cinttypes>
+#include "Fractal.hpp"
+#include "TileStore.hpp"
+#include "Distributed.hpp"
+#include "Arguments.hpp"
+
+namespace
+{
+    const char* usage = "Использование: AlFractalWorker --listen АДРЕС [-j N] [--tile-store ДИРЕКТОРИЯ]\n";
+}
+
+// Вычислитель для распределённого обсчёта: принимает запросы AlFractal, AlFractalRender и AlFractalZoom (ключ --remote).
+// Пример: AlFractalWorker --listen :7341 -j 16 --tile-store ~/.alfractal/tiles
+int main(int argc, char* argv[])
+{
+    std::string address;
+    size_t workers_number = 0;
+    std::string store_directory; // Директория хранилища тайлов на диске (по умолчанию не используется).
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = true;
+        if (argument == "--listen" && has_value)                             { address = argv[++i]; }
+        else if ((argument == "-j" || argument == "--workers") && has_value) { valid = alfrac::arguments::parse(argv[++i], workers_number, 0, alfrac::arguments::max_workers); }
+        else if (argument == "--tile-store" && has_value)                    { store_directory = argv[++i]; }
+        else
+        {
+            std::cerr << "Неизвестный ключ: " << argument << std::endl << usage;
+            return 1;
+        }
+        if (!valid)
+        {
+            std::cerr << "Некорректное значение ключа " << argument << "." << std::endl << usage;
+            return 1;
+        }
+    }
+    if (address.empty())
+    {
+        std::cerr << "Не задан адрес (--listen УЗЕЛ:ПОРТ или --listen unix:ПУТЬ)." << std::endl << usage;
+        return 1;
+    }
+
+    std::shared_ptr<alfrac::Fractal> fractal = std::make_shared<alfrac::Fractal>(workers_number);
+    if (!store_directory.empty())
+    { fractal->set_store(std::make_shared<alfrac::TileStore>(store_directory)); }
+
+    std::cerr << "Вычислитель: " << fractal->get_workers_number() << " потоков, формула " << alfrac::Fractal::formula() << "." << std::endl;
+    alfrac::WorkerServer server(fractal);
+    if (!server.serve(address))
+    {
+        std::cerr << "Не удалось ожидать подключений по адресу " << address << "." << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <cinttypes>
+#include <cstdio>
+#include <algorithm>
+#include <gmpxx.h>
+#include "Fractal.hpp"
+#include "Distributed.hpp"
+#include "Sequence.hpp"
+#include "ImageWriter.hpp"
+#include "Arguments.hpp"
+
+namespace
+{
+    const char* usage =
+        "Использование: AlFractalZoom [--center X Y] [--zoom НАЧАЛЬНОЕ КОНЕЧНОЕ] [--frames N] [--size ШИРИНА ВЫСОТА] [--iterations N]\n"
+        "                             [--keyframe-zoom N] [--tile N] [-j N] [--remote АДРЕСА] [-o ШАБЛОН|-] [--smooth] [--palette ИМЯ]\n";
+
+    const size_t max_frame_number_width = 32; // Наибольшая ширина номера в шаблоне имени кадра.
+
+    // Имя файла кадра по шаблону с единственной подстановкой вида %d или %05d. Пустая строка, если шаблон некорректен.
+    std::string frame_path(const std::string& pattern, size_t frame)
+    {
+        size_t percent = pattern.find('%');
+        if (percent == std::string::npos) { return std::string(); }
+
+        size_t end = pattern.find_first_not_of("0123456789", percent + 1);
+        if (end == std::string::npos || pattern[end] != 'd' || pattern.find('%', end) != std::string::npos) { return std::string(); }
+
+        std::string number = std::to_string(frame);
+        size_t width = 0;
+        if (end > percent + 1 && !alfrac::arguments::parse(pattern.substr(percent + 1, end - percent - 1).c_str(), width, 0, max_frame_number_width))
+        { return std::string(); }
+        if (number.size() < width) { number.insert(0, width - number.size(), pattern[percent + 1] == '0' ? '0' : ' '); }
+        return pattern.substr(0, percent) + number + pattern.substr(end + 1);
+    }
+}
+
+// Обсчёт последовательности кадров приближения (для видео) без графического интерфейса.
+// Кадры записываются в пронумерованные файлы или (при -o -) в стандартный вывод как поток RGB24, например:
+// AlFractalZoom --center -0.743643887 0.131825904 --zoom 1 1e8 --frames 1000 --size 1280 720 -o - | ffmpeg -f rawvideo -pix_fmt rgb24 -s 1280x720 -r 30 -i - zoom.mp4
+int main(int argc, char* argv[])
+{
+    std::string center_x = "-0.5";
+    std::string center_y = "0.0";
+    std::string start_zoom = "1"; // Приближение: ширина кадра равна 4 / zoom.
+    std::string end_zoom = "1024";
+    size_t workers_number = 0;
+    std::string remote_addresses; // Адреса вычислителей AlFractalWorker через запятую (--remote; по умолчанию обсчёт местный).
+    std::string output = "frame_%05d.png";
+    alfrac::Sequence::Path path;
+    path.frames = 100;
+    path.image_width  = 1280;
+    path.image_height = 720;
+    path.iterations_limit = 256;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument = argv[i];
+        bool has_value = i + 1 < argc;
+        bool valid = true;
+        if (argument == "--center" && i + 2 < argc)                     { center_x = argv[++i]; center_y = argv[++i]; }
+        else if (argument == "--zoom" && i + 2 < argc)                  { start_zoom = argv[++i]; end_zoom = argv[++i]; }
+        else if (argument == "--frames" && has_value)                   { valid = alfrac::arguments::parse(argv[++i], path.frames, 1); }
+        else if (argument == "--size" && i + 2 < argc)                  { valid = alfrac::arguments::parse(argv[++i], path.image_width, 1) && alfrac::arguments::parse(argv[++i], path.image_height, 1); }
+        else if (argument == "--iterations" && has_value)               { valid = alfrac::arguments::parse(argv[++i], path.iterations_limit, 1); }
+        else if (argument == "--keyframe-zoom" && has_value)            { valid = alfrac::arguments::parse(argv[++i], path.keyframe_zoom, 2); }
+        else if (argument == "--tile" && has_value)                     { valid = alfrac::arguments::parse(argv[++i], path.tile_size, 1); }
+        else if ((argument == "-j" || argument == "--workers") && has_value) { valid = alfrac::arguments::parse(argv[++i], workers_number, 0, alfrac::arguments::max_workers); }
+        else if (argument == "--remote" && has_value)                   { remote_addresses = argv[++i]; }
+        else if ((argument == "-o" || argument == "--output") && has_value)  { output = argv[++i]; }
+        else if (argument == "--smooth")                                { path.smooth = true; }
+        else if (argument == "--palette" && has_value)
+        {
+            const alfrac::Palette* palette = alfrac::Palette::find(argv[++i]);
+            if (!palette)
+            {
+                std::cerr << "Неизвестная палитра: " << argv[i] << std::endl;
+                return 1;
+            }
+            path.palette = *palette;
+        }
+        else
+        {
+            std::cerr << "Неизвестный ключ: " << argument << std::endl << usage;
+            return 1;
+        }
+        if (!valid)
+        {
+            std::cerr << "Некорректное значение ключа " << argument << "." << std::endl << usage;
+            return 1;
+        }
+    }
+
+    bool raw = output == "-";
+    if (!raw && frame_path(output, 0).empty())
+    {
+        std::cerr << "Шаблон имени кадра должен содержать одну подстановку номера (%d или %05d): " << output << std::endl;
+        return 1;
+    }
+
+    // Координаты задаются строками, чтобы не терять точность глубоких приближений.
+    mp_bitcnt_t parse_precision = 64 + 4 * static_cast<mp_bitcnt_t>(std::max(center_x.size(), center_y.size()) + end_zoom.size());
+    path.center = alfrac::mpf_vector_2d(mpf_class(center_x, parse_precision), mpf_class(center_y, parse_precision));
+    path.start_width = mpf_class(4.0 / mpf_class(start_zoom, parse_precision), parse_precision);
+    path.end_width = mpf_class(4.0 / mpf_class(end_zoom, parse_precision), parse_precision);
+    if (path.end_width > path.start_width || path.keyframe_zoom < 2)
+    {
+        std::cerr << "Конечное приближение должно быть не меньше начального, а приближение между ключевыми кадрами - не меньше 2." << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<alfrac::Fractal> fractal = std::make_shared<alfrac::Fractal>(workers_number);
+    if (!remote_addresses.empty())
+    { fractal->set_remote(std::make_shared<alfrac::Coordinator>(remote_addresses)); }
+    alfrac::Sequence sequence(fractal);
+    std::cerr << "Ключевых кадров: " << alfrac::Sequence::keyframes_number(path) << " на " << path.frames << " кадров." << std::endl;
+
+    size_t row_size = 3 * path.image_width;
+    size_t frame_size = row_size * path.image_height;
+    bool rendered = sequence.render(path, [&](const uint8_t* rgb, size_t frame)
+    {
+        std::cerr << "\rКадров: " << frame + 1 << " / " << path.frames << std::flush;
+        if (raw) { return std::fwrite(rgb, 1, frame_size, stdout) == frame_size; }
+
+        std::string name = frame_path(output, frame);
+        std::unique_ptr<alfrac::ImageWriter> writer = alfrac::ImageWriter::open(name, path.image_width, path.image_height);
+        if (!writer)
+        {
+            std::cerr << std::endl << "Не удалось открыть " << name << " (поддерживаются .ppm и .png)." << std::endl;
+            return false;
+        }
+        for (size_t row = 0; row < path.image_height; ++row)
+        {
+            if (!writer->write_row(rgb + row * row_size)) { return false; }
+        }
+        return writer->finish();
+    });
+    std::cerr << std::endl;
+
+    fractal->terminate_loops();
+    if (!rendered || (raw && std::fflush(stdout) != 0))
+    {
+        std::cerr << "Ошибка записи кадров." << std::endl;
+        return 1;
+    }
+    return 0;
+}